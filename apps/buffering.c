@@ -115,6 +115,14 @@ static size_t buffer_len;
 static size_t conf_watermark = 0; /* Level to trigger filebuf fill */
 static size_t high_watermark = 0; /* High watermark for rebuffer */
 
+/* How data left the ring: copied out by bufread() or into the guard buffer,
+   or lent in place through pointers from bufgetdata() */
+static struct
+{
+    uint64_t copied;   /* bytes memcpy'd out of the ring */
+    uint64_t lent;     /* bytes bufgetdata() pointed into the ring for */
+} read_stats;
+
 static struct lld_head handle_list; /* buffer-order handle list */
 static struct lld_head mru_cache;   /* MRU-ordered list of handles */
 static int num_handles;             /* number of handles in the lists */
@@ -1407,6 +1415,8 @@ ssize_t bufread(int handle_id, size_t size, void *dest)
         memcpy(dest, ringbuf_ptr(h->ridx), size);
     }
 
+    read_stats.copied += size;
+
     return size;
 }
 
@@ -1426,18 +1436,24 @@ ssize_t bufgetdata(int handle_id, size_t size, void **data)
     if (!h)
         return ERR_HANDLE_NOT_FOUND;
 
+    size_t copy_n = 0;
+
     if (h->ridx + size > buffer_len) {
         /* the data wraps around the end of the buffer :
            use the guard buffer to provide the requested amount of data. */
-        size_t copy_n = h->ridx + size - buffer_len;
+        copy_n = h->ridx + size - buffer_len;
         /* prep_bufdata ensures
            adjusted_size <= buffer_len - h->ridx + GUARD_BUFSIZE,
            so copy_n <= GUARD_BUFSIZE */
         memcpy(guard_buffer, ringbuf_ptr(0), copy_n);
+        read_stats.copied += copy_n;
     }
 
     if (data)
+    {
         *data = ringbuf_ptr(h->ridx);
+        read_stats.lent += size - copy_n;
+    }
 
     return size;
 }
@@ -1681,6 +1697,10 @@ void INIT_ATTR buffering_init(void)
 
     queue_enable_queue_send(&buffering_queue, &buffering_queue_sender_list,
                             buffering_thread_id);
+
+#ifdef HAVE_STORAGE_SCHED
+    storage_sched_set_urgent_thread(buffering_thread_id);
+#endif
 }
 
 /* Initialise the buffering subsystem */
@@ -1740,4 +1760,6 @@ void buffering_get_debugdata(struct buffering_debug *dbgdata)
     dbgdata->buffered_data = dc.buffered;
     dbgdata->useful_data = dc.useful;
     dbgdata->watermark = BUF_WATERMARK;
+    dbgdata->bytes_copied = read_stats.copied;
+    dbgdata->bytes_lent = read_stats.lent;
 }
@@ -71,6 +71,8 @@ bool buffering_reset(char *buf, size_t buflen);
  * NOTE: bufread and bufgetdata will block the caller until the requested
  * amount of data is ready (unless EOF is reached).
  * NOTE: Tail operations are only legal when the end of the file is buffered.
+ * NOTE: bufgetdata lends the data in place, copying only what wraps into the
+ * guard buffer. The span stays valid until bufadvance moves past it.
  ****************************************************************************/
 
 int bufopen(const char *file, off_t offset, enum data_type type,
@@ -120,6 +122,8 @@ struct buffering_debug {
     size_t data_rem;
     size_t useful_data;
     size_t watermark;
+    uint64_t bytes_copied; /* copied out by bufread or into the guard buffer */
+    uint64_t bytes_lent;   /* handed out in place by bufgetdata */
 };
 void buffering_get_debugdata(struct buffering_debug *dbgdata);
 
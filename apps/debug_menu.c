@@ -380,6 +380,9 @@ static bool dbg_buffering_thread(void)
     int pcmbufdescs = pcmbuf_descs();
     struct buffering_debug d;
     size_t filebuflen = audio_get_filebuflen();
+    /* copy/lend rates are taken over the time spent playing on this screen */
+    uint64_t copied0, lent0;
+    long playticks = 0, lasttick = current_tick;
     /* This is a size_t, but call it a long so it puts a - when it's bad. */
 #if LCD_WIDTH > 96
     #define STR_DATAREM "data_rem"
@@ -396,6 +399,10 @@ static bool dbg_buffering_thread(void)
 
     tick_add_task(dbg_audio_task);
 
+    buffering_get_debugdata(&d);
+    copied0 = d.bytes_copied;
+    lent0   = d.bytes_lent;
+
     FOR_NB_SCREENS(i)
         screens[i].setfont(FONT_SYSFIXED);
 
@@ -418,6 +425,10 @@ static bool dbg_buffering_thread(void)
         buffering_get_debugdata(&d);
         bufused = bufsize - pcmbuf_free();
 
+        if (audio_status() == AUDIO_STATUS_PLAY)
+            playticks += current_tick - lasttick;
+        lasttick = current_tick;
+
         FOR_NB_SCREENS(i)
         {
             line = 0;
@@ -490,6 +501,17 @@ static bool dbg_buffering_thread(void)
             screens[i].putsf(0, line++, "watermark: %6d",
                              (int)(d.watermark));
 
+            if (playticks >= HZ)
+            {
+                /* KiB per hour of playback */
+                screens[i].putsf(0, line++, "copy/h: %7luK",
+                    (unsigned long)((d.bytes_copied - copied0) *
+                                    (3600*HZ/1024) / playticks));
+                screens[i].putsf(0, line++, "lent/h: %7luK",
+                    (unsigned long)((d.bytes_lent - lent0) *
+                                    (3600*HZ/1024) / playticks));
+            }
+
             screens[i].update();
         }
     }
@@ -1799,6 +1821,74 @@ static bool dbg_disk_info(void)
     info.scroll_all = true;
     return simplelist_show_list(&info);
 }
+
+static int file_io_callback(int btn, struct gui_synclist *lists)
+{
+    (void)lists;
+    struct file_io_stats stats;
+    bool reset = btn == ACTION_STD_CONTEXT;
+
+    file_get_io_stats(&stats, reset);
+    if (reset || btn == ACTION_UNKNOWN)
+        btn = ACTION_NONE;
+
+    simplelist_set_line_count(0);
+
+    simplelist_addline("Read transfers: %lu", stats.transfers);
+    simplelist_addline("Read-ahead fills: %lu", stats.ra_fills);
+    simplelist_addline("Read-ahead sectors: %lu", stats.ra_sectors);
+    simplelist_addline("Read-ahead hits: %lu", stats.ra_hits);
+
+    if (btn == ACTION_NONE)
+        btn = ACTION_REDRAW;
+
+    return btn;
+}
+
+static bool dbg_file_io(void)
+{
+    struct simplelist_info info;
+    simplelist_info_init(&info, "File I/O [CONTEXT to reset]", 4, NULL);
+    info.action_callback = file_io_callback;
+    info.scroll_all = true;
+    return simplelist_show_list(&info);
+}
+
+#ifdef HAVE_STORAGE_SCHED
+static int storage_sched_callback(int btn, struct gui_synclist *lists)
+{
+    (void)lists;
+    struct storage_sched_stats stats;
+    bool reset = btn == ACTION_STD_CONTEXT;
+
+    storage_sched_get_stats(&stats, reset);
+    if (reset || btn == ACTION_UNKNOWN)
+        btn = ACTION_NONE;
+
+    simplelist_set_line_count(0);
+
+    simplelist_addline("Requests: %lu", stats.requests);
+    simplelist_addline("Waited: %lu", stats.waits);
+    simplelist_addline("Reordered: %lu", stats.reordered);
+    simplelist_addline("Deadline expired: %lu", stats.expired);
+    simplelist_addline("Urgent: %lu", stats.urgent);
+    simplelist_addline("Max queued: %u", stats.max_queue);
+
+    if (btn == ACTION_NONE)
+        btn = ACTION_REDRAW;
+
+    return btn;
+}
+
+static bool dbg_storage_sched(void)
+{
+    struct simplelist_info info;
+    simplelist_info_init(&info, "Storage queue [CONTEXT to reset]", 6, NULL);
+    info.action_callback = storage_sched_callback;
+    info.scroll_all = true;
+    return simplelist_show_list(&info);
+}
+#endif /* HAVE_STORAGE_SCHED */
 #endif /* PLATFORM_NATIVE */
 
 #ifdef HAVE_DIRCACHE
@@ -1851,6 +1941,21 @@ static int dircache_callback(int btn, struct gui_synclist *lists)
     simplelist_addline("Scanning took: %ld.%ld s",
                        ticks / HZ, (ticks*10 / HZ) % 10);
     simplelist_addline("Entry count: %u", info.entry_count);
+#ifdef DIRCACHE_NAME_INDEX
+    simplelist_addline("Name index: %u/%u", info.index_used, info.index_slots);
+#endif
+    if (info.build_ticks > 0)
+        simplelist_addline("Build rate: %ld entries/s",
+                           (long)info.entry_count * HZ / info.build_ticks);
+#ifdef DIRCACHE_NATIVE
+    simplelist_addline("Dir reads: %lu (%lu sectors)", info.dir_reads,
+                       info.dir_sectors);
+#endif
+#ifdef DIRCACHE_SNAPSHOT
+    if (info.snap_dirs)
+        simplelist_addline("Snapshot dirs: %u (%u rescanned)",
+                           info.snap_dirs, info.snap_stale);
+#endif
 
     if (btn == ACTION_NONE)
         btn = ACTION_REDRAW;
@@ -2728,6 +2833,10 @@ static const struct {
 #endif
 #if (CONFIG_PLATFORM & PLATFORM_NATIVE)
         { "View disk info", dbg_disk_info },
+        { "View file I/O stats", dbg_file_io },
+#ifdef HAVE_STORAGE_SCHED
+        { "View storage queue stats", dbg_storage_sched },
+#endif
 #if (CONFIG_STORAGE & STORAGE_ATA)
         { "Dump ATA identify info", dbg_identify_info},
 #ifdef HAVE_ATA_SMART
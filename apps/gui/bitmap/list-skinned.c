@@ -45,6 +45,11 @@
 static struct listitem_viewport_cfg *listcfg[NB_SCREENS] = {NULL};
 static struct gui_synclist *current_list;
 
+/* list-private helpers from the generic list.c */
+const char *list_get_item_name(struct gui_synclist *list, int item,
+                               char *buffer, size_t buffer_len);
+enum themable_icons list_get_item_icon(struct gui_synclist *list, int item);
+
 static int current_row;
 static int current_column;
 
@@ -109,17 +114,16 @@ const char* skinlist_get_item_text(int offset, bool wrap, char* buf, size_t buf_
     int item = offset_to_item(offset, wrap);
     if (item < 0 || !current_list)
         return NULL;
-    const char* ret = current_list->callback_get_item_name(
-                    item, current_list->data, buf, buf_size);
+    const char* ret = list_get_item_name(current_list, item, buf, buf_size);
     return P2STR((unsigned char*)ret);
 }
 
 enum themable_icons skinlist_get_item_icon(int offset, bool wrap)
 {
     int item = offset_to_item(offset, wrap);
-    if (item < 0 || !current_list || current_list->callback_get_item_icon == NULL)
+    if (item < 0 || !current_list)
         return Icon_NOICON;
-    return current_list->callback_get_item_icon(item, current_list->data);
+    return list_get_item_icon(current_list, item);
 }
 
 static bool is_selected = false;
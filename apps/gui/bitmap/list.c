@@ -59,6 +59,9 @@ int gui_list_get_item_offset(struct gui_synclist * gui_list, int item_width,
                              struct viewport *vp);
 bool list_display_title(struct gui_synclist *list, enum screen_type screen);
 int list_get_nb_lines(struct gui_synclist *list, enum screen_type screen);
+const char *list_get_item_name(struct gui_synclist *list, int item,
+                               char *buffer, size_t buffer_len);
+enum themable_icons list_get_item_icon(struct gui_synclist *list, int item);
 
 void gui_synclist_scroll_stop(struct gui_synclist *lists)
 {
@@ -330,8 +333,7 @@ void list_draw(struct screen *display, struct gui_synclist *list)
         int line_indent = 0;
         int style = STYLE_DEFAULT;
         bool is_selected = false;
-        s = list->callback_get_item_name(i, list->data, entry_buffer,
-                                         sizeof(entry_buffer));
+        s = list_get_item_name(list, i, entry_buffer, sizeof(entry_buffer));
         if (P2ID((unsigned char *)s) > VOICEONLY_DELIMITER)
             entry_name = "";
         else
@@ -424,8 +426,7 @@ void list_draw(struct screen *display, struct gui_synclist *list)
         linedes.style = style;
         linedes.scroll = is_selected ? true : list->scroll_all;
         linedes.line = i % list->selected_size;
-        icon = list->callback_get_item_icon ?
-                    list->callback_get_item_icon(i, list->data) : Icon_NOICON;
+        icon = list_get_item_icon(list, i);
 
 
         list_info.y = line * linedes.height + draw_offset;
@@ -25,7 +25,7 @@
 #include "lcd.h"
 #include "font.h"
 #include "button.h"
-#include "string.h"
+#include "string-extra.h"
 #include "settings.h"
 #include "kernel.h"
 #include "system.h"
@@ -47,11 +47,143 @@
  */
 #define FRAMEDROP_TRIGGER 6
 
+/* Item cache: the list that enabled it with gui_synclist_set_item_cache()
+ * gets the names and icons its callbacks returned kept here, so a redraw
+ * while scrolling only calls back for the items that came into view.
+ * Slots are mapped by item number, which keeps a run of consecutive items
+ * (the visible lines plus ITEM_CACHE_PREFETCH either side) resident.
+ */
+#if MEMORYSIZE >= 8
+#define ITEM_CACHE_SLOTS 64
+#else
+#define ITEM_CACHE_SLOTS 32
+#endif
+#define ITEM_CACHE_NAME_LEN 96
+#define ITEM_CACHE_PREFETCH 4
+
 void list_draw(struct screen *display, struct gui_synclist *list);
+int list_get_nb_lines(struct gui_synclist *list, enum screen_type screen);
 
 static long last_dirty_tick;
 static struct viewport parent[NB_SCREENS];
 
+struct item_cache_slot
+{
+    int item;              /* -1 if the slot is free */
+    int icon;
+    bool have_icon;
+    const char *name;      /* ID2P() pointer, text, or NULL if not kept */
+    char text[ITEM_CACHE_NAME_LEN];
+};
+
+static struct
+{
+    struct gui_synclist *list; /* owner, NULL if the cache is unused */
+    unsigned long hits, misses;
+    struct item_cache_slot slots[ITEM_CACHE_SLOTS];
+} item_cache;
+
+static void item_cache_flush(void)
+{
+    for (int i = 0; i < ITEM_CACHE_SLOTS; i++)
+        item_cache.slots[i].item = -1;
+}
+
+/* returns the slot for item, claiming it if it held another one */
+static struct item_cache_slot *item_cache_slot(int item)
+{
+    struct item_cache_slot *slot = &item_cache.slots[item % ITEM_CACHE_SLOTS];
+    if (slot->item != item)
+    {
+        slot->item = item;
+        slot->have_icon = false;
+        slot->name = NULL;
+    }
+    return slot;
+}
+
+static bool item_cache_has_name(int item)
+{
+    struct item_cache_slot *slot = &item_cache.slots[item % ITEM_CACHE_SLOTS];
+    return slot->item == item && slot->name != NULL;
+}
+
+/*
+ * Returns the text of an item, as the name callback would, going through
+ * the item cache if the list uses it.
+ */
+const char *list_get_item_name(struct gui_synclist *list, int item,
+                               char *buffer, size_t buffer_len)
+{
+    if (item_cache.list != list)
+        return list->callback_get_item_name(item, list->data,
+                                            buffer, buffer_len);
+
+    struct item_cache_slot *slot = item_cache_slot(item);
+    if (slot->name)
+    {
+        item_cache.hits++;
+        if (slot->name != slot->text)
+            return slot->name;
+        /* hand out a copy, the slot may be reused before the caller is done */
+        strmemccpy(buffer, slot->text, buffer_len);
+        return buffer;
+    }
+
+    item_cache.misses++;
+    const char *s = list->callback_get_item_name(item, list->data,
+                                                 buffer, buffer_len);
+    if (P2ID((unsigned char *)s) >= 0)
+        slot->name = s;
+    else if (s && strmemccpy(slot->text, s, sizeof(slot->text)))
+        slot->name = slot->text;
+    return s;
+}
+
+enum themable_icons list_get_item_icon(struct gui_synclist *list, int item)
+{
+    if (!list->callback_get_item_icon)
+        return Icon_NOICON;
+    if (item_cache.list != list)
+        return list->callback_get_item_icon(item, list->data);
+
+    struct item_cache_slot *slot = item_cache_slot(item);
+    if (!slot->have_icon)
+    {
+        slot->icon = list->callback_get_item_icon(item, list->data);
+        slot->have_icon = true;
+    }
+    return slot->icon;
+}
+
+/* fill the cache for the items just outside the visible window, so the
+ * next scroll step finds them */
+static void item_cache_prefetch(struct gui_synclist *list)
+{
+    char buffer[MAX_PATH];
+    int start = list->start_item[SCREEN_MAIN];
+    int end = start + list_get_nb_lines(list, SCREEN_MAIN);
+    unsigned long misses = item_cache.misses;
+
+    if (end - start + 2 * ITEM_CACHE_PREFETCH > ITEM_CACHE_SLOTS)
+        return;
+
+    for (int i = start - ITEM_CACHE_PREFETCH;
+         i < end + ITEM_CACHE_PREFETCH; i++)
+    {
+        if (i == start)
+            i = end;
+        if (i >= 0 && i < list->nb_items && !item_cache_has_name(i))
+        {
+            list_get_item_name(list, i, buffer, sizeof(buffer));
+            list_get_item_icon(list, i);
+        }
+    }
+
+    /* the stats are for what drawing asked for */
+    item_cache.misses = misses;
+}
+
 static bool list_is_dirty(struct gui_synclist *list)
 {
     return TIME_BEFORE(list->dirty_tick, last_dirty_tick);
@@ -153,6 +285,9 @@ void gui_synclist_init(struct gui_synclist * gui_list,
     int selected_size, struct viewport list_parent[NB_SCREENS]
     )
 {
+    /* a list reusing the memory of the cached one must not inherit it */
+    if (item_cache.list == gui_list)
+        item_cache.list = NULL;
     gui_list->callback_get_item_icon = NULL;
     gui_list->callback_get_item_name = callback_get_item_name;
     gui_list->callback_speak_item = NULL;
@@ -241,6 +376,8 @@ void gui_synclist_draw(struct gui_synclist *gui_list)
         if (!skinlist_draw(&screens[i], gui_list))
             list_draw(&screens[i], gui_list);
     }
+    if (item_cache.list == gui_list)
+        item_cache_prefetch(gui_list);
 }
 
 /* sets up the list so the selection is shown correctly on the screen */
@@ -409,6 +546,7 @@ static void gui_list_select_at_offset(struct gui_synclist * gui_list,
  */
 void gui_synclist_add_item(struct gui_synclist * gui_list)
 {
+    gui_synclist_items_changed(gui_list);
     gui_list->nb_items++;
     /* if only one item in the list, select it */
     if (gui_list->nb_items == 1)
@@ -423,6 +561,7 @@ void gui_synclist_del_item(struct gui_synclist * gui_list)
 {
     if (gui_list->nb_items > 0)
     {
+        gui_synclist_items_changed(gui_list);
         if (gui_list->selected_item == gui_list->nb_items-1)
             gui_list->selected_item--;
         gui_list->nb_items--;
@@ -446,6 +585,8 @@ void gui_synclist_set_title(struct gui_synclist * gui_list,
 
 void gui_synclist_set_nb_items(struct gui_synclist * lists, int nb_items)
 {
+    if (lists->nb_items != nb_items)
+        gui_synclist_items_changed(lists);
     lists->nb_items = nb_items;
     FOR_NB_SCREENS(i)
     {
@@ -463,9 +604,43 @@ int  gui_synclist_get_sel_pos(struct gui_synclist * lists)
 void gui_synclist_set_icon_callback(struct gui_synclist * lists,
                                     list_get_icon icon_callback)
 {
+    gui_synclist_items_changed(lists);
     lists->callback_get_item_icon = icon_callback;
 }
 
+/*
+ * Keep the names and icons of the items around the visible ones, instead
+ * of calling back for every line on every redraw. Only for lists whose
+ * items don't change behind the list's back: the owner has to call
+ * gui_synclist_items_changed() whenever they do. Only one list at a time
+ * uses the cache, enabling it for another list drops the previous one.
+ */
+void gui_synclist_set_item_cache(struct gui_synclist * lists, bool enable)
+{
+    if (enable)
+    {
+        item_cache.list = lists;
+        item_cache_flush();
+    }
+    else if (item_cache.list == lists)
+        item_cache.list = NULL;
+}
+
+/*
+ * Drop the cached names and icons, the next redraw asks the callbacks again
+ */
+void gui_synclist_items_changed(struct gui_synclist * lists)
+{
+    if (item_cache.list == lists)
+        item_cache_flush();
+}
+
+void gui_synclist_item_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+    *hits = item_cache.hits;
+    *misses = item_cache.misses;
+}
+
 void gui_synclist_set_voice_callback(struct gui_synclist * lists,
                                      list_speak_item voice_callback)
 {
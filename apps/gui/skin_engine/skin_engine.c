@@ -365,6 +365,9 @@ bool dbg_skin_engine(void)
         }
     }
     simplelist_addline("Skin total usage: %d bytes", total);
+    unsigned long drawn, unchanged;
+    skin_render_get_line_stats(&drawn, &unchanged);
+    simplelist_addline("Lines drawn: %lu, unchanged: %lu", drawn, unchanged);
 #if defined(HAVE_BACKDROP_IMAGE)
     simplelist_addline("Backdrop Images:");
     i = 0;
@@ -78,6 +78,10 @@
 
 #include "backdrop.h"
 #include "statusbar-skinned.h"
+#ifndef __PCTOOL__
+#include "crc32.h"
+#include "version.h"
+#endif
 
 #define WPS_ERROR_INVALID_PARAM         -1
 
@@ -2462,6 +2466,7 @@ static int skin_element_callback(struct skin_element* element, void* data)
         {
             curr_line = skin_buffer_alloc(sizeof(*curr_line));
             curr_line->update_mode = SKIN_REFRESH_STATIC;
+            curr_line->last_drawn = 0;
             element->data = PTRTOSKINOFFSET(skin_buffer, curr_line);
         }
         break;
@@ -2496,6 +2501,314 @@ static int skin_element_callback(struct skin_element* element, void* data)
     return CALLBACK_OK;
 }
 
+#ifndef __PCTOOL__
+/*
+ * Parsed skin cache
+ *
+ * The skin buffer straight after skin_parse() is written to SKIN_CACHE_DIR,
+ * named after the skin's path and screen, together with what the parse
+ * left outside of it. It is read back instead of parsing when the source,
+ * everything the parse depends on and the files the skin refers to
+ * (bitmaps, backdrop and fonts, by size and time) are unchanged. Bitmaps
+ * and fonts are not part of it and still get loaded from their own files.
+ *
+ * The tree is mostly offsets but also holds tag_info and settings_list
+ * pointers, so a cache is only valid for the binary that wrote it.
+ */
+#define SKIN_CACHE_MAGIC    0x534b4e43 /* "SKNC" */
+#define SKIN_CACHE_VERSION  2
+
+/* special values for skin_cache_header.backdrop */
+#define SKIN_CACHE_BD_NONE     (-1)
+#define SKIN_CACHE_BD_DEFAULT  (-2) /* "-" */
+#define SKIN_CACHE_BD_BUFFER   (-3) /* BACKDROP_BUFFERNAME */
+
+struct skin_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t build;   /* skin_cache_build_id() */
+    uint32_t source;  /* skin_cache_source_id() */
+    uint32_t deps;    /* skin_cache_deps_id() */
+    uint32_t usage;   /* bytes of skin buffer following the header */
+    uintptr_t base;   /* where the skin buffer was when it was written */
+    struct wps_data data;
+    struct
+    {
+        skinoffset_t name;
+        int glyphs;
+    } fonts[MAXUSERFONTS];
+    skinoffset_t backdrop;
+};
+
+static uint32_t skin_cache_build_id(void)
+{
+    uintptr_t addrs[] = {
+        (uintptr_t)find_tag, (uintptr_t)settings,
+        sizeof(struct skin_element), sizeof(struct wps_data),
+    };
+    uint32_t crc = crc_32(rbversion, strlen(rbversion), 0xffffffff);
+    return crc_32(addrs, sizeof(addrs), crc);
+}
+
+/* The source text plus everything outside it the parse looks at */
+static uint32_t skin_cache_source_id(const char *src, size_t len)
+{
+    struct viewport vp;
+    viewport_set_defaults(&vp, curr_screen);
+    int env[] = {
+        vp.x, vp.y, vp.width, vp.height, vp.font, vp.flags, vp.drawmode,
+        vp.fg_pattern, vp.bg_pattern,
+        screens[curr_screen].getuifont(), lang_is_rtl(),
+        global_settings.glyphs_to_cache,
+#ifdef HAVE_LCD_COLOR
+        global_settings.fg_color, global_settings.bg_color,
+        global_settings.lss_color, global_settings.lse_color,
+        global_settings.lst_color,
+#endif
+    };
+    uint32_t crc = crc_32(env, sizeof(env), 0xffffffff);
+    return crc_32(src, len, crc);
+}
+
+/* fold the size and time of a file into crc, a missing one counts too */
+static uint32_t skin_cache_stamp(const char *path, uint32_t crc)
+{
+    char dir[MAX_PATH];
+    uint32_t stamp[2] = { 0, 0 };
+    const char *name = strrchr(path, '/');
+
+    if (!name)
+        return crc;
+    strmemccpy(dir, path, MIN(name - path + 1, MAX_PATH));
+    name++;
+
+    DIR *dirp = opendir(dir[0] ? dir : "/");
+    if (dirp)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dirp)))
+        {
+            if (!strcasecmp(entry->d_name, name))
+            {
+                struct dirinfo info = dir_get_info(dirp, entry);
+                stamp[0] = info.size;
+                stamp[1] = info.mtime;
+                break;
+            }
+        }
+        closedir(dirp);
+    }
+
+    return crc_32(stamp, sizeof(stamp), crc);
+}
+
+/* a pointer into the skin buffer as written at base, moved to where the
+   buffer is now */
+static const char *skin_cache_reloc(const char *p, uintptr_t base,
+                                    size_t usage)
+{
+    if ((uintptr_t)p - base < usage)
+        return skin_buffer + ((uintptr_t)p - base);
+    return p;
+}
+
+/* The files the skin refers to: its bitmaps, backdrop and fonts */
+static uint32_t skin_cache_deps_id(skinoffset_t images, uintptr_t base,
+                                   size_t usage, const char *backdrop,
+                                   const char *fonts[], const char *bmpdir)
+{
+    char path[MAX_PATH];
+    uint32_t crc = 0xffffffff;
+
+    struct skin_token_list *list = SKINOFFSETTOPTR(skin_buffer, images);
+    while (list)
+    {
+        struct wps_token *token = SKINOFFSETTOPTR(skin_buffer, list->token);
+        struct gui_img *img = token ?
+            SKINOFFSETTOPTR(skin_buffer, token->value.data) : NULL;
+        if (img && img->bm.data)
+        {
+            get_image_filename(skin_cache_reloc(img->bm.data, base, usage),
+                               bmpdir, path, sizeof(path));
+            crc = skin_cache_stamp(path, crc);
+        }
+        list = SKINOFFSETTOPTR(skin_buffer, list->next);
+    }
+
+    if (backdrop)
+    {
+        get_image_filename(backdrop, bmpdir, path, sizeof(path));
+        crc = skin_cache_stamp(path, crc);
+    }
+
+    for (int i = 0; i < MAXUSERFONTS; i++)
+    {
+        if (fonts[i])
+        {
+            snprintf(path, sizeof(path), FONT_DIR "/%s", fonts[i]);
+            crc = skin_cache_stamp(path, crc);
+        }
+    }
+
+    return crc;
+}
+
+static void skin_cache_save(const char *path, struct wps_data *wps_data,
+                            uint32_t source, const char *bmpdir)
+{
+    const char *fonts[MAXUSERFONTS];
+    const char *backdrop = NULL;
+
+    struct skin_cache_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SKIN_CACHE_MAGIC;
+    hdr.version = SKIN_CACHE_VERSION;
+    hdr.build = skin_cache_build_id();
+    hdr.source = source;
+    hdr.usage = skin_buffer_usage();
+    hdr.base = (uintptr_t)skin_buffer;
+    hdr.data = *wps_data;
+
+    for (int i = 0; i < MAXUSERFONTS; i++)
+    {
+        hdr.fonts[i].name = PTRTOSKINOFFSET(skin_buffer, skinfonts[i].name);
+        hdr.fonts[i].glyphs = skinfonts[i].glyphs;
+        fonts[i] = skinfonts[i].name;
+    }
+
+    hdr.backdrop = SKIN_CACHE_BD_NONE;
+#if (LCD_DEPTH > 1) || (defined(HAVE_REMOTE_LCD) && (LCD_REMOTE_DEPTH > 1))
+    if (!backdrop_filename)
+        hdr.backdrop = SKIN_CACHE_BD_NONE;
+    else if (!strcmp(backdrop_filename, BACKDROP_BUFFERNAME))
+        hdr.backdrop = SKIN_CACHE_BD_BUFFER;
+    else if (!strcmp(backdrop_filename, "-"))
+        hdr.backdrop = SKIN_CACHE_BD_DEFAULT;
+    else
+    {
+        hdr.backdrop = PTRTOSKINOFFSET(skin_buffer, backdrop_filename);
+        backdrop = backdrop_filename;
+    }
+#endif
+
+    hdr.deps = skin_cache_deps_id(wps_data->images, hdr.base, hdr.usage,
+                                  backdrop, fonts, bmpdir);
+
+    int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0)
+    {
+        mkdir(SKIN_CACHE_DIR);
+        fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    }
+    if (fd < 0)
+        return;
+
+    bool ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              write(fd, skin_buffer, hdr.usage) == (ssize_t)hdr.usage;
+    close(fd);
+
+    if (!ok)
+        remove(path);
+}
+
+static bool skin_cache_load(const char *path, struct wps_data *wps_data,
+                            uint32_t source, size_t buffersize,
+                            const char *bmpdir)
+{
+    struct skin_cache_header hdr;
+    const char *fonts[MAXUSERFONTS];
+    const char *backdrop = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    bool ok = read(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              hdr.magic == SKIN_CACHE_MAGIC &&
+              hdr.version == SKIN_CACHE_VERSION &&
+              hdr.build == skin_cache_build_id() &&
+              hdr.source == source &&
+              hdr.usage <= buffersize &&
+              read(fd, skin_buffer, hdr.usage) == (ssize_t)hdr.usage;
+    close(fd);
+
+    if (!ok)
+        return false;
+
+    /* the files the skin refers to have to be unchanged too */
+    for (int i = 0; i < MAXUSERFONTS; i++)
+        fonts[i] = SKINOFFSETTOPTR(skin_buffer, hdr.fonts[i].name);
+    if (hdr.backdrop >= 0)
+        backdrop = SKINOFFSETTOPTR(skin_buffer, hdr.backdrop);
+    if (hdr.deps != skin_cache_deps_id(hdr.data.images, hdr.base, hdr.usage,
+                                       backdrop, fonts, bmpdir))
+        return false;
+
+    /* account for the restored contents */
+    skin_buffer_init(skin_buffer, buffersize);
+    skin_buffer_alloc(hdr.usage);
+
+    wps_data->tree = hdr.data.tree;
+    wps_data->images = hdr.data.images;
+
+    /* image filenames are kept as plain pointers until the bitmaps load */
+    struct skin_token_list *list = SKINOFFSETTOPTR(skin_buffer, wps_data->images);
+    while (list)
+    {
+        struct wps_token *token = SKINOFFSETTOPTR(skin_buffer, list->token);
+        struct gui_img *img = token ?
+            SKINOFFSETTOPTR(skin_buffer, token->value.data) : NULL;
+        if (img)
+            img->bm.data = (char *)skin_cache_reloc(img->bm.data, hdr.base,
+                                                    hdr.usage);
+        list = SKINOFFSETTOPTR(skin_buffer, list->next);
+    }
+#ifdef HAVE_BACKDROP_IMAGE
+    wps_data->use_extra_framebuffer = hdr.data.use_extra_framebuffer;
+#endif
+#ifdef HAVE_TOUCHSCREEN
+    wps_data->touchregions = hdr.data.touchregions;
+    wps_data->touchscreen_locked = hdr.data.touchscreen_locked;
+#endif
+#ifdef HAVE_SKIN_VARIABLES
+    wps_data->skinvars = hdr.data.skinvars;
+#endif
+    wps_data->peak_meter_enabled = hdr.data.peak_meter_enabled;
+    wps_data->wps_sb_tag = hdr.data.wps_sb_tag;
+    wps_data->show_sb_on_wps = hdr.data.show_sb_on_wps;
+
+    for (int i = 0; i < MAXUSERFONTS; i++)
+    {
+        skinfonts[i].name = SKINOFFSETTOPTR(skin_buffer, hdr.fonts[i].name);
+        skinfonts[i].glyphs = hdr.fonts[i].glyphs;
+    }
+
+#if (LCD_DEPTH > 1) || (defined(HAVE_REMOTE_LCD) && (LCD_REMOTE_DEPTH > 1))
+    if (hdr.backdrop == SKIN_CACHE_BD_BUFFER)
+        backdrop_filename = BACKDROP_BUFFERNAME;
+    else if (hdr.backdrop == SKIN_CACHE_BD_DEFAULT)
+        backdrop_filename = "-";
+    else
+        backdrop_filename = SKINOFFSETTOPTR(skin_buffer, hdr.backdrop);
+#endif
+
+#ifdef HAVE_ALBUMART
+    /* the parse claims the album art slot; do the same */
+    wps_data->albumart = hdr.data.albumart;
+    struct skin_albumart *aa = SKINOFFSETTOPTR(skin_buffer, wps_data->albumart);
+    if (aa)
+    {
+        struct dim dimensions = { .width = aa->width, .height = aa->height };
+        int albumart_slot = playback_claim_aa_slot(&dimensions);
+        if (0 <= albumart_slot)
+            wps_data->playback_aa_slot = albumart_slot;
+    }
+#endif
+
+    return true;
+}
+#endif /* !__PCTOOL__ */
+
 /* to setup up the wps-data from a format-buffer (isfile = false)
    from a (wps-)file (isfile = true)*/
 bool skin_data_load(enum screen_type screen, struct wps_data *wps_data,
@@ -2571,19 +2884,6 @@ bool skin_data_load(enum screen_type screen, struct wps_data *wps_data,
     backdrop_filename = "-";
     wps_data->backdrop_id = -1;
 #endif
-    /* parse the skin source */
-    skin_buffer_init(skin_buffer, buffersize);
-    struct skin_element *tree = skin_parse(wps_buffer, skin_element_callback, wps_data);
-    wps_data->tree = PTRTOSKINOFFSET(skin_buffer, tree);
-    if (!SKINOFFSETTOPTR(skin_buffer, wps_data->tree)) {
-#ifdef DEBUG_SKIN_ENGINE
-        if (isfile && debug_wps)
-            skin_error_format_message();
-#endif
-        skin_data_reset(wps_data);
-        return false;
-    }
-
     char bmpdir[MAX_PATH];
     if (isfile)
     {
@@ -2595,6 +2895,40 @@ bool skin_data_load(enum screen_type screen, struct wps_data *wps_data,
     {
         snprintf(bmpdir, MAX_PATH, "%s", BACKDROP_DIR);
     }
+#ifndef __PCTOOL__
+    char cachepath[MAX_PATH];
+    uint32_t source = 0;
+    bool cached = false;
+    if (isfile)
+    {
+        snprintf(cachepath, sizeof(cachepath), SKIN_CACHE_DIR "/%08lx%d.skc",
+                 (unsigned long)crc_32(buf, strlen(buf), 0xffffffff), screen);
+        source = skin_cache_source_id(wps_buffer, strlen(wps_buffer));
+        cached = skin_cache_load(cachepath, wps_data, source, buffersize,
+                                 bmpdir);
+    }
+
+    if (!cached)
+#endif
+    {
+        /* parse the skin source */
+        skin_buffer_init(skin_buffer, buffersize);
+        struct skin_element *tree = skin_parse(wps_buffer, skin_element_callback, wps_data);
+        wps_data->tree = PTRTOSKINOFFSET(skin_buffer, tree);
+        if (!SKINOFFSETTOPTR(skin_buffer, wps_data->tree)) {
+#ifdef DEBUG_SKIN_ENGINE
+            if (isfile && debug_wps)
+                skin_error_format_message();
+#endif
+            skin_data_reset(wps_data);
+            return false;
+        }
+#ifndef __PCTOOL__
+        if (isfile)
+            skin_cache_save(cachepath, wps_data, source, bmpdir);
+#endif
+    }
+
     /* load the bitmaps that were found by the parsing */
     if (!load_skin_bitmaps(wps_data, bmpdir) ||
         !skin_load_fonts(wps_data))
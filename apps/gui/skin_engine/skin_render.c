@@ -51,6 +51,7 @@
 #include "misc.h"
 #include "list.h"
 #include "wps.h"
+#include "crc32.h"
 
 
 #define MAX_LINE 1024
@@ -79,6 +80,9 @@ extern void sb_set_info_vp(enum screen_type screen, OFFSETTYPE(char*) label);
 typedef bool (*skin_render_func)(struct skin_element* alternator, struct skin_draw_info *info);
 bool skin_render_alternator(struct skin_element* alternator, struct skin_draw_info *info);
 
+/* lines written vs. lines skipped because they would have been identical */
+static unsigned long lines_drawn, lines_unchanged;
+
 static void skin_render_playlistviewer(struct playlistviewer* viewer,
                                        struct gui_wps *gwps,
                                        struct skin_viewport* skin_viewport,
@@ -708,6 +712,57 @@ bool skin_render_alternator(struct skin_element* element, struct skin_draw_info
     return changed_lines || ret;
 }
 
+void skin_render_get_line_stats(unsigned long *drawn, unsigned long *unchanged)
+{
+    *drawn = lines_drawn;
+    *unchanged = lines_unchanged;
+}
+
+/* Returns where the hash of the last drawn output of a top level line is
+ * kept; for an alternator that's the subline currently shown */
+static uint32_t *line_last_drawn(struct skin_element *line)
+{
+    struct line *l;
+    if (line->type == LINE_ALTERNATOR)
+    {
+        struct line_alternator *alternator =
+                SKINOFFSETTOPTR(skin_buffer, line->data);
+        line = get_child(line->children, alternator->current_line);
+    }
+    if (line->type != LINE)
+        return NULL;
+    l = SKINOFFSETTOPTR(skin_buffer, line->data);
+    return l ? &l->last_drawn : NULL;
+}
+
+/* Hash everything write_line() uses to draw the current line */
+static uint32_t line_draw_hash(struct skin_draw_info *info)
+{
+    const char *parts[3] = { info->align.left, info->align.center,
+                             info->align.right };
+    struct viewport *vp = &info->skin_vp->vp;
+    struct line_desc *ld = &info->line_desc;
+    unsigned misc[] = {
+        info->line_number, info->line_scrolls, vp->font,
+        vp->fg_pattern, vp->bg_pattern,
+        ld->style, ld->text_color, ld->line_color, ld->line_end_color,
+        ld->line, ld->nlines,
+    };
+    uint32_t crc = crc_32(misc, sizeof(misc), 0xffffffff);
+
+    for (int i = 0; i < 3; i++)
+    {
+        /* the terminator keeps "ab","c" apart from "a","bc"; 0xff marks
+         * an absent part */
+        if (parts[i])
+            crc = crc_32(parts[i], strlen(parts[i]) + 1, crc);
+        else
+            crc = crc_32("\xff", 1, crc);
+    }
+
+    return crc ? crc : 1; /* 0 means nothing drawn yet */
+}
+
 void skin_render_viewport(struct skin_element* viewport, struct gui_wps *gwps,
                         struct skin_viewport* skin_viewport, unsigned long refresh_type)
 {
@@ -791,12 +846,28 @@ void skin_render_viewport(struct skin_element* viewport, struct gui_wps *gwps,
         /* only update if the line needs to be, and there is something to write */
         if (refresh_type && (needs_update || update_all))
         {
-            if (info.force_redraw)
-                display->scroll_stop_viewport_rect(&skin_viewport->vp,
-                    0, info.line_number*display->getcharheight(),
-                    skin_viewport->vp.width, display->getcharheight());
-            write_line(display, align, info.line_number,
-                    info.line_scrolls, &info.line_desc);
+            /* a dynamic refresh often produces exactly what is already on
+             * screen; unless the viewport was cleared skip those lines */
+            uint32_t *last_drawn = line_last_drawn(line);
+            uint32_t hash = line_draw_hash(&info);
+
+            if (last_drawn && *last_drawn == hash && !info.force_redraw &&
+                !update_all && refresh_type != SKIN_REFRESH_ALL)
+            {
+                lines_unchanged++;
+            }
+            else
+            {
+                if (info.force_redraw)
+                    display->scroll_stop_viewport_rect(&skin_viewport->vp,
+                        0, info.line_number*display->getcharheight(),
+                        skin_viewport->vp.width, display->getcharheight());
+                write_line(display, align, info.line_number,
+                        info.line_scrolls, &info.line_desc);
+                lines_drawn++;
+                if (last_drawn)
+                    *last_drawn = hash;
+            }
         }
         if (!info.no_line_break)
             info.line_number++;
@@ -818,6 +889,10 @@ void skin_render(struct gui_wps *gwps, unsigned refresh_mode)
     int old_refresh_mode = refresh_mode;
     skin_buffer = get_skin_buffer(gwps->data);
 
+    /* drawing since the last frame was pushed by whoever did it */
+    if (display->screen_type == SCREEN_MAIN)
+        lcd_damage_reset();
+
     /* Framebuffer is likely dirty */
     if ((refresh_mode&SKIN_REFRESH_ALL) == SKIN_REFRESH_ALL)
     {
@@ -904,7 +979,7 @@ void skin_render(struct gui_wps *gwps, unsigned refresh_mode)
     }
     /* Restore the default viewport */
     display->set_viewport_ex(NULL, VP_FLAG_VP_SET_CLEAN);
-    display->update();
+    display->update_damage();
 }
 
 static __attribute__((noinline))
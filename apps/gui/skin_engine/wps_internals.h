@@ -43,6 +43,7 @@ int skin_get_num_skins(void);
 struct skin_stats *skin_get_stats(int number, int screen);
 #define skin_clear_stats(stats) memset(stats, 0, sizeof(struct skin_stats))
 bool skin_backdrop_get_debug(int index, char **path, int *ref_count, size_t *size);
+void skin_render_get_line_stats(unsigned long *drawn, unsigned long *unchanged);
 
 /*
  * setup up the skin-data from a format-buffer (isfile = false)
@@ -281,6 +282,7 @@ struct skin_albumart {
 
 struct line {
     unsigned update_mode;
+    uint32_t last_drawn; /* hash of what write_line() last drew, 0 if none */
 };
 
 struct line_alternator {
@@ -40,6 +40,7 @@
 #include "settings.h"
 #include "audio.h"
 #include "voice_thread.h"
+#include "storage.h"
 
 /* 2 channels * 2 bytes/sample, interleaved */
 #define PCMBUF_SAMPLE_SIZE   (2 * 2)
@@ -491,6 +492,12 @@ void * pcmbuf_request_buffer(int *count)
         if (realrem < pcmbuf_watermark)
             trigger_cpu_boost();
 
+#ifdef HAVE_STORAGE_SCHED
+        /* let the buffering thread's disk requests go first */
+        if (status == CHANNEL_PLAYING && remaining < LOW_DATA)
+            storage_sched_audio_critical();
+#endif
+
         boost_codec_thread(realrem*10 / pcmbuf_size);
     }
     else    /* !playing */
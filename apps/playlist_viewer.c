@@ -1207,6 +1207,8 @@ bool search_playlist(void)
                       found_indicies, false, 1, NULL);
     gui_synclist_set_title(&playlist_lists, str(LANG_SEARCH_RESULTS), NOICON);
     gui_synclist_set_icon_callback(&playlist_lists, NULL);
+    /* the results are fixed, don't look every track up again on redraw */
+    gui_synclist_set_item_cache(&playlist_lists, true);
     if(global_settings.talk_file)
         gui_synclist_set_voice_callback(&playlist_lists,
                                         global_settings.talk_file?
@@ -1242,6 +1244,7 @@ bool search_playlist(void)
                 break;
         }
     }
+    gui_synclist_set_item_cache(&playlist_lists, false);
     talk_shutup();
     return ret;
 }
@@ -46,6 +46,9 @@
 #include "pathfuncs.h"
 #include "load_code.h"
 #include "file.h"
+#ifdef HAVE_DIRCACHE
+#include "dircache.h"
+#endif
 #include "core_keymap.h"
 #include "language.h"
 
@@ -841,6 +844,22 @@ static const struct plugin_api rockbox_api = {
     filetype_get_plugin,
     playlist_entries_iterate,
     lang_is_rtl,
+    FS_PREFIX(fsync),
+#ifdef HAVE_DIRCACHE
+    dircache_suspend,
+    dircache_resume,
+#endif
+#ifdef HAVE_LCD_TEXT_CACHE
+    lcd_text_cache_stats,
+#endif
+#ifdef HAVE_LCD_SIMD
+    lcd_set_simd,
+#endif
+    gui_synclist_set_item_cache,
+    gui_synclist_item_cache_stats,
+#ifdef HAVE_RESIZE_SIMD
+    resize_set_simd,
+#endif
 };
 
 static int plugin_buffer_handle;
@@ -163,7 +163,7 @@ int plugin_open(const char *plugin, const char *parameter);
  * when this happens please take the opportunity to sort in
  * any new functions "waiting" at the end of the list.
  */
-#define PLUGIN_API_VERSION 270
+#define PLUGIN_API_VERSION 275
 
 /* 239 Marks the removal of ARCHOS HWCODEC and CHARCELL */
 
@@ -979,6 +979,23 @@ struct plugin_api {
                                      struct playlist_insert_context *pl_context,
                                      bool (*action_cb)(const char *file_name));
     int  (*lang_is_rtl)(void);
+    int (*fsync)(int fildes);
+#ifdef HAVE_DIRCACHE
+    void (*dircache_suspend)(void);
+    int (*dircache_resume)(void);
+#endif
+#ifdef HAVE_LCD_TEXT_CACHE
+    void (*lcd_text_cache_stats)(unsigned long *hits, unsigned long *misses);
+#endif
+#ifdef HAVE_LCD_SIMD
+    bool (*lcd_set_simd)(bool enable);
+#endif
+    void (*gui_synclist_set_item_cache)(struct gui_synclist * lists, bool enable);
+    void (*gui_synclist_item_cache_stats)(unsigned long *hits,
+                                          unsigned long *misses);
+#ifdef HAVE_RESIZE_SIMD
+    bool (*resize_set_simd)(bool enable);
+#endif
 };
 
 /* plugin header */
@@ -203,19 +203,26 @@ static int audio_buffer(struct stream *str, enum stream_parse_mode type)
 
         curr->size += len;
 
-        /* Slide any remainder over to beginning */
-        if (audio_queue.ptr > audio_queue.start && audio_queue.used > 0)
+        /* Slide any remainder over to beginning only when the packet won't
+           fit after it; the decoder only ever holds about a frame so this
+           is rare and the remainder is usually just appended to */
+        if (audio_queue.ptr + audio_queue.used + len >
+                audio_queue.start + AUDIOBUF_ALLOC_SIZE)
         {
-            rb->memmove(audio_queue.start, audio_queue.ptr,
-                        audio_queue.used);
+            if (audio_queue.used > 0)
+            {
+                rb->memmove(audio_queue.start, audio_queue.ptr,
+                            audio_queue.used);
+            }
+
+            audio_queue.ptr = audio_queue.start;
         }
 
         /* Splice this packet onto any remainder */
-        rb->memcpy(audio_queue.start + audio_queue.used,
+        rb->memcpy(audio_queue.ptr + audio_queue.used,
                    str->curr_packet, len);
 
         audio_queue.used += len;
-        audio_queue.ptr = audio_queue.start;
 
         rb->yield();
     }
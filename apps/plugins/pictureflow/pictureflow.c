@@ -264,6 +264,7 @@ typedef fb_data pix_t;
 #define THREAD_STACK_SIZE DEFAULT_STACK_SIZE + 0x200
 #define CACHE_PREFIX PLUGIN_DEMOS_DATA_DIR "/pictureflow"
 #define ALBUM_INDEX CACHE_PREFIX "/pictureflow_album.idx"
+#define COVER_ATLAS CACHE_PREFIX "/pictureflow_covers.atl"
 
 #define EV_EXIT 9999
 #define EV_WAKEUP 1337
@@ -287,6 +288,17 @@ typedef fb_data pix_t;
 #define CONFIG_VERSION 1
 #define CONFIG_FILE "pictureflow.cfg"
 #define INDEX_HDR "PFID"
+#define ATLAS_HDR "PFA2"
+#define ATLAS_TEMP CACHE_PREFIX "/pictureflow_covers.tmp"
+#define ATLAS_REPLACED 0xffff
+/* past the visible slides, load up to this many slides on one side before
+   switching, so that the atlas is read in sequential runs */
+#define PF_LOAD_BATCH 8
+
+/* benchmark: jumps timed until all visible covers are in, and the time
+   allowed for each */
+#define BENCH_JUMPS 8
+#define BENCH_TIMEOUT (10*HZ)
 
 /** structs we use */
 struct pf_config_t
@@ -357,6 +369,7 @@ struct albumart_t {
     int idx;
     int slides;
     int inspected;
+    int unpacked;   /* covers written as pfraw since the atlas was packed */
     void * buf;
     size_t buf_sz;
 };
@@ -419,6 +432,9 @@ struct pf_slide_cache
     int left_idx;
     int right_idx;
     int center_idx;
+    int run_dir;    /* side of the current load run, -1 left, 1 right */
+    int run_len;    /* slides loaded in the current run */
+    int run_center; /* center_index the run was started for */
 };
 
 enum pf_scroll_line_type {
@@ -447,6 +463,32 @@ struct pfraw_header {
     int32_t height;         /* bmap height in pixels */
 };
 
+/* The atlas holds every scaled cover once, after a table of entries sorted
+   by album and artist hash, so that any slide order can look its cover up.
+   The pixel data is in the slide order it was packed in, which lets
+   neighbouring slides be read with one seek per run. */
+struct pf_atlas_header {
+    uint32_t magic;         /* ATLAS_HDR */
+    int32_t  count;         /* number of entries */
+};
+
+struct pf_atlas_entry {
+    uint32_t hash_album;
+    uint32_t hash_artist;
+    uint32_t offset;        /* of the pixel data, 0 if there is no cover */
+    uint16_t width;         /* ATLAS_REPLACED: the cover is a pfraw now */
+    uint16_t height;
+};
+
+struct pf_atlas_t {
+    int  fd;
+    int  count;
+    int  slots;             /* room in table */
+    long pos;               /* file position, -1 if unknown */
+    bool unusable;          /* there, but its table couldn't be loaded */
+    struct pf_atlas_entry *table;
+};
+
 enum show_album_name_values {
     ALBUM_NAME_HIDE = 0,
     ALBUM_NAME_BOTTOM,
@@ -492,6 +534,7 @@ static char* year_sort_order_conf[] =
 #define MAX_MARGIN 80
 
 static struct albumart_t aa_cache;
+static struct pf_atlas_t pf_atlas = { .fd = -1 };
 static struct pf_config_t pf_cfg;
 
 static struct configdata config[] =
@@ -513,6 +556,7 @@ static struct configdata config[] =
     { TYPE_INT, 0, 1, { .int_p = &pf_cfg.backlight_mode }, "backlight", NULL },
     { TYPE_INT, 0, 999999, { .int_p = &aa_cache.idx }, "art cache pos", NULL },
     { TYPE_INT, 0, 999999, { .int_p = &aa_cache.inspected }, "art cache inspected", NULL },
+    { TYPE_INT, 0, 999999, { .int_p = &aa_cache.unpacked }, "art cache unpacked", NULL },
     { TYPE_ENUM, 0, 4, { .int_p = &pf_cfg.sort_albums_by }, "sort albums by",
       sort_albums_by_conf },
     { TYPE_ENUM, 0, 2, { .int_p = &pf_cfg.year_sort_order }, "year order",
@@ -2226,6 +2270,149 @@ static bool save_pfraw(char* filename, struct bitmap *bm)
     return true;
 }
 
+static void atlas_close(void)
+{
+    if (pf_atlas.fd >= 0)
+        rb->close(pf_atlas.fd);
+    pf_atlas.fd = -1;
+    pf_atlas.count = 0;
+}
+
+
+static int atlas_compare(const void *a, const void *b)
+{
+    const struct pf_atlas_entry *e1 = a, *e2 = b;
+
+    if (e1->hash_album != e2->hash_album)
+        return e1->hash_album < e2->hash_album ? -1 : 1;
+    if (e1->hash_artist != e2->hash_artist)
+        return e1->hash_artist < e2->hash_artist ? -1 : 1;
+    return 0;
+}
+
+
+/**
+ Find the atlas entry of an album, independent of the slide order
+ */
+static struct pf_atlas_entry *atlas_find(unsigned int hash_album,
+                                         unsigned int hash_artist)
+{
+    struct pf_atlas_entry key = { .hash_album = hash_album,
+                                  .hash_artist = hash_artist };
+    int lo = 0, hi = pf_atlas.count - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int cmp = atlas_compare(&key, &pf_atlas.table[mid]);
+        if (cmp == 0)
+            return &pf_atlas.table[mid];
+        if (cmp < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    return NULL;
+}
+
+
+/**
+ Make room for count entries, taken from the plugin buffer. Only possible
+ before buf_ctx is set up.
+ */
+static bool atlas_alloc_table(int count)
+{
+    size_t size = count * sizeof(struct pf_atlas_entry);
+
+    if (count <= pf_atlas.slots)
+        return true;
+    if (size > pf_idx.buf_sz / 4)
+        return false;
+
+    ALIGN_BUFFER(pf_idx.buf, pf_idx.buf_sz, sizeof(long));
+    pf_atlas.table = (struct pf_atlas_entry *)pf_idx.buf;
+    pf_atlas.slots = count;
+    pf_idx.buf += size;
+    pf_idx.buf_sz -= size;
+    return true;
+}
+
+
+/**
+ Open the cover atlas and read its table
+ */
+static bool atlas_open(void)
+{
+    struct pf_atlas_header hdr;
+
+    atlas_close();
+    pf_atlas.unusable = false;
+    int fd = rb->open(COVER_ATLAS, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    /* one of an older format is replaced, its covers are still pfraw files */
+    if (rb->read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        rb->memcmp(&hdr.magic, ATLAS_HDR, sizeof(hdr.magic)) != 0)
+    {
+        rb->close(fd);
+        return false;
+    }
+
+    /* otherwise it holds the only copy of the packed covers, keep it */
+    ssize_t size = hdr.count * sizeof(struct pf_atlas_entry);
+    if (hdr.count < 0 ||
+        !atlas_alloc_table(MAX(hdr.count, number_of_slides)) ||
+        rb->read(fd, pf_atlas.table, size) != size)
+    {
+        rb->close(fd);
+        pf_atlas.unusable = true;
+        return false;
+    }
+
+    pf_atlas.fd = fd;
+    pf_atlas.count = hdr.count;
+    pf_atlas.pos = -1;
+
+    /* covers replaced before a restart still need packing */
+    int replaced = 0;
+    for (int i = 0; i < hdr.count; i++)
+    {
+        if (pf_atlas.table[i].width == ATLAS_REPLACED)
+            replaced++;
+    }
+    aa_cache.unpacked = MAX(aa_cache.unpacked, replaced);
+    return true;
+}
+
+
+/**
+ A new cover was written as pfraw; stop using the packed one, also on disk
+ so that it isn't used again after a restart
+ */
+static void atlas_forget(unsigned int hash_album, unsigned int hash_artist)
+{
+    struct pf_atlas_entry *entry = atlas_find(hash_album, hash_artist);
+    if (entry && entry->width != ATLAS_REPLACED)
+    {
+        long pos = sizeof(struct pf_atlas_header) +
+                   (entry - pf_atlas.table) * sizeof(*entry);
+        entry->offset = 0;
+        entry->width = ATLAS_REPLACED;
+        entry->height = 0;
+
+        int fd = rb->open(COVER_ATLAS, O_WRONLY);
+        if (fd >= 0)
+        {
+            if (rb->lseek(fd, pos, SEEK_SET) == pos)
+                rb->write(fd, entry, sizeof(*entry));
+            rb->close(fd);
+        }
+    }
+    aa_cache.unpacked++;
+}
+
+
 static bool incremental_albumart_cache(bool verbose)
 {
     if (!aa_cache.buf)
@@ -2259,7 +2446,9 @@ static bool incremental_albumart_cache(bool verbose)
     rb->snprintf(aa_cache.pfraw_file, sizeof(aa_cache.pfraw_file),
                  CACHE_PREFIX "/%x%x.pfraw", hash_album, hash_artist);
 
-    if(pf_cfg.update_albumart && rb->file_exists(aa_cache.pfraw_file)) {
+    struct pf_atlas_entry *entry = atlas_find(hash_album, hash_artist);
+    if (pf_cfg.update_albumart && ((entry && entry->offset) ||
+                                   rb->file_exists(aa_cache.pfraw_file))) {
         aa_cache.slides++;
         goto aa_success;
     }
@@ -2288,6 +2477,7 @@ static bool incremental_albumart_cache(bool verbose)
         if (verbose) { rb->splash(HZ, "Could not write bmp"); }
         goto aa_failure;
     }
+    atlas_forget(hash_album, hash_artist);
     aa_cache.slides++;
 
 aa_failure:
@@ -2339,6 +2529,158 @@ static bool create_albumart_cache(void)
     return true;
 }
 
+/**
+ Copy size bytes at offset in the old atlas to the end of the new one
+ */
+static bool atlas_copy(int fd, long offset, ssize_t size, void *buf)
+{
+    return rb->lseek(pf_atlas.fd, offset, SEEK_SET) == offset &&
+           rb->read(pf_atlas.fd, buf, size) == size &&
+           rb->write(fd, buf, size) == size;
+}
+
+
+/**
+ Pack the covers of all slides, in slide order, into a new cover atlas: the
+ pfraw files written since the last time, and everything else from the old
+ atlas. The packed pfraw files are removed, the atlas is their only copy.
+ */
+static bool create_cover_atlas(void)
+{
+    struct pf_atlas_header hdr;
+    struct pfraw_header bmph;
+    char pfraw_file[MAX_PATH];
+    int i;
+
+    if (!atlas_alloc_table(number_of_slides))
+        return false;
+
+    /* the new table is built at the start of the scratch buffer */
+    struct pf_atlas_entry *table = aa_cache.buf;
+    size_t table_sz = number_of_slides * sizeof(*table);
+    void *buf = (char *)aa_cache.buf + table_sz;
+    if (table_sz >= aa_cache.buf_sz)
+        return false;
+    size_t buf_sz = aa_cache.buf_sz - table_sz;
+
+    int fd = rb->creat(ATLAS_TEMP, 0666);
+    if (fd < 0)
+        return false;
+
+    /* the pixel data is appended after the table */
+    long offset = sizeof(hdr) + table_sz;
+    rb->memset(buf, 0, MIN(buf_sz, (size_t)offset));
+    for (long left = offset; left > 0; )
+    {
+        ssize_t size = MIN((size_t)left, buf_sz);
+        if (rb->write(fd, buf, size) != size)
+            goto fail;
+        left -= size;
+    }
+
+    draw_splashscreen(pf_idx.buf, pf_idx.buf_sz);
+    draw_progressbar(0, number_of_slides, "Packing artwork");
+    for (i = 0; i < number_of_slides; i++)
+    {
+        struct pf_atlas_entry *entry = &table[i];
+        entry->hash_artist = mfnv(get_album_artist(i));
+        entry->hash_album = mfnv(get_album_name(i));
+        entry->offset = 0;
+        entry->width = 0;
+        entry->height = 0;
+
+        ssize_t size = 0;
+        rb->snprintf(pfraw_file, sizeof(pfraw_file),
+                     CACHE_PREFIX "/%x%x.pfraw",
+                     entry->hash_album, entry->hash_artist);
+        int fh = rb->open(pfraw_file, O_RDONLY);
+        if (fh >= 0)
+        {
+            if (rb->read(fh, &bmph, sizeof(bmph)) == sizeof(bmph) &&
+                bmph.width > 0 && bmph.height > 0 &&
+                bmph.width * bmph.height * sizeof(pix_t) <= buf_sz)
+            {
+                size = sizeof(pix_t) * bmph.width * bmph.height;
+                if (rb->read(fh, buf, size) != size)
+                    size = 0;
+            }
+            rb->close(fh);
+
+            if (size > 0 && rb->write(fd, buf, size) != size)
+                goto fail;
+        }
+        else
+        {
+            struct pf_atlas_entry *old = atlas_find(entry->hash_album,
+                                                    entry->hash_artist);
+            if (old && old->offset)
+            {
+                bmph.width = old->width;
+                bmph.height = old->height;
+                size = sizeof(pix_t) * bmph.width * bmph.height;
+                if ((size_t)size > buf_sz ||
+                    !atlas_copy(fd, old->offset, size, buf))
+                    goto fail;
+            }
+        }
+
+        if (size > 0)
+        {
+            entry->offset = offset;
+            entry->width = bmph.width;
+            entry->height = bmph.height;
+            offset += size;
+        }
+
+        if ((i & 15) == 0)
+        {
+            draw_progressbar(i, number_of_slides, NULL);
+            if (rb->button_get(false) > BUTTON_NONE)
+                goto fail;
+        }
+    }
+
+    rb->qsort(table, number_of_slides, sizeof(*table), atlas_compare);
+
+    /* the magic is written last, so an interrupted atlas is never used */
+    rb->memset(&hdr, 0, sizeof(hdr));
+    hdr.count = number_of_slides;
+    if (rb->lseek(fd, 0, SEEK_SET) != 0 ||
+        rb->write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        rb->write(fd, table, table_sz) != (ssize_t)table_sz)
+        goto fail;
+    rb->memcpy(&hdr.magic, ATLAS_HDR, sizeof(hdr.magic));
+    if (rb->lseek(fd, 0, SEEK_SET) != 0 ||
+        rb->write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+        goto fail;
+    rb->close(fd);
+
+    atlas_close();
+    rb->remove(COVER_ATLAS);
+    if (rb->rename(ATLAS_TEMP, COVER_ATLAS) < 0)
+    {
+        rb->remove(ATLAS_TEMP);
+        return false;
+    }
+
+    aa_cache.unpacked = 0;
+    configfile_save(CONFIG_FILE, config, CONFIG_NUM_ITEMS, CONFIG_VERSION);
+    for (i = 0; i < number_of_slides; i++)
+    {
+        rb->snprintf(pfraw_file, sizeof(pfraw_file),
+                     CACHE_PREFIX "/%x%x.pfraw",
+                     mfnv(get_album_name(i)), mfnv(get_album_artist(i)));
+        rb->remove(pfraw_file);
+    }
+    return true;
+
+fail:
+    rb->close(fd);
+    rb->remove(ATLAS_TEMP);
+    pf_atlas.pos = -1;
+    return false;
+}
+
 /**
   Create the "?" slide, that is shown while loading
   or when no cover was found.
@@ -2456,6 +2798,8 @@ static void initialize_slide_cache(void)
     pf_sldcache.left_idx = -1;
     pf_sldcache.right_idx = -1;
     pf_sldcache.center_idx = -1;
+    pf_sldcache.run_dir = 0;
+    pf_sldcache.run_len = 0;
 }
 
 
@@ -2645,10 +2989,53 @@ static void free_all_slide_prio(int prio)
 }
 
 
+/**
+ A slide being loaded is stale once the centre has moved on (there is a
+ wakeup waiting) and the slide is no longer on screen.
+ */
+static inline bool slide_is_stale(int slide_index)
+{
+    if (slide_index < 0 || rb->queue_empty(&thread_q))
+        return false;
+    int dist = slide_index - center_index;
+    return (dist < 0 ? -dist : dist) > pf_cfg.num_slides;
+}
+
+
+/**
+ Allocate a slide of the given size, freeing slides ranked above prio if
+ needed. Returns the hid, or -1 if there is no room or the slide went stale
+ while other threads ran.
+ */
+static int alloc_slide(int width, int height, int prio, int slide_index)
+{
+    int size =  sizeof(struct dim) + sizeof( pix_t ) * width * height;
+
+    int hid;
+    do {
+        hid = rb->buflib_alloc(&buf_ctx, size);
+    } while (hid < 0 && free_slide_prio(prio));
+
+    if (hid < 0)
+        return -1;
+
+    rb->yield(); /* allow audio to play when fast scrolling */
+    if (slide_is_stale(slide_index)) {
+        rb->buflib_free(&buf_ctx, hid);
+        return -1;
+    }
+
+    struct dim *bm = rb->buflib_get_data(&buf_ctx, hid);
+    bm->width = width;
+    bm->height = height;
+    return hid;
+}
+
+
 /**
  Read the pfraw image given as filename and return the hid of the buffer
  */
-static int read_pfraw(char* filename, int prio)
+static int read_pfraw(char* filename, int prio, int slide_index)
 {
     struct pfraw_header bmph;
     int fh = rb->open(filename, O_RDONLY);
@@ -2659,24 +3046,13 @@ static int read_pfraw(char* filename, int prio)
     else
         rb->read(fh, &bmph, sizeof(struct pfraw_header));
 
-    int size =  sizeof(struct dim) +
-                sizeof( pix_t ) * bmph.width * bmph.height;
-
-    int hid;
-    do {
-        hid = rb->buflib_alloc(&buf_ctx, size);
-    } while (hid < 0 && free_slide_prio(prio));
-
+    int hid = alloc_slide(bmph.width, bmph.height, prio, slide_index);
     if (hid < 0) {
         rb->close( fh );
         return -1;
     }
 
-    rb->yield(); /* allow audio to play when fast scrolling */
     struct dim *bm = rb->buflib_get_data(&buf_ctx, hid);
-
-    bm->width = bmph.width;
-    bm->height = bmph.height;
     pix_t *data = (pix_t*)(sizeof(struct dim) + (char *)bm);
 
     rb->read( fh, data , sizeof( pix_t ) * bm->width * bm->height );
@@ -2685,6 +3061,48 @@ static int read_pfraw(char* filename, int prio)
 }
 
 
+/**
+ Read the cover of slide_index from the atlas. Returns the hid, -1 if there
+ was no room for it, or 0 if the atlas can't provide it.
+ */
+static int read_atlas_slide(int slide_index, unsigned int hash_album,
+                            unsigned int hash_artist, int prio)
+{
+    struct pf_atlas_entry *entry = atlas_find(hash_album, hash_artist);
+    if (!entry)
+        return 0;
+
+    if (entry->width == ATLAS_REPLACED)
+        return 0;
+    if (entry->offset == 0)
+        return empty_slide_hid;
+
+    long offset = entry->offset;
+    int hid = alloc_slide(entry->width, entry->height, prio, slide_index);
+    if (hid < 0)
+        return -1;
+
+    struct dim *bm = rb->buflib_get_data(&buf_ctx, hid);
+    pix_t *data = (pix_t*)(sizeof(struct dim) + (char *)bm);
+    ssize_t size = sizeof( pix_t ) * bm->width * bm->height;
+
+    /* consecutive slides are contiguous, so a run needs only the one seek */
+    if (pf_atlas.pos != offset &&
+        rb->lseek(pf_atlas.fd, offset, SEEK_SET) != offset)
+        goto fail;
+    if (rb->read(pf_atlas.fd, data, size) != size)
+        goto fail;
+
+    pf_atlas.pos = offset + size;
+    return hid;
+
+fail:
+    pf_atlas.pos = -1;
+    rb->buflib_free(&buf_ctx, hid);
+    return 0;
+}
+
+
 /**
   Load the surface for the given slide_index into the cache at cache_index.
  */
@@ -2696,10 +3114,12 @@ static inline bool load_and_prepare_surface(const int slide_index,
     unsigned int hash_artist = mfnv(get_album_artist(slide_index));
     unsigned int hash_album = mfnv(get_album_name(slide_index));
 
-    rb->snprintf(pfraw_file, sizeof(pfraw_file), CACHE_PREFIX "/%x%x.pfraw",
-                 hash_album, hash_artist);
-
-    int hid = read_pfraw(pfraw_file, prio);
+    int hid = read_atlas_slide(slide_index, hash_album, hash_artist, prio);
+    if (hid == 0) {
+        rb->snprintf(pfraw_file, sizeof(pfraw_file),
+                     CACHE_PREFIX "/%x%x.pfraw", hash_album, hash_artist);
+        hid = read_pfraw(pfraw_file, prio, slide_index);
+    }
     if (hid < 0)
         return false;
 
@@ -2799,9 +3219,32 @@ bool load_new_slide(void)
         center = pf_sldcache.cache[pf_sldcache.center_idx].index;
         right = pf_sldcache.cache[pf_sldcache.right_idx].index;
 
-        int prio_l = center - left + 1;
-        int prio_r = right - center + 1;
-        if ((prio_l < prio_r || right >= number_of_slides) && left > 0)
+        int prio_l = left > 0 ? center - left + 1 : INT_MAX;
+        int prio_r = right < number_of_slides - 1 ? right - center + 1 : INT_MAX;
+        int dir = prio_l < prio_r ? -1 : 1;
+
+        /* The visible slides are loaded strictly by distance. Past them, stay
+           on one side for a run of up to PF_LOAD_BATCH slides while it is not
+           more than that far ahead of the other side. A new centre starts
+           over. */
+        if (pf_sldcache.run_center == center_index && pf_sldcache.run_dir &&
+            pf_sldcache.run_len < PF_LOAD_BATCH &&
+            MIN(prio_l, prio_r) >= pf_cfg.num_slides)
+        {
+            int prio_run = pf_sldcache.run_dir < 0 ? prio_l : prio_r;
+            int prio_other = pf_sldcache.run_dir < 0 ? prio_r : prio_l;
+            if (prio_run != INT_MAX && prio_run - PF_LOAD_BATCH <= prio_other)
+                dir = pf_sldcache.run_dir;
+        }
+        if (dir != pf_sldcache.run_dir || pf_sldcache.run_center != center_index)
+        {
+            pf_sldcache.run_dir = dir;
+            pf_sldcache.run_len = 0;
+            pf_sldcache.run_center = center_index;
+        }
+        pf_sldcache.run_len++;
+
+        if (dir < 0 && prio_l != INT_MAX)
         {
             if (pf_sldcache.free == -1 && !free_slide_prio(prio_l))
             {
@@ -2815,7 +3258,7 @@ bool load_new_slide(void)
                 pf_sldcache.left_idx = i;
                 return true;
             }
-        } else if(right < number_of_slides - 1)
+        } else if (dir > 0 && prio_r != INT_MAX)
         {
             if (pf_sldcache.free == -1 && !free_slide_prio(prio_r))
             {
@@ -2874,28 +3317,41 @@ static inline struct dim *get_slide(const int hid)
 
 
 /**
- Return the requested surface
+ Return the cache index holding slide_index, or -1 if it isn't loaded
 */
-static inline struct dim *surface(const int slide_index)
+static int find_slide(const int slide_index)
 {
-    if (slide_index < 0)
-        return 0;
-    if (slide_index >= number_of_slides)
-        return 0;
     int i;
     if ((i = pf_sldcache.used ) != -1)
     {
         int j = 0;
         do {
-            if (pf_sldcache.cache[i].index == slide_index) {
-                if (is_initial_slide && slide_index == center_index)
-                    is_initial_slide = false;
-                return get_slide(pf_sldcache.cache[i].hid);
-            }
+            if (pf_sldcache.cache[i].index == slide_index)
+                return i;
             i = pf_sldcache.cache[i].next;
             j++;
         } while (i != pf_sldcache.used && j < SLIDE_CACHE_SIZE);
     }
+    return -1;
+}
+
+
+/**
+ Return the requested surface
+*/
+static inline struct dim *surface(const int slide_index)
+{
+    if (slide_index < 0)
+        return 0;
+    if (slide_index >= number_of_slides)
+        return 0;
+    int i = find_slide(slide_index);
+    if (i != -1)
+    {
+        if (is_initial_slide && slide_index == center_index)
+            is_initial_slide = false;
+        return get_slide(pf_sldcache.cache[i].hid);
+    }
     if (is_initial_slide && slide_index == center_index)
         return NULL;
     else
@@ -3239,7 +3695,7 @@ static bool sort_albums(int new_sorting, bool from_settings)
 
     /* Empty cache and restart cover loading thread */
     rb->buflib_init(&buf_ctx, (void *)pf_idx.buf, pf_idx.buf_sz);
-    empty_slide_hid = read_pfraw(EMPTY_SLIDE, 0);
+    empty_slide_hid = read_pfraw(EMPTY_SLIDE, 0, -1);
     initialize_slide_cache();
     is_initial_slide = true;
     create_pf_thread();
@@ -3470,6 +3926,92 @@ static void update_scroll_animation(void)
 }
 
 
+/**
+ True once every slide drawn around the centre is in the cache
+ */
+static bool visible_slides_loaded(void)
+{
+    int n = MAX(pf_cfg.num_slides - 1, 0);
+    int first = MAX(center_index - n, 0);
+    int last = MIN(center_index + n, number_of_slides - 1);
+    int i;
+
+    for (i = first; i <= last; i++)
+        if (find_slide(i) == -1)
+            return false;
+    return true;
+}
+
+
+/**
+ Measure the frame rate while scrolling, then jump across the library and
+ time how long it takes until all visible covers are loaded
+ */
+static void run_benchmark(void)
+{
+    int start = center_index;
+    int frames = 0, fps = 0, loaded = 0;
+    int i;
+    long t0, elapsed, total = 0, worst = 0;
+
+    target = (start < number_of_slides / 2) ? number_of_slides - 1 : 0;
+    if (target != center_index)
+        start_animation();
+    t0 = *rb->current_tick;
+    while (pf_state == pf_scrolling &&
+           TIME_BEFORE(*rb->current_tick, t0 + 5*HZ))
+    {
+        update_scroll_animation();
+        render_all_slides();
+        mylcd_update();
+        rb->yield();
+        frames++;
+    }
+    elapsed = *rb->current_tick - t0;
+    if (elapsed > 0)
+        fps = frames * HZ / elapsed;
+    set_current_slide(center_index);
+    pf_state = pf_idle;
+
+    for (i = 1; i <= BENCH_JUMPS; i++)
+    {
+        set_current_slide((start + i * number_of_slides / (BENCH_JUMPS + 1))
+                          % number_of_slides);
+        t0 = *rb->current_tick;
+        while (!visible_slides_loaded() &&
+               TIME_BEFORE(*rb->current_tick, t0 + BENCH_TIMEOUT))
+        {
+            render_all_slides();
+            mylcd_update();
+            rb->yield();
+        }
+        elapsed = *rb->current_tick - t0;
+        if (visible_slides_loaded())
+        {
+            loaded++;
+            total += elapsed;
+            worst = MAX(worst, elapsed);
+        }
+        if (rb->button_get(false) > BUTTON_NONE)
+            break;
+    }
+    set_current_slide(start);
+
+    DEBUGF("pictureflow benchmark: %d fps, covers in %ld ms avg %ld ms max\n",
+           fps, loaded ? total * 1000 / HZ / loaded : 0, worst * 1000 / HZ);
+#ifdef USEGSLIB
+    grey_show(false);
+#endif
+    rb->splashf(HZ*5, "FPS: %d, all visible covers in %ld ms "
+                "(max %ld ms, %d/%d jumps)", fps,
+                loaded ? total * 1000 / HZ / loaded : 0, worst * 1000 / HZ,
+                loaded, BENCH_JUMPS);
+#ifdef USEGSLIB
+    grey_show(true);
+#endif
+}
+
+
 /**
   Cleanup the plugin
 */
@@ -3483,6 +4025,7 @@ static void cleanup(void)
     rb->cpu_boost(false);
 #endif
     end_pf_thread();
+    atlas_close();
 
     /* Turn on backlight timeout (revert to settings) */
     backlight_use_settings();
@@ -3671,6 +4214,7 @@ enum {
     PF_MENU_PLAYBACK_CONTROL,
 #endif
     PF_MENU_SETTINGS,
+    PF_MENU_BENCHMARK,
     PF_MENU_QUIT,
 };
 
@@ -3691,6 +4235,7 @@ static int main_menu(void)
                         ID2P(LANG_PLAYBACK_CONTROL),
 #endif
                         ID2P(LANG_SETTINGS),
+                        "Benchmark",
                         ID2P(LANG_MENU_QUIT));
     while (1)  {
         switch (rb->do_menu(&main_menu,&selection, NULL, false)) {
@@ -3733,6 +4278,17 @@ static int main_menu(void)
                 result = settings_menu();
                 if ( result != 0 ) return result;
                 break;
+            case PF_MENU_BENCHMARK:
+                if (pf_state == pf_show_tracks)
+                    free_borrowed_tracks();
+                if (pf_state == pf_show_tracks ||
+                    pf_state == pf_cover_in ||
+                    pf_state == pf_cover_out)
+                    skip_animation_to_idle_state();
+                else if (pf_state == pf_scrolling)
+                    set_current_slide(target);
+                pf_state = pf_idle;
+                return -3;
             case PF_MENU_QUIT:
                 return -1;
 
@@ -4485,6 +5041,10 @@ static int pictureflow_main(const char* selected_file)
     pf_idx.buf += aa_bufsz;
     pf_idx.buf_sz -= aa_bufsz;
 
+    /* before the artwork is updated, which may replace packed covers */
+    if (!atlas_open() && pf_atlas.unusable)
+        rb->splash(HZ * 2, "Could not load the cover atlas");
+
     if (!create_empty_slide(pf_cfg.cache_version != CACHE_VERSION)) {
         config_save(CACHE_REBUILD, false);
         error_wait("Could not load the empty slide");
@@ -4503,9 +5063,16 @@ static int pictureflow_main(const char* selected_file)
         config_save(CACHE_VERSION, pf_cfg.update_albumart);
     }
 
+    /* Covers written since the atlas was packed go into it once the
+       artwork is complete; until then they are read from the pfraw files.
+       An atlas that is there but couldn't be loaded is never replaced. */
+    if (aa_cache.inspected >= pf_idx.album_ct && !pf_atlas.unusable &&
+        (aa_cache.unpacked || pf_atlas.fd < 0) && create_cover_atlas())
+        atlas_open();
+
     rb->buflib_init(&buf_ctx, (void *)pf_idx.buf, pf_idx.buf_sz);
 
-    if ((empty_slide_hid = read_pfraw(EMPTY_SLIDE, 0)) < 0)
+    if ((empty_slide_hid = read_pfraw(EMPTY_SLIDE, 0, -1)) < 0)
     {
         error_wait("Unable to load empty slide image");
         return PLUGIN_ERROR;
@@ -4671,11 +5238,12 @@ static int pictureflow_main(const char* selected_file)
                 rb->viewportmanager_theme_undo(i, false);
             if ( ret == -2 ) return PLUGIN_GOTO_WPS;
             if ( ret == -1 ) return PLUGIN_OK;
-            if ( ret != 0 ) return ret;
+            if ( ret != 0 && ret != -3 ) return ret;
 #ifdef USEGSLIB
             grey_show(true);
 #endif
             mylcd_set_drawmode(DRMODE_FG);
+            if ( ret == -3 ) run_benchmark();
             break;
 
         case PF_NEXT:
@@ -35,6 +35,21 @@
 #endif
 #define TEST_TIME 10 /* in seconds */
 
+/* benchmark suite; results go to a CSV file for comparing builds and cards */
+#define BENCH_FILE      TESTBASEDIR "/bench.tmp"
+#define BENCH_FRAG_FILE TESTBASEDIR "/frag%d.tmp"
+#define BENCH_SMALL     TESTBASEDIR "/s%05d.tmp"
+#if (CONFIG_STORAGE & STORAGE_MMC)
+#define BENCH_SIZE      (4*1024*1024)
+#else
+#define BENCH_SIZE      (32*1024*1024)
+#endif
+#define BENCH_TIME      5     /* in seconds, for time-limited tests */
+#define BENCH_FILES     256   /* small files to create */
+#define BENCH_SYNCS     32    /* write+fsync rounds */
+#define BENCH_FRAG_STEP 65536 /* interleave of the fragmented pair */
+#define BENCH_SEEK_SPAN 64    /* blocks at either end the long seeks hit */
+
 static unsigned char* audiobuf;
 static size_t audiobuflen;
 
@@ -432,11 +447,358 @@ static bool test_speed(void)
 }
 
 
+static int csv_fd = -1;
+
+/* log one result line; throughput if bytes is given, else operations/s */
+static void bench_result(const char *test, int block, long ops, long bytes,
+                         long ticks)
+{
+    char text_buf[64];
+    long rate;
+    const char *unit;
+
+    if (ticks <= 0)
+        ticks = 1;
+
+    if (bytes)
+    {
+        rate = (bytes >> 10) * HZ / ticks;
+        unit = "KB/s";
+    }
+    else
+    {
+        rate = ops * HZ / ticks;
+        unit = "ops/s";
+    }
+
+    rb->fdprintf(csv_fd, "%s,%d,%ld,%ld,%ld,%ld,%s\n", test, block, ops,
+                 bytes, ticks * (1000 / HZ), rate, unit);
+
+    rb->snprintf(text_buf, sizeof (text_buf), "%s %d: %ld %s", test, block,
+                 rate, unit);
+    log_text(text_buf, true);
+}
+
+/* sequential write of a fresh file, then read it back */
+static bool bench_seq(int block)
+{
+    long size, time;
+    int fd;
+
+    if ((unsigned)block > audiobuflen)
+        return true;
+
+    fd = rb->creat(BENCH_FILE, 0666);
+    if (fd < 0)
+        return false;
+
+    time = *rb->current_tick;
+    for (size = 0; size < BENCH_SIZE; size += block)
+    {
+        if (rb->write(fd, audiobuf, block) != block)
+        {
+            rb->close(fd);
+            return false;
+        }
+    }
+    rb->close(fd);
+    bench_result("seq_write", block, size / block, size,
+                 *rb->current_tick - time);
+
+    fd = rb->open(BENCH_FILE, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    time = *rb->current_tick;
+    for (size = 0; size < BENCH_SIZE; size += block)
+    {
+        if (rb->read(fd, audiobuf, block) != block)
+        {
+            rb->close(fd);
+            return false;
+        }
+    }
+    rb->close(fd);
+    bench_result("seq_read", block, size / block, size,
+                 *rb->current_tick - time);
+
+    return true;
+}
+
+/* block-aligned random accesses within a file for BENCH_TIME seconds */
+static bool bench_random(const char *test, const char *path, long filesize,
+                         int block, bool write)
+{
+    long ops, time, end;
+    int fd = rb->open(path, write ? O_WRONLY : O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    long nblocks = filesize / block;
+
+    time = *rb->current_tick;
+    end = time + BENCH_TIME*HZ;
+    for (ops = 0; TIME_BEFORE(*rb->current_tick, end); ops++)
+    {
+        off_t pos = (off_t)(rb->rand() % nblocks) * block;
+
+        if (rb->lseek(fd, pos, SEEK_SET) != pos ||
+            (write ? rb->write(fd, audiobuf, block) :
+                     rb->read(fd, audiobuf, block)) != block)
+        {
+            rb->close(fd);
+            return false;
+        }
+    }
+    rb->close(fd);
+    bench_result(test, block, ops, 0, *rb->current_tick - time);
+
+    return true;
+}
+
+/* read single blocks alternately near the start and the end of the file so
+ * that every read is a long seek */
+static bool bench_seek(const char *test, const char *path, long filesize)
+{
+    long ops, time, end;
+    int fd = rb->open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    time = *rb->current_tick;
+    end = time + BENCH_TIME*HZ;
+    for (ops = 0; TIME_BEFORE(*rb->current_tick, end); ops++)
+    {
+        off_t pos = (off_t)(rb->rand() % BENCH_SEEK_SPAN) * 512;
+
+        if (ops & 1)
+            pos = filesize - 512 - pos;
+
+        if (rb->lseek(fd, pos, SEEK_SET) != pos ||
+            rb->read(fd, audiobuf, 512) != 512)
+        {
+            rb->close(fd);
+            return false;
+        }
+    }
+    rb->close(fd);
+    bench_result(test, 512, ops, 0, *rb->current_tick - time);
+
+    return true;
+}
+
+/* two files written in alternating steps so their clusters interleave */
+static bool bench_make_fragmented(char path[2][MAX_PATH], long filesize)
+{
+    int fd[2];
+    bool ok = true;
+
+    for (int i = 0; i < 2; i++)
+    {
+        rb->snprintf(path[i], MAX_PATH, BENCH_FRAG_FILE, i);
+        fd[i] = rb->creat(path[i], 0666);
+    }
+
+    if (fd[0] < 0 || fd[1] < 0)
+        ok = false;
+
+    for (long size = 0; ok && size < filesize; size += BENCH_FRAG_STEP)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            if (rb->write(fd[i], audiobuf, BENCH_FRAG_STEP) !=
+                    BENCH_FRAG_STEP)
+                ok = false;
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (fd[i] >= 0)
+            rb->close(fd[i]);
+    }
+
+    return ok;
+}
+
+/* write a sector and fsync, BENCH_SYNCS times */
+static bool bench_fsync(void)
+{
+    long time;
+    int fd = rb->open(BENCH_FILE, O_WRONLY);
+    if (fd < 0)
+        return false;
+
+    time = *rb->current_tick;
+    for (int i = 0; i < BENCH_SYNCS; i++)
+    {
+        if (rb->write(fd, audiobuf, 512) != 512 || rb->fsync(fd) < 0)
+        {
+            rb->close(fd);
+            return false;
+        }
+    }
+    rb->close(fd);
+    bench_result("fsync", 512, BENCH_SYNCS, 0, *rb->current_tick - time);
+
+    return true;
+}
+
+/* enumerate the test directory with info for BENCH_TIME seconds */
+static bool bench_dirscan(const char *test)
+{
+    long entries = 0, time, end;
+
+    time = *rb->current_tick;
+    end = time + BENCH_TIME*HZ;
+    while (TIME_BEFORE(*rb->current_tick, end))
+    {
+        DIR *dir = rb->opendir(testbasedir);
+        if (dir == NULL)
+            return false;
+
+        struct dirent *entry;
+        while ((entry = rb->readdir(dir)))
+        {
+            (void)rb->dir_get_info(dir, entry);
+            entries++;
+        }
+
+        rb->closedir(dir);
+    }
+    bench_result(test, 0, entries, 0, *rb->current_tick - time);
+
+    return true;
+}
+
+/* small-file create, stat, directory scan and delete */
+static bool bench_small_files(void)
+{
+    char path[MAX_PATH];
+    long time;
+    int i, fd;
+    bool ok = true;
+
+    time = *rb->current_tick;
+    for (i = 0; i < BENCH_FILES; i++)
+    {
+        rb->snprintf(path, sizeof (path), BENCH_SMALL, i);
+        fd = rb->creat(path, 0666);
+        if (fd < 0)
+            break;
+        rb->write(fd, audiobuf, 100);
+        rb->close(fd);
+    }
+    bench_result("create", 100, i, 0, *rb->current_tick - time);
+
+    if (i < BENCH_FILES)
+        ok = false;
+
+    int count = i;
+
+    time = *rb->current_tick;
+    for (i = 0; ok && i < count; i++)
+    {
+        rb->snprintf(path, sizeof (path), BENCH_SMALL, i);
+        ok = rb->file_exists(path);
+    }
+    if (ok)
+        bench_result("stat", 0, count, 0, *rb->current_tick - time);
+
+    if (ok)
+        ok = bench_dirscan("dirscan");
+
+#ifdef HAVE_DIRCACHE
+    if (ok && rb->global_settings->dircache)
+    {
+        rb->dircache_suspend();
+        ok = bench_dirscan("dirscan_nocache");
+        rb->dircache_resume();
+    }
+#endif
+
+    time = *rb->current_tick;
+    for (i = 0; i < count; i++)
+    {
+        rb->snprintf(path, sizeof (path), BENCH_SMALL, i);
+        rb->remove(path);
+    }
+    bench_result("delete", 0, count, 0, *rb->current_tick - time);
+
+    return ok;
+}
+
+static bool test_bench(void)
+{
+    static const int block_sizes[] = { 512, 4096, 65536, 1048576 };
+    char csvfilename[MAX_PATH];
+    char frag[2][MAX_PATH] = { "", "" };
+    bool ok = true;
+
+    rb->memset(audiobuf, 'B', audiobuflen);
+    log_init();
+    log_text("test_disk BENCHMARK", true);
+
+    rb->create_numbered_filename(csvfilename, HOME_DIR, "test_disk_bench_",
+                                 ".csv", 2 IF_CNFN_NUM_(, NULL));
+    csv_fd = rb->open(csvfilename, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (csv_fd < 0)
+    {
+        rb->splash(HZ, "Can't create CSV file.");
+        log_close();
+        return false;
+    }
+
+    rb->fdprintf(csv_fd, "# %s\n", rb->rbversion);
+#if (CONFIG_PLATFORM & PLATFORM_NATIVE)
+    rb->fdprintf(csv_fd, "# cpu_hz %ld\n", *rb->cpu_frequency);
+#endif
+    rb->fdprintf(csv_fd, "test,block,ops,bytes,ms,rate,unit\n");
+
+    for (unsigned int i = 0; ok && i < ARRAYLEN(block_sizes); i++)
+        ok = bench_seq(block_sizes[i]);
+
+    if (ok)
+        ok = bench_random("rand_read", BENCH_FILE, BENCH_SIZE, 512, false) &&
+             bench_random("rand_read", BENCH_FILE, BENCH_SIZE, 4096, false) &&
+             bench_random("rand_write", BENCH_FILE, BENCH_SIZE, 512, true) &&
+             bench_random("rand_write", BENCH_FILE, BENCH_SIZE, 4096, true);
+
+    if (ok)
+        ok = bench_fsync();
+
+    if (ok)
+        ok = bench_small_files();
+
+    /* long seeks: contiguous file against one interleaved with another */
+    if (ok)
+        ok = bench_seek("seek_contig", BENCH_FILE, BENCH_SIZE);
+
+    if (ok)
+        ok = bench_make_fragmented(frag, BENCH_SIZE / 2) &&
+             bench_seek("seek_frag", frag[0], BENCH_SIZE / 2);
+
+    rb->remove(BENCH_FILE);
+    for (int i = 0; i < 2; i++)
+    {
+        if (frag[i][0])
+            rb->remove(frag[i]);
+    }
+
+    log_text(ok ? "DONE" : "FAILED", true);
+    rb->close(csv_fd);
+    csv_fd = -1;
+    log_close();
+    rb->button_clear_queue();
+    rb->button_get(true);
+    return false;
+}
+
 /* this is the plugin entry point */
 enum plugin_status plugin_start(const void* parameter)
 {
     MENUITEM_STRINGLIST(menu, "Test Disk Menu", NULL,
-                        "Disk speed", "Write & verify");
+                        "Disk speed", "Write & verify", "Benchmark (CSV)");
     int selected=0;
     bool quit = false;
     DIR *dir;
@@ -481,6 +843,9 @@ enum plugin_status plugin_start(const void* parameter)
             case 1:
                 test_fs();
                 break;
+            case 2:
+                test_bench();
+                break;
             default:
                 quit = true;
                 break;
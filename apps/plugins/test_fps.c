@@ -123,6 +123,155 @@ static void time_main_update(void)
     log_text(str);
 }
 
+#define LIST_ITEMS 10000
+
+/* formats like a database view does, the cost the item cache saves */
+static const char* list_scroll_name(int item, void *data,
+                                    char *buffer, size_t buffer_len)
+{
+    (void)data;
+    rb->snprintf(buffer, buffer_len, "%05d. Artist %d - Album %d - Track %d",
+                 item, item / 150, item / 12, item % 12 + 1);
+    return buffer;
+}
+
+#ifdef HAVE_TAGCACHE
+static struct tagcache_search list_tcs;
+static int *list_idx_ids;
+
+/* reads the title from the database for every item, as a track view does */
+static const char* list_db_name(int item, void *data,
+                                char *buffer, size_t buffer_len)
+{
+    (void)data;
+    if (!rb->tagcache_retrieve(&list_tcs, list_idx_ids[item], tag_title,
+                               buffer, buffer_len))
+        buffer[0] = '\0';
+    return buffer;
+}
+
+/* collect up to LIST_ITEMS tracks, the search is left open for list_db_name */
+static int list_db_items(void)
+{
+    char buf[MAX_PATH];
+    size_t size;
+    int count = 0;
+
+    list_idx_ids = rb->plugin_get_buffer(&size);
+    size = MIN(size / sizeof(int), LIST_ITEMS);
+
+    if (!rb->tagcache_search(&list_tcs, tag_title))
+        return 0;
+    while (count < (int)size &&
+           rb->tagcache_get_next(&list_tcs, buf, sizeof(buf)))
+        list_idx_ids[count++] = list_tcs.idx_id;
+
+    return count;
+}
+#endif /* HAVE_TAGCACHE */
+
+static void time_list_scroll_run(char *label,
+                                 list_get_name *name_cb, int nb_items)
+{
+    struct gui_synclist list;
+    char str[32];     /* text buffer */
+    long time_start;  /* start tickcount */
+    long time_end;    /* end tickcount */
+    int step_count[2];
+    long step_time[2]; /* redraw time per step in us */
+    unsigned long hits0, misses0, hits, misses;
+
+    /* one line down per redraw, without and with the item cache */
+    for (int cached = 0; cached < 2; cached++)
+    {
+        rb->gui_synclist_init(&list, name_cb, NULL, false, 1, NULL);
+        rb->gui_synclist_set_nb_items(&list, nb_items);
+        rb->gui_synclist_set_item_cache(&list, cached);
+        rb->gui_synclist_item_cache_stats(&hits0, &misses0);
+
+        step_count[cached] = 0;
+        rb->sleep(0); /* sync to tick */
+        time_start = *rb->current_tick;
+        while((time_end = *rb->current_tick) - time_start < DURATION)
+        {
+            rb->gui_synclist_select_item(&list, step_count[cached] % nb_items);
+            rb->gui_synclist_draw(&list);
+            step_count[cached]++;
+        }
+        step_time[cached] = (time_end - time_start) * (1000000 / HZ)
+                            / step_count[cached];
+    }
+    rb->gui_synclist_item_cache_stats(&hits, &misses);
+    hits -= hits0;
+    misses -= misses0;
+    rb->gui_synclist_set_item_cache(&list, false);
+    rb->lcd_scroll_stop();
+    rb->lcd_set_viewport(NULL);
+    rb->lcd_clear_display();
+
+    log_text(label);
+    rb->snprintf(str, sizeof(str), "%ld us/step", step_time[0]);
+    log_text(str);
+    rb->snprintf(str, sizeof(str), "cached: %ld us/step", step_time[1]);
+    log_text(str);
+    rb->snprintf(str, sizeof(str), "cache hits: %lu%%",
+                 100 * hits / MAX(hits + misses, 1));
+    log_text(str);
+}
+
+static void time_list_scroll(void)
+{
+    time_list_scroll_run("List scroll", list_scroll_name, LIST_ITEMS);
+
+#ifdef HAVE_TAGCACHE
+    int count = list_db_items();
+    if (count > 0)
+        time_list_scroll_run("Database scroll", list_db_name, count);
+    rb->tagcache_search_finish(&list_tcs);
+#endif
+}
+
+static void time_text_runs(void)
+{
+    static const unsigned char text[] =
+        "The quick brown fox jumps over the lazy dog 0123456789";
+    char str[32];     /* text buffer */
+    long time_start;  /* start tickcount */
+    long time_end;    /* end tickcount */
+    int line_count;
+    int w, h;
+#ifdef HAVE_LCD_TEXT_CACHE
+    unsigned long hits0, misses0, hits, misses;
+#endif
+
+    log_text("Text runs");
+    rb->lcd_getstringsize(text, &w, &h);
+
+#ifdef HAVE_LCD_TEXT_CACHE
+    rb->lcd_text_cache_stats(&hits0, &misses0);
+#endif
+    /* redraw one line at moving offsets, like the scroll engine does */
+    line_count = 0;
+    rb->sleep(0); /* sync to tick */
+    time_start = *rb->current_tick;
+    while((time_end = *rb->current_tick) - time_start < DURATION)
+    {
+        rb->lcd_putsxy(-(line_count % w), line * h, text);
+        line_count++;
+    }
+    rb->snprintf(str, sizeof(str), "%ld lines/s",
+                 HZ * line_count / (time_end - time_start));
+    log_text(str);
+#ifdef HAVE_LCD_TEXT_CACHE
+    rb->lcd_text_cache_stats(&hits, &misses);
+    hits -= hits0;
+    misses -= misses0;
+    rb->snprintf(str, sizeof(str), "cache hits: %lu%%",
+                 100 * hits / MAX(hits + misses, 1));
+    log_text(str);
+#endif
+}
+
 #if defined(HAVE_LCD_COLOR) && (MEMORYSIZE > 2)
 
 #if LCD_WIDTH >= LCD_HEIGHT
@@ -404,8 +553,10 @@ enum plugin_status plugin_start(const void* parameter)
 
     backlight_ignore_timeout();
 
+    time_list_scroll();
     time_main_update();
     rb->sleep(HZ);
+    time_text_runs();
 #if defined(HAVE_LCD_COLOR) && (MEMORYSIZE > 2)
     time_main_yuv();
 #endif
@@ -35,6 +35,14 @@ static size_t gbuf_size = 0;
 #define DURATION (HZ) /* longer duration gives more precise results */
 #define RND_SEED 0x43A678C3     /* arbirary */
 
+#if defined(HAVE_LCD_SIMD) && !defined(TEST_GREYLIB)
+#define NUM_TESTS (8*4 + 2*4 + 2*2)
+#elif defined(HAVE_LCD_COLOR) && !defined(TEST_GREYLIB)
+#define NUM_TESTS (8*4)
+#else
+#define NUM_TESTS (7*4)
+#endif
+
 
 
 static uint16_t rand_table[0x400];
@@ -453,6 +461,125 @@ static void time_put_line(void) /* tests put_line performance */
                  count1, count2, count3, count4);
 }
 
+#if defined(HAVE_LCD_COLOR) && !defined(TEST_GREYLIB)
+/* native 64x64 image followed by its 4 bit alpha channel, like a bmp
+ * loaded with alpha */
+#define ALPHA_BMP_SIZE 64
+static unsigned char alpha_bmp_data[ALPHA_BMP_SIZE * ALPHA_BMP_SIZE *
+                                    sizeof(fb_data) +
+                                    ALPHA_BMP_SIZE * ALPHA_BMP_SIZE / 2];
+static struct bitmap alpha_bmp = {
+    .width = ALPHA_BMP_SIZE,
+    .height = ALPHA_BMP_SIZE,
+    .format = FORMAT_NATIVE,
+    .maskdata = NULL,
+    .alpha_offset = ALPHA_BMP_SIZE * ALPHA_BMP_SIZE * sizeof(fb_data),
+    .data = alpha_bmp_data,
+};
+
+static void init_alpha_bmp(void)
+{
+    fb_data *image = (fb_data *)alpha_bmp_data;
+    unsigned char *alpha = alpha_bmp_data + alpha_bmp.alpha_offset;
+    int x, y;
+
+    for (y = 0; y < ALPHA_BMP_SIZE; y++)
+    {
+        for (x = 0; x < ALPHA_BMP_SIZE; x++)
+            *image++ = FB_RGBPACK(x * 4, y * 4, 128);
+        for (x = 0; x < ALPHA_BMP_SIZE; x += 2)
+            *alpha++ = ((x ^ y) & 0x0f) | ((((x + 1) ^ y) & 0x0f) << 4);
+    }
+}
+
+static int count_alpha_bmp(int drawmode)
+{
+    long time_start;  /* start tickcount */
+    int count = 0;
+
+    mylcd_set_drawmode(drawmode);
+    rb->sleep(0); /* sync to tick */
+    time_start = *rb->current_tick;
+    while(*rb->current_tick - time_start < DURATION)
+    {
+        unsigned rnd = rand_table[count++ & 0x3ff];
+        rb->lcd_bmp_part(&alpha_bmp, 0, 0, (rnd >> 8) & 0x3f, rnd & 0x3f,
+                         ALPHA_BMP_SIZE, ALPHA_BMP_SIZE);
+    }
+    return count;
+}
+
+static void time_alpha_bmp(void) /* tests alpha_bitmap_part_mix performance */
+{
+    int count1, count2, count3, count4;
+
+    count1 = count_alpha_bmp(DRMODE_SOLID);
+    count2 = count_alpha_bmp(DRMODE_FG);
+    count3 = count_alpha_bmp(DRMODE_BG);
+    count4 = count_alpha_bmp(DRMODE_COMPLEMENT);
+
+    rb->fdprintf(log_fd, "lcd_bmp_part (alpha/s):   %d/%d/%d/%d\n",
+                 count1, count2, count3, count4);
+}
+#endif /* HAVE_LCD_COLOR && !TEST_GREYLIB */
+
+#if defined(HAVE_LCD_SIMD) && !defined(TEST_GREYLIB)
+static int count_fillrect(int drawmode)
+{
+    long time_start;  /* start tickcount */
+    int count = 0;
+
+    mylcd_set_drawmode(drawmode);
+    rb->sleep(0); /* sync to tick */
+    time_start = *rb->current_tick;
+    while(*rb->current_tick - time_start < DURATION)
+    {
+        unsigned rnd = rand_table[count++ & 0x3ff];
+        mylcd_fillrect(0, rnd & 0x3f, LCD_WIDTH, 64);
+    }
+    return count;
+}
+
+/* The scalar and vector kernels give the same pixels, so all this shows is
+ * the speed of each */
+static void time_simd(void)
+{
+    static const int modes[4] = {
+        DRMODE_SOLID, DRMODE_FG, DRMODE_BG, DRMODE_COMPLEMENT
+    };
+    int scalar[4], simd[4], i;
+
+    rb->fdprintf(log_fd, "\nSIMD speedup (scalar -> vector, per second):\n");
+
+    for (i = 0; i < 4; i++)
+    {
+        rb->lcd_set_simd(false);
+        scalar[i] = count_alpha_bmp(modes[i]);
+        rb->lcd_set_simd(true);
+        simd[i] = count_alpha_bmp(modes[i]);
+    }
+    for (i = 0; i < 4; i++)
+    {
+        int ratio = 100 * simd[i] / MAX(scalar[i], 1);
+        rb->fdprintf(log_fd, "    alpha bmp %d: %d -> %d (%d.%02dx)\n",
+                     i + 1, scalar[i], simd[i], ratio / 100, ratio % 100);
+    }
+
+    /* only solid fills and complement use the fill/invert kernels */
+    for (i = 0; i < 4; i += 3)
+    {
+        rb->lcd_set_simd(false);
+        scalar[i] = count_fillrect(modes[i]);
+        rb->lcd_set_simd(true);
+        simd[i] = count_fillrect(modes[i]);
+
+        int ratio = 100 * simd[i] / MAX(scalar[i], 1);
+        rb->fdprintf(log_fd, "    fillrect %d:  %d -> %d (%d.%02dx)\n",
+                     i + 1, scalar[i], simd[i], ratio / 100, ratio % 100);
+    }
+}
+#endif /* HAVE_LCD_SIMD && !TEST_GREYLIB */
+
 /* plugin entry point */
 enum plugin_status plugin_start(const void* parameter)
 {
@@ -499,8 +626,11 @@ enum plugin_status plugin_start(const void* parameter)
     backlight_ignore_timeout();
 
     rb->splashf(0, "LCD driver performance test, please wait %d sec",
-                7*4*DURATION/HZ);
+                NUM_TESTS*DURATION/HZ);
     init_rand_table();
+#if defined(HAVE_LCD_COLOR) && !defined(TEST_GREYLIB)
+    init_alpha_bmp();
+#endif
 
 #ifdef HAVE_ADJUSTABLE_CPU_FREQ
     cpu_freq = *rb->cpu_frequency; /* remember CPU frequency */
@@ -512,7 +642,13 @@ enum plugin_status plugin_start(const void* parameter)
     time_vline();
     time_fillrect();
     time_text();
+#if defined(HAVE_LCD_COLOR) && !defined(TEST_GREYLIB)
+    time_alpha_bmp();
+#endif
     time_put_line();
+#if defined(HAVE_LCD_SIMD) && !defined(TEST_GREYLIB)
+    time_simd();
+#endif
 
 #ifdef HAVE_ADJUSTABLE_CPU_FREQ
     if (*rb->cpu_frequency != cpu_freq)
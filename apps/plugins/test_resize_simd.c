@@ -0,0 +1,211 @@
+/***************************************************************************
+ *             __________               __   ___.
+ *   Open      \______   \ ____   ____ |  | _\_ |__   _______  ___
+ *   Source     |       _//  _ \_/ ___\|  |/ /| __ \ /  _ \  \/  /
+ *   Jukebox    |    |   (  <_> )  \___|    < | \_\ (  <_> > <  <
+ *   Firmware   |____|_  /\____/ \___  >__|_ \|___  /\____/__/\_ \
+ *                     \/            \/     \/    \/            \/
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ****************************************************************************/
+
+/* Checks that the SSE2/NEON row passes of the bitmap scaler give the same
+ * pixels as the scalar code. A noise bitmap with odd dimensions is written
+ * to disk and loaded with FORMAT_RESIZE to a set of odd sizes, once with
+ * and once without SIMD, covering the area and the linear scaler on both
+ * axes. The results are shown on screen and written to the log file.
+ */
+
+#include "plugin.h"
+
+#ifdef HAVE_RESIZE_SIMD
+#define TEST_BMP    PLUGIN_DATA_DIR "/test_resize_simd.bmp"
+#define LOG_FILE    PLUGIN_DATA_DIR "/test_resize_simd.txt"
+
+#define MAX_WIDTH   71
+
+struct resize_case {
+    int sw, sh; /* source */
+    int dw, dh; /* destination */
+};
+
+static const struct resize_case cases[] = {
+    /* area on both axes */
+    { 61, 47, 23, 17 },
+    { 61, 47, 37, 29 },
+    { 61, 47,  1,  1 },
+    /* linear on both axes */
+    { 13, 11, 41, 31 },
+    { 13, 11, 71, 61 },
+    /* area horizontally, linear vertically and the other way round */
+    { 61, 47, 23, 53 },
+    { 13, 11,  7, 29 },
+    { 13, 11, 45,  5 },
+};
+
+static int log_fd = -1;
+static int log_line;
+
+static void log_text(const char *fmt, ...)
+{
+    char buf[64];
+    va_list ap;
+
+    va_start(ap, fmt);
+    rb->vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    rb->lcd_puts(0, log_line++, buf);
+    rb->lcd_update();
+    if (log_fd >= 0)
+        rb->fdprintf(log_fd, "%s\n", buf);
+}
+
+static void put_le(unsigned char *p, uint32_t val, int bytes)
+{
+    while (bytes--)
+    {
+        *p++ = val & 0xff;
+        val >>= 8;
+    }
+}
+
+/* write a bottom-up 24 bit BMP of random pixels */
+static bool write_noise_bmp(int width, int height)
+{
+    unsigned char hdr[54], row[(MAX_WIDTH * 3 + 3) & ~3];
+    int padded_width = (width * 3 + 3) & ~3;
+    int fd, x, y;
+    bool ok = true;
+
+    rb->memset(hdr, 0, sizeof(hdr));
+    hdr[0] = 'B';
+    hdr[1] = 'M';
+    put_le(hdr + 2, sizeof(hdr) + padded_width * height, 4);
+    put_le(hdr + 10, sizeof(hdr), 4);   /* pixel data offset */
+    put_le(hdr + 14, 40, 4);            /* info header size */
+    put_le(hdr + 18, width, 4);
+    put_le(hdr + 22, height, 4);
+    put_le(hdr + 26, 1, 2);             /* planes */
+    put_le(hdr + 28, 24, 2);            /* bits per pixel */
+
+    fd = rb->open(TEST_BMP, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0)
+        return false;
+    if (rb->write(fd, hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr))
+        ok = false;
+    rb->memset(row, 0, sizeof(row));
+    for (y = 0; ok && y < height; y++)
+    {
+        for (x = 0; x < width * 3; x++)
+            row[x] = rb->rand() & 0xff;
+        if (rb->write(fd, row, padded_width) != padded_width)
+            ok = false;
+    }
+    rb->close(fd);
+    return ok;
+}
+
+static int load_resized(const struct resize_case *c, bool simd,
+                        unsigned char *buf, size_t buf_size)
+{
+    struct bitmap bm = {
+        .width = c->dw,
+        .height = c->dh,
+        .data = buf,
+    };
+    int ret;
+
+    rb->resize_set_simd(simd);
+    ret = rb->read_bmp_file(TEST_BMP, &bm, buf_size,
+                            FORMAT_NATIVE|FORMAT_RESIZE, NULL);
+    if (ret > 0 && (bm.width != c->dw || bm.height != c->dh))
+        ret = -1;
+    return ret;
+}
+
+static int run_case(const struct resize_case *c,
+                    unsigned char *buf, size_t buf_size)
+{
+    size_t half = (buf_size / 2) & ~3;
+    unsigned char *simd_buf = buf, *scalar_buf = buf + half;
+    int simd_size, scalar_size;
+
+    simd_size = load_resized(c, true, simd_buf, half);
+    scalar_size = load_resized(c, false, scalar_buf, half);
+
+    if (simd_size <= 0 || scalar_size <= 0)
+    {
+        log_text("%dx%d->%dx%d: load failed", c->sw, c->sh, c->dw, c->dh);
+        return 1;
+    }
+    if (simd_size != scalar_size ||
+        rb->memcmp(simd_buf, scalar_buf, simd_size))
+    {
+        log_text("%dx%d->%dx%d: MISMATCH", c->sw, c->sh, c->dw, c->dh);
+        return 1;
+    }
+    log_text("%dx%d->%dx%d: ok", c->sw, c->sh, c->dw, c->dh);
+    return 0;
+}
+
+/* this is the plugin entry point */
+enum plugin_status plugin_start(const void* parameter)
+{
+    size_t buf_size;
+    unsigned char *buf = rb->plugin_get_buffer(&buf_size);
+    int failed = 0, sw = 0, sh = 0;
+    unsigned int i;
+    bool was_enabled;
+
+    (void)parameter;
+
+    rb->lcd_clear_display();
+    log_fd = rb->open(LOG_FILE, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    rb->srand(0x5eed);
+    was_enabled = rb->resize_set_simd(true);
+
+    for (i = 0; i < ARRAYLEN(cases); i++)
+    {
+        if (cases[i].sw != sw || cases[i].sh != sh)
+        {
+            sw = cases[i].sw;
+            sh = cases[i].sh;
+            if (!write_noise_bmp(sw, sh))
+            {
+                log_text("Could not write %s", TEST_BMP);
+                failed++;
+                break;
+            }
+        }
+        failed += run_case(&cases[i], buf, buf_size);
+    }
+
+    rb->resize_set_simd(was_enabled);
+    rb->remove(TEST_BMP);
+    if (failed)
+        log_text("%d case(s) FAILED", failed);
+    else
+        log_text("All cases passed");
+    if (log_fd >= 0)
+        rb->close(log_fd);
+
+    while (rb->get_action(CONTEXT_STD, TIMEOUT_BLOCK) != ACTION_STD_CANCEL);
+    return failed ? PLUGIN_ERROR : PLUGIN_OK;
+}
+#else /* !HAVE_RESIZE_SIMD */
+enum plugin_status plugin_start(const void* parameter)
+{
+    (void)parameter;
+    rb->splash(HZ*2, "This build has no SIMD scaler");
+    return PLUGIN_OK;
+}
+#endif /* HAVE_RESIZE_SIMD */
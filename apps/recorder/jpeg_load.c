@@ -67,6 +67,10 @@ typedef uint8_t jpeg_pix_t;
 #define TRANSPOSE_EXTRA_IDCT_WS 0
 #endif
 #define IDCT_WS_SIZE (64 + TRANSPOSE_EXTRA_IDCT_WS + COLOR_EXTRA_IDCT_WS)
+#if (CONFIG_PLATFORM & PLATFORM_HOSTED)
+/* refill the bit buffer 32 bits at a time where possible */
+#define JPEG_WIDE_BITBUF
+#endif
 
 /* This can't be in jpeg_load.h because plugin.h includes it, and it conflicts
  * with the definition in jpeg_decoder.h
@@ -81,7 +85,11 @@ struct jpeg
     int buf_index;
 #endif
     unsigned long len;
+#ifdef JPEG_WIDE_BITBUF
+    uint64_t bitbuf;
+#else
     unsigned long int bitbuf;
+#endif
     int bitbuf_bits;
     int marker_ind;
     int marker_val;
@@ -92,6 +100,8 @@ struct jpeg
     int y_mbl; /* y dimension of MBL */
     int blocks; /* blocks per MB */
     int restart_interval; /* number of MCUs between RSTm markers */
+    bool progressive; /* SOF2 frame, decoded from the DC of the first scan */
+    int scan_al; /* successive approximation shift of the first scan */
     int restart; /* blocks until next restart marker */
     int mcu_row; /* current row relative to first row of this row of MCUs */
     unsigned char *out_ptr; /* pointer to current row to output */
@@ -601,6 +611,273 @@ extern void jpeg_idct8v(int16_t *ws, int16_t *end);
 extern void jpeg_idct8h(int16_t *ws, unsigned char *out, int16_t *end, int rowstep);
 #endif
 
+/* Hosted builds with 128-bit integer vectors run the full-size 8x8 IDCT on
+ * eight columns (or rows) at once. The multiplies are regrouped so that every
+ * product has a 16-bit input and a 16-bit constant, which maps onto pmaddwd
+ * and vmlal; by distributivity the 32-bit results are the same as those of
+ * jpeg_idct8v/jpeg_idct8h. The zero-AC shortcuts are dropped, they give the
+ * same output anyway. Partial blocks from scaled decodes still use the
+ * scalar versions.
+ */
+#if !defined(__PCTOOL__) && (CONFIG_PLATFORM & PLATFORM_HOSTED) && \
+    defined(JPEG_IDCT_TRANSPOSE) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define JPEG_IDCT_SIMD
+#if defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i jv16_t; /* eight int16_t lanes */
+typedef __m128i jv32_t; /* four int32_t lanes */
+typedef struct { __m128i lo, hi; } jvpair_t; /* two jv16_t, interleaved */
+#define JV_LOAD16(p)        _mm_loadu_si128((const __m128i *)(p))
+#define JV_STORE16(p, v)    _mm_storeu_si128((__m128i *)(p), (v))
+#define JV_STORE8(p, a, b)  _mm_storeu_si128((__m128i *)(p), \
+                                             _mm_packus_epi16((a), (b)))
+#define JV_DUP(k)           _mm_set1_epi32(k)
+#define JV_ADD(a, b)        _mm_add_epi32((a), (b))
+#define JV_SUB(a, b)        _mm_sub_epi32((a), (b))
+#define JV_SLL(a, n)        _mm_slli_epi32((a), (n))
+#define JV_SRA(a, n)        _mm_srai_epi32((a), (n))
+/* keep the low 16 bits of each lane, like a store to int16_t would */
+#define JV_NARROW(lo, hi) \
+    _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32((lo), 16), 16), \
+                    _mm_srai_epi32(_mm_slli_epi32((hi), 16), 16))
+#define JV_NARROW_SAT(lo, hi) _mm_packs_epi32((lo), (hi))
+
+static inline jvpair_t jv_pair(jv16_t a, jv16_t b)
+{
+    jvpair_t p = { _mm_unpacklo_epi16(a, b), _mm_unpackhi_epi16(a, b) };
+    return p;
+}
+
+/* a * ca + b * cb as int32 for lanes 0-3 (lo) and 4-7 (hi) */
+static inline void jv_madd(jvpair_t p, int ca, int cb, jv32_t *lo, jv32_t *hi)
+{
+    __m128i k = _mm_set1_epi32((ca & 0xffff) | ((unsigned)cb << 16));
+    *lo = _mm_madd_epi16(p.lo, k);
+    *hi = _mm_madd_epi16(p.hi, k);
+}
+
+static inline void jv_widen(jv16_t a, jv32_t *lo, jv32_t *hi)
+{
+    *lo = _mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16);
+    *hi = _mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16);
+}
+
+static inline void jv_transpose(jv16_t *r)
+{
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+#else /* __ARM_NEON */
+#include <arm_neon.h>
+typedef int16x8_t jv16_t;
+typedef int32x4_t jv32_t;
+typedef struct { int16x8_t a, b; } jvpair_t;
+#define JV_LOAD16(p)        vld1q_s16(p)
+#define JV_STORE16(p, v)    vst1q_s16((p), (v))
+#define JV_STORE8(p, a, b)  vst1q_u8((p), vcombine_u8(vqmovun_s16(a), \
+                                                      vqmovun_s16(b)))
+#define JV_DUP(k)           vdupq_n_s32(k)
+#define JV_ADD(a, b)        vaddq_s32((a), (b))
+#define JV_SUB(a, b)        vsubq_s32((a), (b))
+#define JV_SLL(a, n)        vshlq_n_s32((a), (n))
+#define JV_SRA(a, n)        vshrq_n_s32((a), (n))
+#define JV_NARROW(lo, hi)   vcombine_s16(vmovn_s32(lo), vmovn_s32(hi))
+#define JV_NARROW_SAT(lo, hi) vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))
+
+static inline jvpair_t jv_pair(jv16_t a, jv16_t b)
+{
+    jvpair_t p = { a, b };
+    return p;
+}
+
+static inline void jv_madd(jvpair_t p, int ca, int cb, jv32_t *lo, jv32_t *hi)
+{
+    *lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(p.a), ca),
+                      vget_low_s16(p.b), cb);
+    *hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(p.a), ca),
+                      vget_high_s16(p.b), cb);
+}
+
+static inline void jv_widen(jv16_t a, jv32_t *lo, jv32_t *hi)
+{
+    *lo = vmovl_s16(vget_low_s16(a));
+    *hi = vmovl_s16(vget_high_s16(a));
+}
+
+static inline void jv_transpose(jv16_t *r)
+{
+    int16x8x2_t b01 = vtrnq_s16(r[0], r[1]);
+    int16x8x2_t b23 = vtrnq_s16(r[2], r[3]);
+    int16x8x2_t b45 = vtrnq_s16(r[4], r[5]);
+    int16x8x2_t b67 = vtrnq_s16(r[6], r[7]);
+    int32x4x2_t c02 = vtrnq_s32(vreinterpretq_s32_s16(b01.val[0]),
+                                vreinterpretq_s32_s16(b23.val[0]));
+    int32x4x2_t c13 = vtrnq_s32(vreinterpretq_s32_s16(b01.val[1]),
+                                vreinterpretq_s32_s16(b23.val[1]));
+    int32x4x2_t c46 = vtrnq_s32(vreinterpretq_s32_s16(b45.val[0]),
+                                vreinterpretq_s32_s16(b67.val[0]));
+    int32x4x2_t c57 = vtrnq_s32(vreinterpretq_s32_s16(b45.val[1]),
+                                vreinterpretq_s32_s16(b67.val[1]));
+#define JV_COMBINE(x, y, half) vreinterpretq_s16_s32(vcombine_s32( \
+    vget_##half##_s32(x), vget_##half##_s32(y)))
+    r[0] = JV_COMBINE(c02.val[0], c46.val[0], low);
+    r[1] = JV_COMBINE(c13.val[0], c57.val[0], low);
+    r[2] = JV_COMBINE(c02.val[1], c46.val[1], low);
+    r[3] = JV_COMBINE(c13.val[1], c57.val[1], low);
+    r[4] = JV_COMBINE(c02.val[0], c46.val[0], high);
+    r[5] = JV_COMBINE(c13.val[0], c57.val[0], high);
+    r[6] = JV_COMBINE(c02.val[1], c46.val[1], high);
+    r[7] = JV_COMBINE(c13.val[1], c57.val[1], high);
+#undef JV_COMBINE
+}
+#endif /* __SSE2__ / __ARM_NEON */
+
+/* Constants of the regrouped odd part: e.g. tmp0 of jpeg_idct8v equals
+ * y7 * (c0.298 - c0.899 - c1.961 + c1.175) + y1 * (c1.175 - c0.899)
+ * + y3 * (c1.175 - c1.961) + y5 * c1.175
+ */
+#define O_77 (FIX_0_298631336 - FIX_0_899976223 - FIX_1_961570560 \
+              + FIX_1_175875602)
+#define O_55 (FIX_2_053119869 - FIX_2_562915447 - FIX_0_390180644 \
+              + FIX_1_175875602)
+#define O_33 (FIX_3_072711026 - FIX_2_562915447 - FIX_1_961570560 \
+              + FIX_1_175875602)
+#define O_11 (FIX_1_501321110 - FIX_0_899976223 - FIX_0_390180644 \
+              + FIX_1_175875602)
+#define O_17 (FIX_1_175875602 - FIX_0_899976223)
+#define O_37 (FIX_1_175875602 - FIX_1_961570560)
+#define O_35 (FIX_1_175875602 - FIX_2_562915447)
+#define O_15 (FIX_1_175875602 - FIX_0_390180644)
+
+/* 8-point IDCT on eight lanes, v[k] holding coefficient k of each lane. The
+ * DC term is biased by pre before and by post after scaling up; outputs are
+ * returned unshifted in lo[] (lanes 0-3) and hi[] (lanes 4-7).
+ */
+static inline void jpeg_idct8_lanes(jv16_t *v, int pre, int post,
+                                    jv32_t *lo, jv32_t *hi)
+{
+    jv32_t e0l, e0h, e1l, e1h, e2l, e2h, e3l, e3h;
+    jv32_t ol, oh, tl, th;
+    jvpair_t p26 = jv_pair(v[2], v[6]);
+    jvpair_t p13 = jv_pair(v[1], v[3]);
+    jvpair_t p57 = jv_pair(v[5], v[7]);
+
+    /* Even part */
+    jv_madd(p26, FIX_0_541196100,
+                 FIX_0_541196100 - FIX_1_847759065, &e2l, &e2h);
+    jv_madd(p26, FIX_0_541196100 + FIX_0_765366865,
+                 FIX_0_541196100, &e3l, &e3h);
+
+    jv_widen(v[0], &e0l, &e0h);
+    jv_widen(v[4], &tl, &th);
+    e0l = JV_ADD(JV_SLL(JV_ADD(e0l, JV_DUP(pre)), CONST_BITS), JV_DUP(post));
+    e0h = JV_ADD(JV_SLL(JV_ADD(e0h, JV_DUP(pre)), CONST_BITS), JV_DUP(post));
+    tl = JV_SLL(tl, CONST_BITS);
+    th = JV_SLL(th, CONST_BITS);
+    e1l = JV_SUB(e0l, tl);
+    e1h = JV_SUB(e0h, th);
+    e0l = JV_ADD(e0l, tl);
+    e0h = JV_ADD(e0h, th);
+
+    /* tmp10 .. tmp13 */
+    tl = e0l; th = e0h;
+    e0l = JV_ADD(tl, e3l); e0h = JV_ADD(th, e3h);
+    e3l = JV_SUB(tl, e3l); e3h = JV_SUB(th, e3h);
+    tl = e1l; th = e1h;
+    e1l = JV_ADD(tl, e2l); e1h = JV_ADD(th, e2h);
+    e2l = JV_SUB(tl, e2l); e2h = JV_SUB(th, e2h);
+
+    /* Odd part, each output paired with its even counterpart */
+#define IDCT8_ODD(c1, c3, c5, c7, el, eh, a, b) \
+    jv_madd(p13, (c1), (c3), &ol, &oh); \
+    jv_madd(p57, (c5), (c7), &tl, &th); \
+    ol = JV_ADD(ol, tl); \
+    oh = JV_ADD(oh, th); \
+    lo[a] = JV_ADD(el, ol); hi[a] = JV_ADD(eh, oh); \
+    lo[b] = JV_SUB(el, ol); hi[b] = JV_SUB(eh, oh);
+
+    IDCT8_ODD(O_11, FIX_1_175875602, O_15, O_17, e0l, e0h, 0, 7)
+    IDCT8_ODD(FIX_1_175875602, O_33, O_35, O_37, e1l, e1h, 1, 6)
+    IDCT8_ODD(O_15, O_35, O_55, FIX_1_175875602, e2l, e2h, 2, 5)
+    IDCT8_ODD(O_17, O_37, FIX_1_175875602, O_77, e3l, e3h, 3, 4)
+#undef IDCT8_ODD
+}
+
+/* vertical-pass 8-point IDCT, all eight columns at once */
+static void jpeg_idct8v_simd(int16_t *ws, int16_t *end)
+{
+    jv16_t v[8];
+    jv32_t lo[8], hi[8];
+    int k;
+
+    if (end - ws != 64)
+    {
+        jpeg_idct8v(ws, end);
+        return;
+    }
+    /* columns are stored contiguously, transpose to get one per lane */
+    for (k = 0; k < 8; k++)
+        v[k] = JV_LOAD16(ws + 8*k);
+    jv_transpose(v);
+    jpeg_idct8_lanes(v, 0, ONE << (CONST_BITS - PASS1_BITS - 1), lo, hi);
+    for (k = 0; k < 8; k++)
+        JV_STORE16(ws + 64 + 8*k,
+                   JV_NARROW(JV_SRA(lo[k], CONST_BITS - PASS1_BITS),
+                             JV_SRA(hi[k], CONST_BITS - PASS1_BITS)));
+}
+
+/* horizontal-pass 8-point IDCT, all eight rows at once */
+static void jpeg_idct8h_simd(int16_t *ws, unsigned char *out, int16_t *end,
+                             int rowstep)
+{
+    jv16_t v[8];
+    jv32_t lo[8], hi[8];
+    unsigned char pix[8][8] __attribute__((aligned(16)));
+    int i, k;
+
+    if (end - ws != 64)
+    {
+        jpeg_idct8h(ws, out, end, rowstep);
+        return;
+    }
+    for (k = 0; k < 8; k++)
+        v[k] = JV_LOAD16(ws + 8*k);
+    jv_transpose(v);
+    jpeg_idct8_lanes(v, (ONE << (PASS1_BITS + 2)) + (128 << (PASS1_BITS + 3)),
+                     0, lo, hi);
+    /* descale, then saturate to 0..255 like range_limit() */
+    for (k = 0; k < 8; k++)
+        v[k] = JV_NARROW_SAT(JV_SRA(lo[k], DS_OUT), JV_SRA(hi[k], DS_OUT));
+    for (k = 0; k < 8; k += 2)
+        JV_STORE8(pix[k], v[k], v[k + 1]);
+    for (i = 0; i < 8; i++, out += rowstep)
+        for (k = 0; k < 8; k++)
+            out[JPEG_PIX_SZ*k] = pix[k][i];
+}
+#endif /* JPEG_IDCT_SIMD */
+
 #ifdef HAVE_LCD_COLOR
 /* vertical-pass 16-point IDCT */
 static void jpeg_idct16v(int16_t *ws, int16_t *end)
@@ -833,7 +1110,11 @@ static const struct idct_entry idct_tbl[] = {
     { PASS1_BITS, NULL, jpeg_idct1h },
     { PASS1_BITS, jpeg_idct2v, jpeg_idct2h },
     { 0, jpeg_idct4v, jpeg_idct4h },
+#ifdef JPEG_IDCT_SIMD
+    { 0, jpeg_idct8v_simd, jpeg_idct8h_simd },
+#else
     { 0, jpeg_idct8v, jpeg_idct8h },
+#endif
 #ifdef HAVE_LCD_COLOR
     { 0, jpeg_idct16v, jpeg_idct16h },
 #endif
@@ -871,6 +1152,14 @@ INLINE void jpeg_putc(struct jpeg* p_jpeg)
     p_jpeg->len++;
     p_jpeg->data--;
 }
+
+#ifdef JPEG_WIDE_BITBUF
+/* return the next count bytes without consuming them, if they are at hand */
+INLINE unsigned char *jpeg_peek(struct jpeg* p_jpeg, unsigned int count)
+{
+    return LIKELY(p_jpeg->len >= count) ? p_jpeg->data : NULL;
+}
+#endif
 #else
 INLINE void fill_buf(struct jpeg* p_jpeg)
 {
@@ -912,6 +1201,15 @@ static void jpeg_putc(struct jpeg* p_jpeg)
     p_jpeg->buf_left++;
     p_jpeg->buf_index--;
 }
+
+#ifdef JPEG_WIDE_BITBUF
+/* return the next count bytes without consuming them, if they are buffered */
+INLINE unsigned char *jpeg_peek(struct jpeg* p_jpeg, int count)
+{
+    return LIKELY(p_jpeg->buf_left >= count) ?
+        p_jpeg->buf + p_jpeg->buf_index : NULL;
+}
+#endif
 #endif
 
 #define e_skip_bytes(jpeg, count) \
@@ -962,6 +1260,10 @@ static int process_markers(struct jpeg* p_jpeg)
         case 0x00: /* Zero stuffed byte */
             break; /* discard */
 
+        case 0xC2: /* SOF Huff  - Progressive DCT*/
+            /* Only the first (DC) scan is decoded, see clip_jpeg_fd() */
+            p_jpeg->progressive = true;
+            /* fall through */
         case 0xC0: /* SOF Huff  - Baseline DCT */
             {
                 JDEBUGF("SOF marker ");
@@ -1004,7 +1306,6 @@ static int process_markers(struct jpeg* p_jpeg)
             break;
 
         case 0xC1: /* SOF Huff  - Extended sequential DCT*/
-        case 0xC2: /* SOF Huff  - Progressive DCT*/
         case 0xC3: /* SOF Huff  - Spatial (sequential) lossless*/
         case 0xC5: /* SOF Huff  - Differential sequential DCT*/
         case 0xC6: /* SOF Huff  - Differential progressive DCT*/
@@ -1116,6 +1417,22 @@ static int process_markers(struct jpeg* p_jpeg)
                     p_jpeg->scanheader[i].AC_select = c & 0x0F;
                     marker_size -= 2;
                 }
+                if (p_jpeg->progressive)
+                {
+                    /* spectral selection and successive approximation */
+                    int ss = e_getc(p_jpeg, -1);
+                    int se = e_getc(p_jpeg, -1);
+                    c = e_getc(p_jpeg, -1);
+                    marker_size -= 3;
+                    /* The first scan must be a DC first pass covering every
+                     * component, so that it can be streamed like a baseline
+                     * scan.
+                     */
+                    if (ss != 0 || se != 0 || (c >> 4) != 0 ||
+                        n != p_jpeg->blocks)
+                        return (-4); /* unsupported progressive scan order */
+                    p_jpeg->scan_al = c & 0x0F;
+                }
                 /* skip spectral information */
                 e_skip_bytes(p_jpeg, marker_size);
                 done = true;
@@ -1565,6 +1882,22 @@ static void fill_bit_buffer(struct jpeg* p_jpeg)
 {
     unsigned char byte, marker;
 
+#ifdef JPEG_WIDE_BITBUF
+    /* Fast path: four bytes of plain entropy data (no 0xFF, so no stuffing
+     * or markers) go straight into the buffer. Callers never ask for more
+     * than 16 bits, so there are always fewer than 32 left at this point.
+     */
+    unsigned char *p = jpeg_peek(p_jpeg, 4);
+    if (LIKELY(p) && !p_jpeg->marker_val &&
+        p[0] != 0xFF && p[1] != 0xFF && p[2] != 0xFF && p[3] != 0xFF)
+    {
+        p_jpeg->bitbuf = (p_jpeg->bitbuf << 32) | ((uint32_t)p[0] << 24) |
+                         (p[1] << 16) | (p[2] << 8) | p[3];
+        p_jpeg->bitbuf_bits += 32;
+        skip_bytes(p_jpeg, 4);
+        return;
+    }
+#endif
     if (p_jpeg->marker_val)
         p_jpeg->marker_ind += 16;
     byte = d_getc(p_jpeg, 0);
@@ -1805,7 +2138,7 @@ static struct img_part *store_row_jpeg(void *jpeg_args)
                 if (!ci)
 #endif
                 {
-                    s = HUFF_EXTEND(r, s);
+                    s = HUFF_EXTEND(r, s) << p_jpeg->scan_al;
 #ifdef HAVE_LCD_COLOR
                     p_jpeg->last_dc_val[ci] += s;
                     /* output it (assumes zag[0] = 0) */
@@ -1819,6 +2152,9 @@ static struct img_part *store_row_jpeg(void *jpeg_args)
 #endif
                     /* coefficient buffer must be cleared */
                     MEMSET(block+1, 0, p_jpeg->zero_need[!!ci] * sizeof(int));
+                    /* a progressive DC scan carries no AC coefficients */
+                    if (p_jpeg->progressive)
+                        goto block_end;
                     /* Section F.2.2.2: decode the AC coefficients */
                     while(true)
                     {
@@ -1849,6 +2185,8 @@ static struct img_part *store_row_jpeg(void *jpeg_args)
                             goto block_end;
                     }  /* for k */
                 }
+                if (p_jpeg->progressive)
+                    goto block_end;
                 for (; k < 64; k++)
                 {
                     huff_decode_ac(p_jpeg, actbl, s);
@@ -2083,6 +2421,19 @@ int clip_jpeg_fd(int fd,
     }
     p_jpeg->h_scale[0] = calc_scale(p_jpeg->x_size, bm->width);
     p_jpeg->v_scale[0] = calc_scale(p_jpeg->y_size, bm->height);
+    if (p_jpeg->progressive)
+    {
+        /* Only the DC coefficients of the first scan are read, giving the
+         * image at 1/8 size without buffering any coefficients. The scaler
+         * brings that to the requested size, upscaling if it asked for more.
+         * Full size decodes would need the whole coefficient buffer.
+         */
+        if ((!resize && (p_jpeg->h_scale[0] || p_jpeg->v_scale[0])) ||
+            p_jpeg->x_size < 8 || p_jpeg->y_size < 8)
+            return -4;
+        p_jpeg->h_scale[0] = 0;
+        p_jpeg->v_scale[0] = 0;
+    }
     JDEBUGF("luma IDCT size: %dx%d\n", BIT_N(p_jpeg->h_scale[0]),
         BIT_N(p_jpeg->v_scale[0]));
     if ((p_jpeg->x_size << p_jpeg->h_scale[0]) >> 3 == bm->width &&
@@ -43,6 +43,15 @@
 #define MAX_SC_STACK_ALLOC 0
 #define HAVE_UPSCALER 1
 
+/* the vertical row passes run four lanes at a time with SSE2/NEON; the result
+ * is the same as the scalar code, resize_set_simd() only exists for tests */
+#if !defined(__PCTOOL__) && \
+    (((CONFIG_PLATFORM & PLATFORM_HOSTED) && defined(__SSE2__)) || \
+     defined(__ARM_NEON))
+#define HAVE_RESIZE_SIMD
+extern bool resize_set_simd(bool enable); /* returns the previous state */
+#endif
+
 #define SC_OUT(n, c) (((n) + (1 << 23)) >> 24)
 #ifndef SC_OUT
 #define SC_OUT(n, c) (sc_mul_u32_rnd(n, (c)->recip))
@@ -242,6 +242,7 @@ struct screen screens[NB_SCREENS] =
         .gradient_fillrect_part = lcd_gradient_fillrect_part,
 #endif
         .put_line = screen_helper_put_line,
+        .update_damage=&lcd_update_damage,
     },
 #if NB_SCREENS == 2
     {
@@ -328,6 +329,7 @@ struct screen screens[NB_SCREENS] =
         .backdrop_show=&remote_backdrop_show,
 #endif
         .put_line = screen_helper_remote_put_line,
+        .update_damage=&lcd_remote_update,
     }
 #endif /* NB_SCREENS == 2 */
 };
@@ -140,6 +140,7 @@ struct screen
     void (*nine_segment_bmp)(const struct bitmap* bm, int x, int y,
                                 int width, int height);
     void (*put_line)(int x, int y, struct line_desc *line, const char *fmt, ...);
+    void (*update_damage)(void);
 };
 
 /*
@@ -66,6 +66,9 @@
 #ifdef APPLICATION
 #include <unistd.h> /* readlink() */
 #include <limits.h> /* PATH_MAX */
+#ifndef WIN32
+#include <sys/mman.h> /* mmap() */
+#endif
 #endif
 #include "config.h"
 #include "ata_idle_notify.h"
@@ -106,6 +109,16 @@
  */
 #define TAGCACHE_SUPPORT_FOREIGN_ENDIAN
 
+/*
+ * Serve disk searches from read-only mappings of the database files
+ * instead of lseek()/read(). Needs open() to return real OS descriptors,
+ * so this is only possible on hosted application builds.
+ */
+#if defined(APPLICATION) && !defined(WIN32) && \
+    !defined(PLUGIN) && !defined(__PCTOOL__)
+#define TAGCACHE_MMAP
+#endif
+
 /* Allow a little drift to the filename ordering (should not be too high/low). */
 #define POS_HISTORY_COUNT 4
 
@@ -115,6 +128,20 @@
 /* Tag Cache Header version 'TCHxx'. Increment when changing internal structures. */
 #define TAGCACHE_MAGIC  0x54434810
 
+/* Trigram index header version 'TCNxx'. */
+#define TAGCACHE_NGRAM_MAGIC 0x54434e01
+
+/* Number of hash buckets in a trigram index (must be a power of two). */
+#define NGRAM_BUCKET_BITS 12
+#define NGRAM_BUCKETS     (1 << NGRAM_BUCKET_BITS)
+
+/* Largest posting list loaded to narrow down a search. Longer lists would
+ * not skip enough entries to pay for themselves. */
+#define NGRAM_MAX_CANDIDATES 2048
+
+/* Statistics journal header version 'TCJxx'. */
+#define TAGCACHE_JOURNAL_MAGIC 0x54434a01
+
 /* Dump store/restore header version 'TCSxx'. */
 #define TAGCACHE_STATEFILE_MAGIC 0x54435301
 
@@ -133,6 +160,10 @@
 /* Max events in the internal tagcache command queue. */
 #define TAGCACHE_COMMAND_QUEUE_LENGTH 32
 
+/* Statistics updates kept in the journal before they are compacted into
+ * the master index. Idle compaction starts at half of this. */
+#define TAGCACHE_JOURNAL_LENGTH 256
+
 /* Idle time before committing events in the command queue. */
 #define TAGCACHE_COMMAND_QUEUE_COMMIT_DELAY  HZ*2
 
@@ -148,6 +179,12 @@
 /* The main database string data. */
 #define TAGCACHE_FILE_INDEX      "database_%d.tcd"
 
+/* Trigram index of a string tag file, used to speed up text clauses. */
+#define TAGCACHE_FILE_NGRAM      "database_ngram_%d.tcd"
+
+/* Append-only journal of runtime statistics updates. */
+#define TAGCACHE_FILE_JOURNAL    "database_stats.tcd"
+
 /* ASCII dumpfile of the DB contents. */
 #define TAGCACHE_FILE_CHANGELOG  "database_changelog.txt"
 
@@ -200,6 +237,11 @@ static int tempbuf_handle;
     (1LU << tag_albumartist) | (1LU << tag_grouping) | (1LU << tag_title) | \
     (1LU << tag_virt_canonicalartist))
 
+/* Tags that get a trigram index for substring clauses. */
+#define TAGCACHE_NGRAM_TAGS ((1LU << tag_artist) | (1LU << tag_album) | \
+    (1LU << tag_title) | (1LU << tag_filename))
+#define TAGCACHE_HAS_NGRAM(tag) (BIT_N(tag) & TAGCACHE_NGRAM_TAGS)
+
 /* Uniqued tags (we can use these tags with filters and conditional clauses). */
 #define TAGCACHE_UNIQUE_TAGS ((1LU << tag_artist) | (1LU << tag_album) | \
     (1LU << tag_genre) | (1LU << tag_composer) | (1LU << tag_comment) | \
@@ -242,6 +284,9 @@ static const char * const tag_type_str[] = {
 /* Status information of the tagcache. */
 static struct tagcache_stat tc_stat;
 
+/* Bumped whenever search results may change, see tagcache_get_change_serial() */
+static volatile unsigned long change_serial;
+
 /* Queue commands. */
 enum tagcache_queue {
     Q_STOP_SCAN = 0,
@@ -262,11 +307,27 @@ struct tagcache_command_entry {
     int32_t data;
 };
 
+/* Statistics journal record. check is ~(idx_id ^ tag ^ data) on disk so
+ * that a torn write at the end of the journal is detected on replay. */
+struct stats_journal_entry {
+    int32_t idx_id;
+    int32_t tag;
+    int32_t data;
+    int32_t check;
+};
+
 #ifndef __PCTOOL__
 static struct tagcache_command_entry command_queue[TAGCACHE_COMMAND_QUEUE_LENGTH];
 static volatile int command_queue_widx = 0;
 static volatile int command_queue_ridx = 0;
 static struct mutex command_queue_mutex SHAREDBSS_ATTR;
+
+/* Updates in the journal that are not in the master index yet. The first
+ * stats_journal_written of them are on disk. Protected by
+ * command_queue_mutex. */
+static struct stats_journal_entry stats_journal[TAGCACHE_JOURNAL_LENGTH];
+static int stats_journal_count;
+static int stats_journal_written;
 #endif
 
 /* Tag database structures. */
@@ -291,6 +352,28 @@ struct tagcache_header {
     int32_t entry_count; /* Number of entries in this file */
 };
 
+/* Trigram index header. It is followed by NGRAM_BUCKETS + 1 posting list
+ * start positions and the posting lists themselves, each an ascending
+ * list of int32_t seeks into the tag file. The index is only valid for
+ * the tag file revision whose entry count and data size it records. */
+struct ngram_header {
+    int32_t magic;       /* Header version number */
+    int32_t tag_datasize;    /* datasize of the indexed tag file */
+    int32_t tag_entry_count; /* entry_count of the indexed tag file */
+    int32_t posting_count;   /* Total number of postings */
+};
+
+/* Hash a case folded trigram to its bucket in the trigram index. Folding
+ * matches the ASCII-only case folding of strcasecmp/strcasestr. */
+static inline unsigned int ngram_bucket(const char *s)
+{
+    uint32_t h = (uint32_t)tolower((unsigned char)s[0])
+               | (uint32_t)tolower((unsigned char)s[1]) << 8
+               | (uint32_t)tolower((unsigned char)s[2]) << 16;
+
+    return (h * 2654435761u) >> (32 - NGRAM_BUCKET_BITS);
+}
+
 struct master_header {
     struct tagcache_header tch;
     int32_t serial; /* Increasing counting number */
@@ -659,6 +742,100 @@ static int open_master_fd(struct master_header *hdr, bool write)
     return fd;
 }
 
+#ifdef TAGCACHE_MMAP
+/* Read-only mappings of the string tag files and, in the last slot, of
+ * the master index. They are created on demand by searches and dropped
+ * before a commit rewrites the files. The mappings share the page cache
+ * with the files, so in-place updates stay visible. */
+#define TC_MMAP_MASTER TAG_COUNT
+
+static struct tc_mapping
+{
+    const char *base; /* NULL if not mapped */
+    size_t size;      /* File size at the time it was mapped */
+    bool failed;      /* Don't retry until the next drop */
+} tc_mappings[TAG_COUNT + 1];
+
+static void tc_mmap_drop_all(void)
+{
+    for (int i = 0; i <= TC_MMAP_MASTER; i++)
+    {
+        struct tc_mapping *m = &tc_mappings[i];
+
+        if (m->base)
+            munmap((void *)m->base, m->size);
+
+        m->base = NULL;
+        m->size = 0;
+        m->failed = false;
+    }
+}
+
+/* Return a pointer to len bytes at offset of a mapped database file, or
+ * NULL if it can't be mapped or doesn't cover the range (the file grew
+ * since it was mapped). Foreign endian databases are never mapped. */
+static const void *tc_mmap_get(int file, long offset, long len)
+{
+    struct tc_mapping *m = &tc_mappings[file];
+
+    if (!m->base && !m->failed && !tc_stat.econ)
+    {
+        char fname[MAX_PATH];
+        int fd;
+
+        m->failed = true;
+
+        if (file == TC_MMAP_MASTER)
+            fd = open_db_fd(TAGCACHE_FILE_MASTER, O_RDONLY);
+        else
+            fd = open_pathfmt(fname, sizeof(fname), O_RDONLY,
+                              "%s/" TAGCACHE_FILE_INDEX, tc_stat.db_path,
+                              file);
+        if (fd < 0)
+            return NULL;
+
+        off_t size = filesize(fd);
+        if (size > 0)
+        {
+            void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                m->base = p;
+                m->size = size;
+                m->failed = false;
+                logf("mmap: file %d, %ld bytes", file, (long)size);
+            }
+        }
+
+        close(fd);
+    }
+
+    if (!m->base || offset < 0 || len < 0 ||
+        (size_t)offset + (size_t)len > m->size)
+        return NULL;
+
+    return m->base + offset;
+}
+#endif /* TAGCACHE_MMAP */
+
+/* Drop the trigram indices before their tag files change, so that an
+ * interrupted commit never leaves an index that misses entries. */
+static void remove_ngram_files(void)
+{
+    char buf[MAX_PATH];
+    int i;
+
+    for (i = 0; i < TAG_COUNT; i++)
+    {
+        if (!TAGCACHE_HAS_NGRAM(i))
+            continue;
+
+        snprintf(buf, sizeof(buf), "%s/" TAGCACHE_FILE_NGRAM,
+                 tc_stat.db_path, i);
+        remove(buf);
+    }
+}
+
 static void remove_files(void)
 {
     int i;
@@ -669,6 +846,14 @@ static void remove_files(void)
     tc_stat.ready = false;
     tc_stat.ramcache = false;
     tc_stat.econ = false;
+#ifdef TAGCACHE_MMAP
+    tc_mmap_drop_all();
+#endif
+#ifndef __PCTOOL__
+    /* Journaled updates refer to entries of the old master index */
+    remove_db_file(TAGCACHE_FILE_JOURNAL);
+    stats_journal_count = stats_journal_written = 0;
+#endif
     remove_db_file(TAGCACHE_FILE_MASTER);
     for (i = 0; i < TAG_COUNT; i++)
     {
@@ -679,6 +864,7 @@ static void remove_files(void)
                  tc_stat.db_path, i);
         remove(buf);
     }
+    remove_ngram_files();
 }
 
 static bool check_all_headers(void)
@@ -1053,6 +1239,8 @@ static bool write_index(int masterfd, int idxid, struct index_entry *idx)
         return false;
     }
 
+    change_serial++;
+
 #ifdef HAVE_TC_RAMCACHE
     /* Only update numeric data. Writing the whole index to RAM by memcpy
      * destroys dircache pointers!
@@ -1107,6 +1295,63 @@ static bool open_files(struct tagcache_search *tcs, int tag)
     return true;
 }
 
+/* Read the tag file entry at seek for a search. *str must point to a
+ * buffer of bufsz bytes; when the file is mapped, *str is pointed at the
+ * mapped string instead of copying it. */
+static enum e_read_errors read_tag_at(struct tagcache_search *tcs, int tag,
+                                      long seek, struct tagfile_entry *tfe,
+                                      char **str, int bufsz)
+{
+#ifdef TAGCACHE_MMAP
+    const struct tagfile_entry *ep = tc_mmap_get(tag, seek, sizeof(*tfe));
+
+    if (ep && tc_mmap_get(tag, seek + sizeof(*tfe), ep->tag_length))
+    {
+        *tfe = *ep;
+        if (tfe->tag_length >= bufsz)
+            return e_TAG_TOOLONG;
+        if (tfe->tag_length == 0)
+        {
+            str_setlen(*str, 0);
+            return e_SUCCESS_LEN_ZERO;
+        }
+        if (ep->tag_data[tfe->tag_length - 1] == '\0')
+        {
+            *str = (char *)ep->tag_data;
+            return e_SUCCESS;
+        }
+        /* Not terminated in the file, take the copying path */
+    }
+#endif /* TAGCACHE_MMAP */
+
+    lseek(tcs->idxfd[tag], seek, SEEK_SET);
+    return read_tagfile_entry_and_tag(tcs->idxfd[tag], tfe, *str, bufsz);
+}
+
+/* Read the master index entry at the search's seek_pos. Without a
+ * mapping the stream must already be positioned there. */
+static bool read_master_entry(struct tagcache_search *tcs,
+                              struct index_entry *entry)
+{
+#ifdef TAGCACHE_MMAP
+    long offset = sizeof(struct master_header)
+                + tcs->seek_pos * sizeof(struct index_entry);
+    const struct index_entry *ep =
+        tc_mmap_get(TC_MMAP_MASTER, offset, sizeof(*entry));
+
+    if (ep)
+    {
+        *entry = *ep;
+        return true;
+    }
+
+    /* Mapped reads don't move the stream */
+    lseek(tcs->masterfd, offset, SEEK_SET);
+#endif /* TAGCACHE_MMAP */
+
+    return read_index_entries(tcs->masterfd, entry, 1) == sizeof(*entry);
+}
+
 static bool retrieve(struct tagcache_search *tcs, IF_DIRCACHE(int idx_id,)
                      struct index_entry *idx, int tag, char *buf, long bufsz)
 {
@@ -1154,8 +1399,8 @@ static bool retrieve(struct tagcache_search *tcs, IF_DIRCACHE(int idx_id,)
 
     if (!success && open_files(tcs, tag))
     {
-        lseek(tcs->idxfd[tag], seek, SEEK_SET);
-        switch (read_tagfile_entry_and_tag(tcs->idxfd[tag], &tfe, buf, bufsz))
+        char *str = buf;
+        switch (read_tag_at(tcs, tag, seek, &tfe, &str, bufsz))
         {
             case e_ENTRY_SIZEMISMATCH:
                 logf("read error #5");
@@ -1171,6 +1416,8 @@ static bool retrieve(struct tagcache_search *tcs, IF_DIRCACHE(int idx_id,)
                 break;
             case e_SUCCESS_LEN_ZERO:
             case e_SUCCESS:
+                if (str != buf)
+                    strmemccpy(buf, str, bufsz);
                 success = true;
                 break;
         }
@@ -1230,6 +1477,29 @@ static long tc_find_tag(int tag, int idx_id, const struct index_entry *idx)
             return result;
         }
     }
+
+    if (stats_journal_count > 0 && TAGCACHE_IS_NUMERIC(tag))
+    {
+        /* Updates in the journal haven't reached the master index yet */
+        long result = -1;
+
+        mutex_lock(&command_queue_mutex);
+
+        for (int i = stats_journal_count - 1; i >= 0; i--)
+        {
+            if (stats_journal[i].idx_id == idx_id
+                && stats_journal[i].tag == tag)
+            {
+                result = stats_journal[i].data;
+                break;
+            }
+        }
+
+        mutex_unlock(&command_queue_mutex);
+
+        if (result >= 0)
+            return result;
+    }
 #else
     (void)idx_id;
 #endif
@@ -1506,10 +1776,7 @@ static bool check_clauses(struct tagcache_search *tcs,
                 if (tag == tag_virt_basename)
                     tag = tag_filename;
 
-                int fd = tcs->idxfd[tag];
-                lseek(fd, seek, SEEK_SET);
-
-                switch (read_tagfile_entry_and_tag(fd, &tfe, str, bufsz))
+                switch (read_tag_at(tcs, tag, seek, &tfe, &str, bufsz))
                 {
                     case e_SUCCESS_LEN_ZERO: /* Check if entry has been deleted. */
                         return false;
@@ -1605,6 +1872,172 @@ static bool add_uniqbuf(struct tagcache_search *tcs, uint32_t id)
     return true;
 }
 
+/* Candidate tag file seeks loaded from the trigram index for one search. */
+static struct
+{
+    const struct tagcache_search *owner;
+    int tag;
+    int count;
+    int32_t seeks[NGRAM_MAX_CANDIDATES];
+} ngram_filter;
+
+static void ngram_filter_release(const struct tagcache_search *tcs)
+{
+    if (ngram_filter.owner == tcs)
+        ngram_filter.owner = NULL;
+}
+
+/* Open the trigram index of a tag and make sure it belongs to the
+ * current revision of the tag file. */
+static int open_ngram_fd(int tag)
+{
+    struct tagcache_header tch;
+    struct ngram_header nh;
+    char fname[MAX_PATH];
+    int fd;
+
+    fd = open_pathfmt(fname, sizeof(fname), O_RDONLY,
+                      "%s/" TAGCACHE_FILE_NGRAM, tc_stat.db_path, tag);
+    if (fd < 0)
+        return -1;
+
+    if (read(fd, &nh, sizeof(nh)) != sizeof(nh)
+        || nh.magic != TAGCACHE_NGRAM_MAGIC)
+    {
+        close(fd);
+        return -1;
+    }
+
+    int tagfd = open_tag_fd(&tch, tag, false);
+    if (tagfd < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    close(tagfd);
+
+    if (nh.tag_entry_count != tch.entry_count
+        || nh.tag_datasize != tch.datasize)
+    {
+        logf("stale ngram index: %d", tag);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Read the start and end of a bucket's posting list. */
+static bool ngram_bucket_range(int fd, unsigned int bucket, int32_t range[2])
+{
+    lseek(fd, sizeof(struct ngram_header) + bucket * sizeof(int32_t),
+          SEEK_SET);
+
+    return read(fd, range, 2 * sizeof(int32_t)) == 2 * sizeof(int32_t)
+           && range[0] <= range[1];
+}
+
+/* Look for a text clause that the trigram index can answer and load the
+ * shortest posting list of its trigrams. Entries not on that list can't
+ * match the clause, so build_lookup_list() skips them without reading
+ * their strings. Only used for disk searches with AND-ed clauses. */
+static void ngram_filter_setup(struct tagcache_search *tcs)
+{
+    int32_t best_range[2] = { 0, 0 };
+    int best_tag = -1;
+    int best_count = NGRAM_MAX_CANDIDATES + 1;
+    int i;
+
+    ngram_filter_release(tcs);
+
+    for (i = 0; i < tcs->clause_count; i++)
+    {
+        if (tcs->clause[i]->type == clause_logical_or)
+            return;
+    }
+
+    for (i = 0; i < tcs->clause_count; i++)
+    {
+        const struct tagcache_search_clause *clause = tcs->clause[i];
+        const char *p;
+        int fd;
+
+        if (clause->numeric || clause->str == NULL
+            || !TAGCACHE_HAS_NGRAM(clause->tag))
+            continue;
+
+        switch (clause->type)
+        {
+            case clause_is:
+            case clause_contains:
+            case clause_begins_with:
+            case clause_ends_with:
+                break;
+            default:
+                continue;
+        }
+
+        if (strlen(clause->str) < 3 || (fd = open_ngram_fd(clause->tag)) < 0)
+            continue;
+
+        for (p = clause->str; p[1] != '\0' && p[2] != '\0'; p++)
+        {
+            int32_t range[2];
+
+            if (!ngram_bucket_range(fd, ngram_bucket(p), range))
+                break;
+
+            if (range[1] - range[0] < best_count)
+            {
+                best_count = range[1] - range[0];
+                best_range[0] = range[0];
+                best_range[1] = range[1];
+                best_tag = clause->tag;
+            }
+        }
+
+        close(fd);
+    }
+
+    if (best_tag < 0)
+        return;
+
+    int fd = open_ngram_fd(best_tag);
+    if (fd < 0)
+        return;
+
+    ssize_t size = best_count * sizeof(int32_t);
+    lseek(fd, sizeof(struct ngram_header)
+              + (NGRAM_BUCKETS + 1) * sizeof(int32_t)
+              + best_range[0] * sizeof(int32_t), SEEK_SET);
+    if (read(fd, ngram_filter.seeks, size) == size)
+    {
+        logf("ngram filter: tag=%d candidates=%d", best_tag, best_count);
+        ngram_filter.owner = tcs;
+        ngram_filter.tag = best_tag;
+        ngram_filter.count = best_count;
+    }
+
+    close(fd);
+}
+
+/* Binary search the candidate list for a tag file seek. */
+static bool ngram_filter_match(int32_t seek)
+{
+    int lo = 0, hi = ngram_filter.count;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (ngram_filter.seeks[mid] < seek)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < ngram_filter.count && ngram_filter.seeks[lo] == seek;
+}
+
 static bool build_lookup_list(struct tagcache_search *tcs)
 {
     struct index_entry entry;
@@ -1670,10 +2103,13 @@ static bool build_lookup_list(struct tagcache_search *tcs)
         tcs->masterfd = open_master_fd(&tcmh, false);
     }
 
+    if (tcs->seek_pos == 0 && tcs->clause_count > 0)
+        ngram_filter_setup(tcs);
+
     lseek(tcs->masterfd, tcs->seek_pos * sizeof(struct index_entry) +
             sizeof(struct master_header), SEEK_SET);
 
-    while (read_index_entries(tcs->masterfd, &entry, 1) == sizeof(struct index_entry))
+    while (read_master_entry(tcs, &entry))
     {
         struct tagcache_seeklist_entry *seeklist;
 
@@ -1697,6 +2133,11 @@ static bool build_lookup_list(struct tagcache_search *tcs)
         if (j < tcs->filter_count)
             continue ;
 
+        /* Skip entries the trigram index rules out. */
+        if (ngram_filter.owner == tcs
+            && !ngram_filter_match(entry.tag_seek[ngram_filter.tag]))
+            continue;
+
         /* Check for conditions. */
         if (!check_clauses(tcs, &entry, tcs->clause, tcs->clause_count))
             continue;
@@ -1728,6 +2169,7 @@ bool tagcache_search(struct tagcache_search *tcs, int tag)
     while (read_lock)
         sleep(1);
 
+    ngram_filter_release(tcs);
     memset(tcs, 0, sizeof(struct tagcache_search));
     if (tc_stat.commit_step > 0 || !tc_stat.ready)
         return false;
@@ -1961,13 +2403,14 @@ static bool get_next(struct tagcache_search *tcs, bool is_numeric, char *buf, lo
         return false;
     }
 
-    /* Seek stream to the correct position and continue to direct fetch. */
-    lseek(tcs->idxfd[tcs->type], tcs->position, SEEK_SET);
-
-    switch (read_tagfile_entry_and_tag(tcs->idxfd[tcs->type], &entry, buf, bufsz))
+    /* Continue to direct fetch from the correct position. */
+    char *str = buf;
+    switch (read_tag_at(tcs, tcs->type, tcs->position, &entry, &str, bufsz))
     {
         case e_SUCCESS_LEN_ZERO:
         case e_SUCCESS:
+             if (str != buf)
+                 memcpy(buf, str, entry.tag_length);
              break;
         case e_ENTRY_SIZEMISMATCH:
             logf("read error #5");
@@ -2018,6 +2461,52 @@ bool tagcache_get_next(struct tagcache_search *tcs, char *buf, long size)
     return false;
 }
 
+/* Direct searches walk the tag file in order; all others go through the
+ * seek list built from the master index. */
+static inline bool is_direct_search(const struct tagcache_search *tcs)
+{
+    if (tcs->filter_count > 0 || tcs->clause_count > 0
+        || TAGCACHE_IS_NUMERIC(tcs->type))
+        return false;
+#if defined(HAVE_TC_RAMCACHE) && defined(HAVE_DIRCACHE)
+    if (tcs->ramsearch && tcs->type == tag_filename)
+        return false;
+#endif
+    return true;
+}
+
+bool tagcache_search_get_mark(const struct tagcache_search *tcs,
+                              struct tagcache_search_mark *mark)
+{
+    if (!tcs->initialized || !is_direct_search(tcs))
+        return false;
+
+    mark->position = tcs->position;
+    mark->entry_count = tcs->entry_count;
+    mark->commitid = current_tcmh.commitid;
+
+    return true;
+}
+
+bool tagcache_search_set_mark(struct tagcache_search *tcs,
+                              const struct tagcache_search_mark *mark)
+{
+    if (!tcs->valid || !is_direct_search(tcs))
+        return false;
+
+    /* The tag files have been rewritten since the mark was taken */
+    if (mark->commitid != current_tcmh.commitid)
+        return false;
+
+    if (mark->entry_count > tcs->entry_count)
+        return false;
+
+    tcs->position = mark->position;
+    tcs->entry_count = mark->entry_count;
+
+    return true;
+}
+
 bool tagcache_retrieve(struct tagcache_search *tcs, int idxid,
                        int tag, char *buf, long size)
 {
@@ -2052,6 +2541,7 @@ void tagcache_search_finish(struct tagcache_search *tcs)
         }
     }
 
+    ngram_filter_release(tcs);
     tcs->ramsearch = false;
     tcs->valid = false;
     tcs->initialized = 0;
@@ -3297,6 +3787,183 @@ static int build_index(int index_type, struct tagcache_header *h, int tmpfd)
     return 1;
 }
 
+/* One sequential pass over a tag file for build_ngram_index(). Without a
+ * posting buffer, counts the postings of every bucket into count[] using
+ * next[] to drop repeated trigrams of a string. Otherwise fills in the
+ * postings of buckets [first, last) using the start positions in start[]
+ * and next[] as the write cursors. */
+static bool ngram_scan(int fd, const struct tagcache_header *tch,
+                       int32_t *start, int32_t *next, int32_t *postings,
+                       unsigned int first, unsigned int last)
+{
+    struct tagfile_entry entry;
+    int32_t loc = sizeof(struct tagcache_header);
+    int i;
+
+    lseek(fd, loc, SEEK_SET);
+
+    for (i = 0; i < tch->entry_count; i++)
+    {
+        int32_t seek = loc;
+        const char *p;
+
+        switch (read_tagfile_entry_and_tag(fd, &entry, build_idx_buf,
+                                           build_idx_bufsz))
+        {
+            case e_SUCCESS:
+                break;
+            case e_SUCCESS_LEN_ZERO: /* Skip deleted entries. */
+                loc += sizeof(struct tagfile_entry);
+                continue;
+            default:
+                logf("ngram: read error");
+                return false;
+        }
+
+        loc += sizeof(struct tagfile_entry) + entry.tag_length;
+
+        for (p = build_idx_buf; p[0] && p[1] && p[2]; p++)
+        {
+            unsigned int b = ngram_bucket(p);
+
+            if (postings == NULL)
+            {
+                if (next[b] != seek)
+                {
+                    next[b] = seek;
+                    start[b]++;
+                }
+            }
+            else if (b >= first && b < last)
+            {
+                int32_t pos = next[b] - start[first];
+                if (next[b] == start[b] || postings[pos - 1] != seek)
+                {
+                    postings[pos] = seek;
+                    next[b]++;
+                }
+            }
+        }
+
+        do_timed_yield();
+    }
+
+    return !USR_CANCEL;
+}
+
+/* Build the trigram index of a freshly committed tag file in tempbuf.
+ * Buckets whose postings don't fit in the buffer at once are written
+ * out in several passes over the tag file. */
+static bool build_ngram_index(int tag)
+{
+    struct tagcache_header tch;
+    struct ngram_header nh;
+    char fname[MAX_PATH];
+    int32_t *start = (int32_t *)tempbuf;
+    int32_t *next = start + NGRAM_BUCKETS + 1;
+    int32_t *postings = next + NGRAM_BUCKETS;
+    long capacity;
+    unsigned int first, last;
+    int fd, ngfd;
+    int32_t total;
+    bool ok = false;
+    int i;
+
+    capacity = ((long)tempbuf_size - (long)((char *)postings - tempbuf))
+               / (long)sizeof(int32_t);
+    if (capacity < NGRAM_MAX_CANDIDATES)
+    {
+        logf("ngram: tempbuf too small");
+        return false;
+    }
+
+    fd = open_tag_fd(&tch, tag, false);
+    if (fd < 0)
+        return false;
+
+    ngfd = open_pathfmt(fname, sizeof(fname), O_WRONLY | O_CREAT | O_TRUNC,
+                        "%s/" TAGCACHE_FILE_NGRAM, tc_stat.db_path, tag);
+    if (ngfd < 0)
+    {
+        logf("ngram: can't create %s", fname);
+        close(fd);
+        return false;
+    }
+
+    memset(start, 0, (NGRAM_BUCKETS + 1) * sizeof(int32_t));
+    memset(next, 0, NGRAM_BUCKETS * sizeof(int32_t));
+    if (!ngram_scan(fd, &tch, start, next, NULL, 0, 0))
+        goto error;
+
+    /* Turn the counts into posting list start positions. */
+    for (total = 0, i = 0; i <= NGRAM_BUCKETS; i++)
+    {
+        int32_t count = start[i];
+        start[i] = total;
+        total += count;
+    }
+
+    /* The magic is written last so that an interrupted build is ignored. */
+    nh.magic = 0;
+    nh.tag_datasize = tch.datasize;
+    nh.tag_entry_count = tch.entry_count;
+    nh.posting_count = total;
+    if (write(ngfd, &nh, sizeof(nh)) != sizeof(nh)
+        || write(ngfd, start, (NGRAM_BUCKETS + 1) * sizeof(int32_t))
+            != (NGRAM_BUCKETS + 1) * sizeof(int32_t))
+        goto error;
+
+    for (first = 0; first < NGRAM_BUCKETS; first = last)
+    {
+        ssize_t size;
+
+        for (last = first + 1; last < NGRAM_BUCKETS
+             && start[last + 1] - start[first] <= capacity; last++)
+            ;
+
+        if (start[last] - start[first] > capacity)
+        {
+            logf("ngram: bucket %u too large", first);
+            goto error;
+        }
+
+        memcpy(&next[first], &start[first],
+               (last - first) * sizeof(int32_t));
+        if (!ngram_scan(fd, &tch, start, next, postings, first, last))
+            goto error;
+
+        size = (start[last] - start[first]) * sizeof(int32_t);
+        if (write(ngfd, postings, size) != size)
+            goto error;
+    }
+
+    nh.magic = TAGCACHE_NGRAM_MAGIC;
+    lseek(ngfd, 0, SEEK_SET);
+    ok = write(ngfd, &nh, sizeof(nh)) == sizeof(nh);
+    logf("ngram: tag=%d postings=%ld", tag, (long)total);
+
+error:
+    close(ngfd);
+    close(fd);
+    if (!ok)
+        remove(fname);
+
+    return ok;
+}
+
+/* (Re)build the trigram indices after a commit. They are optional, so
+ * failing here only makes text clauses fall back to a full scan. */
+static void build_ngram_indices(void)
+{
+    int i;
+
+    for (i = 0; i < TAG_COUNT && !USR_CANCEL; i++)
+    {
+        if (TAGCACHE_HAS_NGRAM(i) && !TAGCACHE_IS_NUMERIC(i))
+            build_ngram_index(i);
+    }
+}
+
 static bool commit(void)
 {
     struct tagcache_header tch;
@@ -3315,6 +3982,11 @@ static bool commit(void)
     while (write_lock)
         sleep(1);
 
+#ifdef TAGCACHE_MMAP
+    /* The tag files get rewritten and may shrink under the mappings. */
+    tc_mmap_drop_all();
+#endif
+
 #if !defined(PLUGIN)
     int fd = open_db_fd(TAGCACHE_FILE_NOCOMMIT, O_RDONLY);
     if (fd >= 0)
@@ -3417,6 +4089,7 @@ static bool commit(void)
     tc_stat.commit_step = 0;
     tch.datasize = 0;
     tc_stat.commit_delayed = false;
+    remove_ngram_files();
 
     for (i = 0; i < TAG_COUNT && !USR_CANCEL; i++)
     {
@@ -3450,6 +4123,8 @@ static bool commit(void)
 
     close(tmpfd);
 
+    build_ngram_indices();
+
     tc_stat.commit_step = 0;
 
     if (!USR_CANCEL)
@@ -3519,6 +4194,18 @@ void tagcache_commit_finalize(void)
 {
     tc_stat.ready = check_all_headers();
     tc_stat.readyvalid = true;
+    change_serial++;
+#ifdef TAGCACHE_MMAP
+    tc_mmap_drop_all();
+#endif
+}
+
+/* Returns a number that changes whenever the database contents may have
+ * changed: on commit, statistics updates and deleted entries. Callers that
+ * keep search results around compare it to find out if they are stale. */
+unsigned long tagcache_get_change_serial(void)
+{
+    return change_serial;
 }
 
 #if !defined(PLUGIN)
@@ -3559,6 +4246,233 @@ bool tagcache_modify_numeric_entry(struct tagcache_search *tcs,
 }
 #endif
 
+static int stats_journal_compare(const void *p1, const void *p2)
+{
+    const struct stats_journal_entry *e1 = p1, *e2 = p2;
+
+    if (e1->idx_id != e2->idx_id)
+        return e1->idx_id < e2->idx_id ? -1 : 1;
+
+    /* check holds the journal order while compacting */
+    return e1->check - e2->check;
+}
+
+static bool stats_journal_commit(int keep);
+
+/* Append the updates added since the last call to the journal with one
+ * sequential write. If that fails the journal is committed to the master
+ * index, followed by these updates. */
+static void stats_journal_sync(void)
+{
+    int n = stats_journal_count - stats_journal_written;
+    int fd;
+
+    if (n <= 0)
+        return;
+
+    fd = open_db_fd(TAGCACHE_FILE_JOURNAL, O_WRONLY | O_APPEND);
+    if (fd < 0)
+    {
+        int32_t magic = TAGCACHE_JOURNAL_MAGIC;
+
+        fd = open_db_fd(TAGCACHE_FILE_JOURNAL, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd >= 0 && write(fd, &magic, sizeof(magic)) != sizeof(magic))
+        {
+            close(fd);
+            remove_db_file(TAGCACHE_FILE_JOURNAL);
+            fd = -1;
+        }
+    }
+
+    ssize_t size = n * sizeof(struct stats_journal_entry);
+    if (fd >= 0)
+    {
+        off_t end = lseek(fd, 0, SEEK_END);
+        ssize_t rc = write(fd, &stats_journal[stats_journal_written], size);
+
+        if (rc == size)
+        {
+            stats_journal_written = stats_journal_count;
+            close(fd);
+            return;
+        }
+
+        /* drop a partial record, so that later appends stay aligned */
+        if (rc != 0 && end >= 0)
+            ftruncate(fd, end);
+        close(fd);
+    }
+
+    logf("journal: write failed");
+
+    /* The journal may hold older values of these updates, so it goes
+     * first. They are moved to the end of the array, which reading the
+     * journal back leaves alone. */
+    memmove(&stats_journal[TAGCACHE_JOURNAL_LENGTH - n],
+            &stats_journal[stats_journal_written], size);
+    stats_journal_commit(n);
+}
+
+/* Apply the journal on disk to the master index and remove it, then the
+ * last keep records of stats_journal. The journal is read in chunks that
+ * are sorted by entry, so that every touched entry is read and written
+ * once per chunk, in file order. The journal is only removed afterwards;
+ * since updates carry absolute values, replaying it again after a crash
+ * is harmless. */
+static bool stats_journal_commit(int keep)
+{
+    struct master_header myhdr;
+    int room = TAGCACHE_JOURNAL_LENGTH - keep;
+    int32_t magic;
+    int fd, masterfd;
+    int count, i;
+
+    fd = open_db_fd(TAGCACHE_FILE_JOURNAL, O_RDONLY);
+    if (fd >= 0 && (read(fd, &magic, sizeof(magic)) != sizeof(magic)
+                    || magic != TAGCACHE_JOURNAL_MAGIC))
+    {
+        logf("journal: bad header");
+        close(fd);
+        remove_db_file(TAGCACHE_FILE_JOURNAL);
+        fd = -1;
+    }
+
+    if (fd < 0 && keep == 0)
+    {
+        stats_journal_count = stats_journal_written = 0;
+        return true;
+    }
+
+    masterfd = open_master_fd(&myhdr, true);
+    if (masterfd < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        stats_journal_count = stats_journal_written;
+        return false;
+    }
+
+    /* Reload from disk, after a crash the in-memory copy is empty */
+    while (fd >= 0)
+    {
+        ssize_t rc = read(fd, stats_journal,
+                          room * sizeof(struct stats_journal_entry));
+        count = rc > 0 ? rc / (ssize_t)sizeof(struct stats_journal_entry) : 0;
+
+        for (i = 0; i < count; i++)
+        {
+            struct stats_journal_entry *e = &stats_journal[i];
+
+            if (e->check != ~(e->idx_id ^ e->tag ^ e->data)
+                || e->idx_id < 0 || e->idx_id >= myhdr.tch.entry_count
+                || !TAGCACHE_IS_NUMERIC(e->tag))
+            {
+                logf("journal: torn at %d", i);
+                break;
+            }
+
+            e->check = i;
+        }
+
+        bool torn = i < count;
+        count = i;
+        logf("journal: compacting %d updates", count);
+        qsort(stats_journal, count, sizeof(struct stats_journal_entry),
+              stats_journal_compare);
+
+        for (i = 0; i < count; )
+        {
+            struct index_entry idx;
+            int idx_id = stats_journal[i].idx_id;
+            bool found = get_index(masterfd, idx_id, &idx, false);
+
+            for (; i < count && stats_journal[i].idx_id == idx_id; i++)
+                idx.tag_seek[stats_journal[i].tag] = stats_journal[i].data;
+
+            if (found)
+            {
+                idx.flag |= FLAG_DIRTYNUM;
+                write_index(masterfd, idx_id, &idx);
+            }
+        }
+
+        if (torn || count < room)
+        {
+            close(fd);
+            remove_db_file(TAGCACHE_FILE_JOURNAL);
+            fd = -1;
+        }
+    }
+
+    for (i = room; i < TAGCACHE_JOURNAL_LENGTH; i++)
+    {
+        modify_numeric_entry(masterfd, stats_journal[i].idx_id,
+                             stats_journal[i].tag, stats_journal[i].data);
+    }
+
+    close(masterfd);
+    stats_journal_count = stats_journal_written = 0;
+
+    return true;
+}
+
+static bool stats_journal_compact(void)
+{
+    bool ret;
+
+    mutex_lock(&command_queue_mutex);
+    stats_journal_sync();
+    ret = stats_journal_commit(0);
+    mutex_unlock(&command_queue_mutex);
+
+    return ret;
+}
+
+/* Move a numeric update from the command queue to the journal. The RAM
+ * cache sees it right away. */
+static void stats_journal_add(int idx_id, int tag, long data)
+{
+    struct stats_journal_entry *e;
+
+    if (stats_journal_count == TAGCACHE_JOURNAL_LENGTH)
+    {
+        stats_journal_sync();
+        stats_journal_compact();
+    }
+
+#ifdef HAVE_TC_RAMCACHE
+    if (tc_stat.ramcache && idx_id >= 0
+        && idx_id < current_tcmh.tch.entry_count)
+    {
+        struct index_entry *idx_ram = &tcramcache.hdr->indices[idx_id];
+        idx_ram->tag_seek[tag] = data;
+        idx_ram->flag |= FLAG_DIRTYNUM;
+    }
+#endif /* HAVE_TC_RAMCACHE */
+
+    /* Compacting fails while the master index can't be opened; write this
+     * update to it directly rather than past the end of the journal. */
+    if (stats_journal_count >= TAGCACHE_JOURNAL_LENGTH)
+    {
+        struct master_header myhdr;
+        int masterfd = open_master_fd(&myhdr, true);
+
+        logf("journal: full");
+        if (masterfd >= 0)
+        {
+            modify_numeric_entry(masterfd, idx_id, tag, data);
+            close(masterfd);
+        }
+        return;
+    }
+
+    e = &stats_journal[stats_journal_count++];
+    e->idx_id = idx_id;
+    e->tag = tag;
+    e->data = data;
+    e->check = ~(e->idx_id ^ e->tag ^ e->data);
+}
+
 static bool command_queue_is_full(void)
 {
     int next;
@@ -3572,14 +4486,8 @@ static bool command_queue_is_full(void)
 
 static void command_queue_sync_callback(void)
 {
-    struct master_header myhdr;
-    int masterfd;
-
     mutex_lock(&command_queue_mutex);
 
-    if ( (masterfd = open_master_fd(&myhdr, true)) < 0)
-        return;
-
     while (command_queue_ridx != command_queue_widx)
     {
         struct tagcache_command_entry *ce = &command_queue[command_queue_ridx];
@@ -3588,18 +4496,12 @@ static void command_queue_sync_callback(void)
         {
             case CMD_UPDATE_MASTER_HEADER:
             {
-                close(masterfd);
                 update_master_header();
-
-                /* Re-open the masterfd. */
-                if ( (masterfd = open_master_fd(&myhdr, true)) < 0)
-                    return;
-
                 break;
             }
             case CMD_UPDATE_NUMERIC:
             {
-                modify_numeric_entry(masterfd, ce->idx_id, ce->tag, ce->data);
+                stats_journal_add(ce->idx_id, ce->tag, ce->data);
                 break;
             }
         }
@@ -3608,7 +4510,11 @@ static void command_queue_sync_callback(void)
             command_queue_ridx = 0;
     }
 
-    close(masterfd);
+    stats_journal_sync();
+
+    /* The disk is busy anyway, fold the journal in before it gets long */
+    if (stats_journal_count >= TAGCACHE_JOURNAL_LENGTH / 2)
+        stats_journal_compact();
 
     tc_stat.queue_length = 0;
     mutex_unlock(&command_queue_mutex);
@@ -3649,6 +4555,7 @@ static void queue_command(int cmd, long idx_id, int tag, long data)
             command_queue_widx = next;
 
             tc_stat.queue_length++;
+            change_serial++;
 
             mutex_unlock(&command_queue_mutex);
             break;
@@ -4011,6 +4918,8 @@ static bool delete_entry(long idx_id)
 
     logf("delete_entry(): %ld", idx_id);
 
+    change_serial++;
+
 #ifdef HAVE_TC_RAMCACHE
     /* At first mark the entry removed from ram cache. */
     if (tc_stat.ramcache)
@@ -5185,6 +6094,10 @@ static void tagcache_thread(void)
         }
     }
 
+    /* Replay statistics updates left over from a crash before the RAM
+     * cache gets loaded. */
+    stats_journal_compact();
+
 #ifdef HAVE_TC_RAMCACHE
 #ifdef HAVE_EEPROM_SETTINGS
     if (firmware_settings.initialized && firmware_settings.disk_clean
@@ -5300,8 +6213,9 @@ bool tagcache_prepare_shutdown(void)
 
 void tagcache_shutdown(void)
 {
-    /* Flush the command queue. */
+    /* Flush the command queue and the statistics journal. */
     run_command_queue(true);
+    stats_journal_compact();
 
 #if defined(HAVE_EEPROM_SETTINGS) && defined(HAVE_TC_RAMCACHE)
     if (tc_stat.ramcache)
@@ -157,6 +157,14 @@ struct tagcache_search {
     int32_t idx_id;      /* Entry number in the master index. */
 };
 
+/* Saved position of a direct (unfiltered) search, used to resume it later
+ * without reading the entries before it again. */
+struct tagcache_search_mark {
+    long position;
+    int entry_count;
+    int32_t commitid;
+};
+
 #ifdef __PCTOOL__
 void tagcache_reverse_scan(void);
 /* call this directly instead of tagcache_build in order to not pull
@@ -177,11 +185,16 @@ bool tagcache_search_add_filter(struct tagcache_search *tcs,
 bool tagcache_search_add_clause(struct tagcache_search *tcs,
                                 struct tagcache_search_clause *clause);
 bool tagcache_get_next(struct tagcache_search *tcs, char *buf, long size);
+bool tagcache_search_get_mark(const struct tagcache_search *tcs,
+                              struct tagcache_search_mark *mark);
+bool tagcache_search_set_mark(struct tagcache_search *tcs,
+                              const struct tagcache_search_mark *mark);
 bool tagcache_retrieve(struct tagcache_search *tcs, int idxid, 
                        int tag, char *buf, long size);
 void tagcache_search_finish(struct tagcache_search *tcs);
 long tagcache_get_numeric(const struct tagcache_search *tcs, int tag);
 long tagcache_increase_serial(void);
+unsigned long tagcache_get_change_serial(void);
 bool tagcache_import_changelog(void);
 bool tagcache_create_changelog(struct tagcache_search *tcs);
 void tagcache_update_numeric(int idx_id, int tag, long data);
@@ -56,6 +56,7 @@
 #include "playback.h"
 #include "strnatcmp.h"
 #include "panic.h"
+#include "crc32.h"
 
 #define str_or_empty(x) (x ? x : "(NULL)")
 
@@ -119,6 +120,103 @@ static uint32_t uniqbuf[UNIQBUF_SIZE / sizeof(uint32_t)];
 
 #define RELOAD_TAGTREE (-1024)
 
+/* Views that are already in index order are streamed in windows instead of
+ * being read in full: the first window covers a screenful of entries plus a
+ * prefetch margin, further windows are read as the list is scrolled or while
+ * the browser is idle, until the end of the search gives the final count. */
+#define WINDOW_ENTRIES  64
+#define WINDOW_PREFETCH 32
+
+enum retrieve_mode {
+    RETRIEVE_CHUNK,   /* (re)load the chunk of entries starting at offset */
+    RETRIEVE_INIT,    /* first load of a view, count all entries */
+    RETRIEVE_STREAM,  /* read the next window of a streamed view */
+};
+
+static struct tagtree_window {
+    bool active;       /* more entries remain to be read */
+    bool cached;       /* entry cache holds all the entries seen so far */
+    int seen;          /* entries read so far, including special entries */
+    int namebufused;   /* name buffer used by the entries held in the cache */
+    struct tagcache_search_mark mark; /* where the search left off */
+} window;
+
+/* Fully loaded views are kept in a small LRU cache, so that going back and
+ * forth in the database browser doesn't repeat the search. Each list lives
+ * in its own buflib allocation, which is given up as soon as buflib runs
+ * short of memory. Lists are keyed by the search instruction, the path that
+ * led to them and the clause values, and dropped when the database changes. */
+#define RESULT_CACHE_SLOTS 4
+#if MEMORYSIZE >= 16
+#define RESULT_CACHE_MAXSIZE (256*1024)
+#else
+#define RESULT_CACHE_MAXSIZE (32*1024)
+#endif
+
+struct result_cache_entry {
+    int32_t newtable;
+    int32_t extraseek;
+    uint32_t name_offset;   /* from the start of the names */
+};
+
+struct result_cache_hdr {
+    int count;              /* entries in the list */
+    int total_count;        /* count returned for the view */
+    size_t names_size;
+    struct result_cache_entry entries[];
+    /* followed by the names */
+};
+
+static struct result_cache_slot {
+    int handle;             /* > 0 if in use */
+    struct search_instruction *csi;
+    int table;
+    int extra;
+    uint32_t crc;
+    unsigned long serial;   /* tagcache_get_change_serial() at insertion */
+    unsigned long last_used;
+} result_cache[RESULT_CACHE_SLOTS];
+static unsigned long result_cache_tick;
+
+static int result_cache_move_callback(int handle, void* current, void* new)
+{
+    (void)handle; (void)current; (void)new;
+    return BUFLIB_CB_OK; /* only offsets are stored in the lists */
+}
+
+static int result_cache_shrink_callback(int handle, unsigned hints,
+                                        void *start, size_t old_size)
+{
+    (void)hints; (void)start; (void)old_size;
+
+    for (int i = 0; i < RESULT_CACHE_SLOTS; i++)
+    {
+        if (result_cache[i].handle == handle)
+            result_cache[i].handle = 0;
+    }
+
+    core_free(handle);
+    return BUFLIB_CB_OK;
+}
+
+static struct buflib_callbacks result_cache_ops = {
+    .move_callback = result_cache_move_callback,
+    .shrink_callback = result_cache_shrink_callback,
+};
+
+static void result_cache_free(struct result_cache_slot *slot)
+{
+    if (slot->handle > 0)
+        core_free(slot->handle);
+    slot->handle = 0;
+}
+
+static void result_cache_flush(void)
+{
+    for (int i = 0; i < RESULT_CACHE_SLOTS; i++)
+        result_cache_free(&result_cache[i]);
+}
+
 static int(*qsort_fn)(const char*, const char*, size_t);
 /* dummmy functions to allow compatibility strncasecmp */
 static int strnatcasecmp_n(const char *a, const char *b, size_t n)
@@ -1249,6 +1347,9 @@ static void tagtree_unload(struct tree_context *c)
         }
     }
 
+    /* cached lists refer to the search instructions about to be freed */
+    result_cache_flush();
+
     for (int i = 0; i < menu_count; i++)
         menus[i] = NULL;
     menu_count = 0;
@@ -1423,7 +1524,173 @@ static void tcs_get_basename(struct tagcache_search *tcs, bool is_basename)
     }
 }
 
-static int retrieve_entries(struct tree_context *c, int offset, bool init)
+/* Everything besides the search instruction itself that a view depends on */
+static uint32_t result_cache_crc(int level)
+{
+    uint32_t crc = 0xffffffff;
+    const char *untagged = str(LANG_TAGNAVI_UNTAGGED);
+
+    crc = crc_32(&global_settings.interpret_numbers,
+                 sizeof(global_settings.interpret_numbers), crc);
+    crc = crc_32(untagged, strlen(untagged), crc);
+    crc = crc_32(csi->result_seek, level * sizeof(csi->result_seek[0]), crc);
+
+    for (int i = 0; i <= level && i < csi->tagorder_count; i++)
+    {
+        for (int j = 0; j < csi->clause_count[i]; j++)
+        {
+            struct tagcache_search_clause *clause = csi->clause[i][j];
+            crc = crc_32(&clause->numeric_data,
+                         sizeof(clause->numeric_data), crc);
+            if (clause->str)
+                crc = crc_32(clause->str, strlen(clause->str), crc);
+        }
+    }
+
+    return crc;
+}
+
+static struct result_cache_slot *result_cache_find(struct tree_context *c,
+                                                   uint32_t crc)
+{
+    unsigned long serial = tagcache_get_change_serial();
+
+    for (int i = 0; i < RESULT_CACHE_SLOTS; i++)
+    {
+        struct result_cache_slot *slot = &result_cache[i];
+
+        if (slot->handle <= 0)
+            continue;
+
+        if (slot->serial != serial)
+        {
+            /* database changed since the list was cached */
+            result_cache_free(slot);
+            continue;
+        }
+
+        if (slot->csi == csi && slot->table == c->currtable
+            && slot->extra == c->currextra && slot->crc == crc)
+        {
+            slot->last_used = ++result_cache_tick;
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/* Copy a cached list into the tree cache, returns the view's entry count
+ * or -1 if it doesn't fit */
+static int result_cache_restore(struct tree_context *c,
+                                struct result_cache_slot *slot)
+{
+    struct result_cache_hdr *hdr = core_get_data(slot->handle);
+
+    if (hdr->count > c->cache.max_entries
+        || hdr->names_size > (size_t)c->cache.name_buffer_size)
+        return -1;
+
+    tree_lock_cache(c);
+
+    const char *names = (const char *)&hdr->entries[hdr->count];
+    char *namebuf = core_get_data(c->cache.name_buffer_handle);
+    struct tagentry *dptr = get_entries(c);
+
+    memcpy(namebuf, names, hdr->names_size);
+    for (int i = 0; i < hdr->count; i++, dptr++)
+    {
+        dptr->newtable = hdr->entries[i].newtable;
+        dptr->extraseek = hdr->entries[i].extraseek;
+        dptr->name = namebuf + hdr->entries[i].name_offset;
+    }
+
+    current_offset = 0;
+    current_entry_count = hdr->count;
+    c->dirfull = false;
+
+    tree_unlock_cache(c);
+
+    return hdr->total_count;
+}
+
+static void result_cache_insert(struct tree_context *c, uint32_t crc,
+                                int total_count)
+{
+    struct result_cache_slot *slot = &result_cache[0];
+    struct tagentry *dptr = get_entries(c);
+    size_t names_size = 0;
+    size_t size;
+    int i;
+
+    for (i = 0; i < current_entry_count; i++)
+        names_size += strlen(dptr[i].name) + 1;
+
+    size = sizeof(struct result_cache_hdr)
+         + current_entry_count * sizeof(struct result_cache_entry)
+         + names_size;
+
+    /* never make buflib shrink other allocations (e.g. the audio buffer)
+     * to make room for the cache */
+    if (size > RESULT_CACHE_MAXSIZE || size > core_allocatable())
+        return;
+
+    /* the names are pointed to from the entries, keep them in place */
+    tree_lock_cache(c);
+
+    for (i = 0; i < RESULT_CACHE_SLOTS; i++)
+    {
+        if (result_cache[i].handle <= 0)
+        {
+            slot = &result_cache[i];
+            break;
+        }
+
+        if (result_cache[i].last_used < slot->last_used)
+            slot = &result_cache[i];
+    }
+
+    result_cache_free(slot);
+
+    int handle = core_alloc_ex(size, &result_cache_ops);
+    if (handle <= 0)
+    {
+        tree_unlock_cache(c);
+        return;
+    }
+
+    struct result_cache_hdr *hdr = core_get_data(handle);
+    char *names = (char *)&hdr->entries[current_entry_count];
+    size_t pos = 0;
+
+    dptr = get_entries(c);
+    hdr->count = current_entry_count;
+    hdr->total_count = total_count;
+    hdr->names_size = names_size;
+    for (i = 0; i < current_entry_count; i++, dptr++)
+    {
+        size_t len = strlen(dptr->name) + 1;
+
+        hdr->entries[i].newtable = dptr->newtable;
+        hdr->entries[i].extraseek = dptr->extraseek;
+        hdr->entries[i].name_offset = pos;
+        memcpy(&names[pos], dptr->name, len);
+        pos += len;
+    }
+
+    slot->handle = handle;
+    slot->csi = csi;
+    slot->table = c->currtable;
+    slot->extra = c->currextra;
+    slot->crc = crc;
+    slot->serial = tagcache_get_change_serial();
+    slot->last_used = ++result_cache_tick;
+
+    tree_unlock_cache(c);
+}
+
+static int retrieve_entries(struct tree_context *c, int offset,
+                            enum retrieve_mode mode)
 {
     char tcs_buf[TAGCACHE_BUFSZ];
     const long tcs_bufsz = sizeof(tcs_buf);
@@ -1440,19 +1707,26 @@ static int retrieve_entries(struct tree_context *c, int offset, bool init)
     bool is_basename = false;
     int sort_limit;
     int strip;
+    bool init = (mode == RETRIEVE_INIT);
+    bool stream = (mode == RETRIEVE_STREAM);
+    bool windowed = stream;
+    bool store = true;
+    bool window_full = false;
+    uint32_t crc = 0;
 
     /* Show search progress straight away if the disk needs to spin up,
        otherwise show it after the normal 1/2 second delay */
-    show_search_progress(
+    if (!stream)
+        show_search_progress(
 #ifdef HAVE_DISK_STORAGE
 #ifdef HAVE_TC_RAMCACHE
-        tagcache_is_in_ram() ? true :
+            tagcache_is_in_ram() ? true :
 #endif
-        storage_disk_is_active()
+            storage_disk_is_active()
 #else
-        true
+            true
 #endif
-        , 0);
+            , 0);
 
     if (c->currtable == ALLSUBENTRIES)
     {
@@ -1465,6 +1739,20 @@ static int retrieve_entries(struct tree_context *c, int offset, bool init)
     if (tag == menu_reload)
         return RELOAD_TAGTREE;
 
+    if (init)
+    {
+        struct result_cache_slot *slot;
+
+        crc = result_cache_crc(level);
+        slot = result_cache_find(c, crc);
+        if (slot)
+        {
+            int count = result_cache_restore(c, slot);
+            if (count >= 0)
+                return count;
+        }
+    }
+
     if (tag == tag_virt_basename) /* basename shortcut */
     {
         is_basename = true;
@@ -1511,9 +1799,30 @@ static int retrieve_entries(struct tree_context *c, int offset, bool init)
             tagcache_search_add_clause(&tcs, csi->clause[i][j]);
     }
 
-    current_offset = offset;
-    current_entry_count = 0;
-    c->dirfull = false;
+    if (stream)
+    {
+        if (!tagcache_search_set_mark(&tcs, &window.mark))
+        {
+            /* database changed underneath us, keep what we have */
+            logf("window mark lost");
+            window.active = false;
+            tagcache_search_finish(&tcs);
+            core_unpin(tagtree_handle);
+            return -1;
+        }
+
+        /* only append while the cache still holds the start of the view */
+        store = window.cached;
+        total_count = offset;
+        namebufused = window.namebufused;
+    }
+    else
+    {
+        current_offset = offset;
+        current_entry_count = 0;
+        c->dirfull = false;
+        window.cached = false;
+    }
 
     fmt = NULL;
     for (i = 0; i < format_count; i++)
@@ -1536,11 +1845,20 @@ static int retrieve_entries(struct tree_context *c, int offset, bool init)
         strip = 0;
     }
 
+    if (init)
+    {
+        window.active = false;
+        if (!sort && tagcache_search_get_mark(&tcs, &window.mark))
+            windowed = true;
+    }
+
     /* lock buflib out due to possible yields */
     tree_lock_cache(c);
-    struct tagentry *dptr = core_get_data(c->cache.entries_handle);
+    struct tagentry *dptr = get_entries(c);
 
-    if (tag != tag_title && tag != tag_filename)
+    if (stream)
+        dptr += current_entry_count;
+    else if (tag != tag_title && tag != tag_filename)
     {
         if (offset == 0)
         {
@@ -1568,6 +1886,16 @@ static int retrieve_entries(struct tree_context *c, int offset, bool init)
         if (total_count++ < offset)
             continue;
 
+        if (windowed && total_count - offset >= WINDOW_ENTRIES)
+            window_full = true;
+
+        if (!store)
+        {
+            if (window_full)
+                break;
+            continue;
+        }
+
         dptr->newtable = NAVIBROWSE;
         if (tag == tag_title || tag == tag_filename)
         {
@@ -1653,6 +1981,14 @@ static int retrieve_entries(struct tree_context *c, int offset, bool init)
                     logf("chunk mode #2a: %d", current_entry_count);
                     c->dirfull = true;
                     sort = false;
+                    if (windowed)
+                    {
+                        namebufused -= tcs.result_len;
+                        store = false;
+                        if (window_full)
+                            break;
+                        continue;
+                    }
                     break ;
                 }
             }
@@ -1671,9 +2007,14 @@ entry_skip_formatter:
             logf("chunk mode #3: %d", current_entry_count);
             c->dirfull = true;
             sort = false;
-            break ;
+            if (!windowed)
+                break ;
+            store = false;
         }
 
+        if (window_full)
+            break;
+
         if (init)
         {
             if (!show_search_progress(false, total_count))
@@ -1700,6 +2041,20 @@ entry_skip_formatter:
               compare);
     }
 
+    if (windowed)
+    {
+        /* the search is resumed from here by the next window */
+        window.active = window_full && tagcache_search_get_mark(&tcs, &window.mark);
+        window.cached = store;
+        window.seen = total_count;
+        window.namebufused = namebufused;
+
+        tagcache_search_finish(&tcs);
+        tree_unlock_cache(c);
+        core_unpin(tagtree_handle);
+        return total_count;
+    }
+
     if (!init)
     {
         tagcache_search_finish(&tcs);
@@ -1748,6 +2103,9 @@ entry_skip_formatter:
         }
     }
 
+    if (!c->dirfull)
+        result_cache_insert(c, crc, total_count);
+
     return total_count;
 
 }
@@ -1800,6 +2158,7 @@ int tagtree_load(struct tree_context* c)
     int table = c->currtable;
 
     c->dirsindir = 0;
+    window.active = false;
 
     if (!table)
     {
@@ -1819,7 +2178,7 @@ int tagtree_load(struct tree_context* c)
         case NAVIBROWSE:
             logf("navibrowse...");
             cpu_boost(true);
-            count = retrieve_entries(c, 0, true);
+            count = retrieve_entries(c, 0, RETRIEVE_INIT);
             cpu_boost(false);
             break;
 
@@ -1849,6 +2208,63 @@ int tagtree_load(struct tree_context* c)
     return count;
 }
 
+/* Read further windows of a streamed view, at least until the selection is
+ * no longer within the prefetch margin of the end. Returns true if the number
+ * of entries has changed. */
+bool tagtree_stream_entries(struct tree_context* c, int selected_item)
+{
+    int seen = window.seen;
+
+    if (!window.active)
+        return false;
+
+    cpu_boost(true);
+    do
+    {
+        if (retrieve_entries(c, window.seen, RETRIEVE_STREAM) < 0)
+            break;
+    } while (window.active && selected_item + WINDOW_PREFETCH >= window.seen);
+    cpu_boost(false);
+
+    c->dirlength = c->filesindir = window.seen;
+
+    return window.seen != seen;
+}
+
+bool tagtree_is_streaming(void)
+{
+    return window.active;
+}
+
+/* Read the remainder of a streamed view, for actions that need the
+ * final entry count */
+static void stream_all_entries(struct tree_context* c)
+{
+    if (!window.active)
+        return;
+
+    cpu_boost(true);
+    show_search_progress(
+#ifdef HAVE_DISK_STORAGE
+        storage_disk_is_active()
+#else
+        true
+#endif
+        , 0);
+
+    while (window.active)
+    {
+        if (retrieve_entries(c, window.seen, RETRIEVE_STREAM) < 0)
+            break;
+
+        if (!show_search_progress(false, window.seen))
+            break;
+    }
+    cpu_boost(false);
+
+    c->dirlength = c->filesindir = window.seen;
+}
+
 /* Enters menu or table for selected item in the database.
  *
  * Call this with the is_visible parameter set to false to
@@ -1876,6 +2292,7 @@ int tagtree_enter(struct tree_context* c, bool is_visible)
     if (seek == -1) /* <Random> menu item was selected */
     {
         is_random_item = true;
+        stream_all_entries(c);
         if(c->filesindir<=2) /* Menu contains only <All> and <Random> menu items */
             return 0;
         srand(current_tick);
@@ -2002,6 +2419,7 @@ int tagtree_enter(struct tree_context* c, bool is_visible)
                 }
             }
             c->currtable = newextra;
+            window.active = false;
 
             break;
 
@@ -2026,6 +2444,7 @@ int tagtree_enter(struct tree_context* c, bool is_visible)
             }
 
             c->currtable = newextra;
+            window.active = false;
             csi->result_seek[c->currextra] = seek;
             if (c->currextra < csi->tagorder_count-1)
                 c->currextra++;
@@ -2066,6 +2485,7 @@ void tagtree_exit(struct tree_context* c, bool is_visible)
         selected_item_history[c->dirlevel] = c->selected_item;
     }
     c->dirfull = false;
+    window.active = false;
     if (c->dirlevel > 0)
     {
         c->dirlevel--;
@@ -2113,6 +2533,8 @@ static bool insert_all_playlist(struct tree_context *c,
     unsigned long last_tick;
     char buf[MAX_PATH];
 
+    stream_all_entries(c);
+
     cpu_boost(true);
     if (!tagcache_search(&tcs, tag_filename))
     {
@@ -2203,6 +2625,7 @@ static bool goto_allsubentries(int newtable)
         newtable = tagtree_get_entry(tc, tc->selected_item)->newtable;
         i++;
     }
+    stream_all_entries(tc);
     return (newtable == PLAYTRACK);
 }
 
@@ -2374,7 +2797,7 @@ static struct tagentry* tagtree_get_entry(struct tree_context *c, int id)
     {
         cpu_boost(true);
         if (retrieve_entries(c, MAX(0, id - (current_entry_count / 2)),
-                             false) < 0)
+                             RETRIEVE_CHUNK) < 0)
         {
             logf("retrieve failed");
             cpu_boost(false);
@@ -37,6 +37,8 @@ void tagtree_init(void) INIT_ATTR;
 int tagtree_enter(struct tree_context* c, bool is_visible);
 void tagtree_exit(struct tree_context* c, bool is_visible);
 int tagtree_load(struct tree_context* c);
+bool tagtree_stream_entries(struct tree_context* c, int selected_item);
+bool tagtree_is_streaming(void);
 char* tagtree_get_entry_name(struct tree_context *c, int id,
                                     char* buf, size_t bufsize);
 bool tagtree_current_playlist_insert(int position, bool queue);
@@ -450,6 +450,8 @@ static int update_dir(void)
     }
 
     gui_synclist_init(list, &tree_get_filename, &tc, false, 1, NULL);
+    /* entries only change through update_dir() or a reload of tc */
+    gui_synclist_set_item_cache(list, true);
 
 #ifdef HAVE_TAGCACHE
     if (id3db)
@@ -506,6 +508,13 @@ static int update_dir(void)
      * with NULL and icon as NOICON as the list is reused */
     gui_synclist_set_title(list, title, icon);
 
+#ifdef HAVE_TAGCACHE
+    /* a streamed view only has its first window loaded, read on up to the
+       selection restored from the history before it gets clamped below */
+    if (id3db && tagtree_is_streaming())
+        tagtree_stream_entries(&tc, tc.selected_item);
+#endif
+
     gui_synclist_set_nb_items(list, tc.filesindir);
     gui_synclist_set_icon_callback(list,
                             global_settings.show_icons?tree_get_fileicon:NULL);
@@ -539,6 +548,7 @@ void resume_directory(const char *dir)
         *tc.dirfilter = global_settings.dirfilter;
     ret = ft_load(&tc, dir);
     *tc.dirfilter = dirfilter;
+    gui_synclist_items_changed(&tree_lists);
     if (ret < 0)
         return;
     lastdir[0] = 0;
@@ -665,6 +675,7 @@ static void set_current_file_ex(const char *path, const char *filename)
             }
         }
     }
+    gui_synclist_items_changed(&tree_lists);
     if (ft_load(&tc, NULL) >= 0)
     {
         tc.selected_item = tree_get_file_position(lastfile);
@@ -726,15 +737,29 @@ static int dirbrowse(void)
 
     while(tc.browse && tc.is_browsing) {
         bool restore = false;
+        int timeout = HZ/2;
         if (tc.dirlevel < 0)
             tc.dirlevel = 0; /* shouldnt be needed.. this code needs work! */
 
+#ifdef HAVE_TAGCACHE
+        /* keep reading a streamed database view while idle */
+        if (id3db && tagtree_is_streaming())
+            timeout = HZ/20;
+#endif
         keyclick_set_callback(gui_synclist_keyclick_callback, &tree_lists);
         button = get_action(CONTEXT_TREE|ALLOW_SOFTLOCK,
-                            list_do_action_timeout(&tree_lists, HZ/2));
+                            list_do_action_timeout(&tree_lists, timeout));
         oldbutton = button;
         gui_synclist_do_button(&tree_lists, &button);
         tc.selected_item = gui_synclist_get_sel_pos(&tree_lists);
+#ifdef HAVE_TAGCACHE
+        if (id3db && tagtree_stream_entries(&tc, tc.selected_item))
+        {
+            numentries = tc.filesindir;
+            gui_synclist_set_nb_items(&tree_lists, numentries);
+            gui_synclist_draw(&tree_lists);
+        }
+#endif
         switch ( button ) {
             case ACTION_STD_OK:
                 /* nothing to do if no files to display */
@@ -980,6 +1005,8 @@ static int dirbrowse(void)
 
             if (!reload_dir)
             {
+                /* tc moved on, what is cached is the old directory's */
+                gui_synclist_items_changed(&tree_lists);
                 gui_synclist_select_item(&tree_lists, 0);
                 gui_synclist_draw(&tree_lists);
                 tc.selected_item = 0;
@@ -1285,21 +1312,20 @@ void tree_flush(void)
 
 #ifdef HAVE_DIRCACHE
     int old_val = global_status.dircache_size;
-#ifdef HAVE_EEPROM_SETTINGS
-    bool savecache = false;
-#endif
 
     if (global_settings.dircache)
     {
+    #ifdef DIRCACHE_SNAPSHOT
+        /* save while the cache still holds everything */
+        dircache_save();
+    #endif
+
         dircache_suspend();
 
         struct dircache_info info;
         dircache_get_info(&info);
 
         global_status.dircache_size = info.last_size;
-    #ifdef HAVE_EEPROM_SETTINGS
-        savecache = firmware_settings.initialized;
-    #endif
     }
     else
     {
@@ -1308,11 +1334,6 @@ void tree_flush(void)
 
     if (old_val != global_status.dircache_size)
         status_save();
-
-    #ifdef HAVE_EEPROM_SETTINGS
-        if (savecache)
-            dircache_save();
-    #endif
 #endif /* HAVE_DIRCACHE */
 }
 
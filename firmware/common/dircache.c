@@ -25,6 +25,7 @@
 #include "string-extra.h"
 #include <stdbool.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include "debug.h"
 #include "system.h"
 #include "logf.h"
@@ -90,6 +91,14 @@
  *
  * r0->r1->r2->q0->q1->q2->NULL
  * ^resolved0  ^queued0
+ *
+ * Name index:
+ * An open-addressed hash table in a separate allocation maps (parent index,
+ * case-folded name) to entry indexes so that path lookups don't have to walk
+ * the sibling lists. It is created after a build and kept up to date as
+ * entries are linked and unlinked. Short names that aren't plain ASCII would
+ * need codepage decoding to be compared and are only counted; as long as any
+ * exist, failed lookups fall back to scanning the directory.
  */
 
 #ifdef DIRCACHE_NATIVE
@@ -103,6 +112,7 @@ struct sab
     struct filestr_base   stream;    /* scan directory stream */
     struct file_base_info info;      /* scanned entry info */
     bool volatile         quit;      /* halt all scanning */
+    struct fat_dirbulk    *bulkp;    /* multi-sector directory reads */
     struct sab_component  *stackend; /* end of stack pointer */
     struct sab_component  *top;      /* current top of stack */
     struct sab_component
@@ -113,6 +123,17 @@ struct sab
     } stack[];                       /* "recursion" stack */
 };
 
+/* directory sectors read per transfer by a full scan and build */
+#if MEMORYSIZE < 8
+#define DIRCACHE_BULK_SECTORS   4
+#else
+#define DIRCACHE_BULK_SECTORS   16
+#endif
+
+static uint8_t sab_bulk_buf[DIRCACHE_BULK_SECTORS*SECTOR_SIZE]
+    STORAGE_ALIGN_ATTR;
+static struct fat_dirbulk sab_bulk;
+
 #else /* !DIRCACHE_NATIVE */
 
 #error need locking scheme
@@ -212,7 +233,7 @@ static struct dircache
     size_t       sizeused;            /* bytes of .size bytes actually used */
     union {
     unsigned int numentries;          /* entry count (including holes) */
-#ifdef HAVE_EEPROM_SETTINGS
+#ifdef DIRCACHE_SNAPSHOT
     size_t       sizeentries;         /* used when persisting */
 #endif
     };
@@ -255,13 +276,36 @@ static struct dircache_runinfo
     unsigned char         *pname;  /* alias of .p to assist name resolution */
     };
     struct buflib_callbacks ops;   /* buflib ops callbacks */
+#ifdef DIRCACHE_NAME_INDEX
+    /* name index */
+    int          index_handle;     /* buflib handle of the index */
+    int          *index;           /* slots: entry index, 0 or INDEX_DELETED */
+    unsigned int index_slots;      /* number of slots (power of 2, 0 = none) */
+    unsigned int index_used;       /* slots holding an entry */
+    unsigned int index_deleted;    /* slots marked deleted */
+    unsigned int index_unindexed;  /* linked entries not in the index */
+    bool         index_valid;      /* index is in sync with the cache */
+    struct buflib_callbacks index_ops; /* buflib ops callbacks */
+#endif /* DIRCACHE_NAME_INDEX */
     /* per-volume data */
     struct dircache_runinfo_volume
     {
         struct file_base_binding *resolved0; /* first resolved binding in list */
         struct file_base_binding *queued0;   /* first queued binding in list */
         struct sab               *sabp;      /* if building, struct sab in use */
+    #ifdef DIRCACHE_SNAPSHOT
+        bool                     validate;   /* loaded; check before trusting */
+    #endif
     } dcrivol[NUM_VOLUMES];
+#ifdef DIRCACHE_SNAPSHOT
+    int          snap_handle;      /* directory checksums of loaded snapshot */
+    unsigned int snap_count;       /* number of checksums in snap_handle */
+    unsigned int snap_dirs;        /* directories revalidated */
+    unsigned int snap_stale;       /* directories found changed */
+    int          sums_handle;      /* checksums taken of cached directories */
+    unsigned int sums_count;       /* number of checksums in sums_handle */
+    unsigned int sums_slots;       /* room for checksums in sums_handle */
+#endif /* DIRCACHE_SNAPSHOT */
 } dircache_runinfo;
 
 #define BINDING_NEXT(bindp) \
@@ -294,7 +338,7 @@ static struct dircache_runinfo
 #define DIRCACHE_STUFFED(reserve_used) \
     ((reserve_used) > 3*DIRCACHE_RESERVE / 4)
 
-#ifdef HAVE_EEPROM_SETTINGS
+#ifdef DIRCACHE_SNAPSHOT
 /**
  * remove the snapshot file
  */
@@ -310,7 +354,29 @@ static int open_dircache_file(int oflag)
 {
     return open(DIRCACHE_FILE, oflag, 0666);
 }
-#endif /* HAVE_EEPROM_SETTINGS */
+
+/* per-directory record of the snapshot file; the checksum tells whether the
+   directory is still what the cache holds for it */
+struct dircache_dirsum
+{
+    int32_t  idx;           /* cache index of directory (< 0 = volume root) */
+    uint32_t firstcluster;  /* first cluster of the directory */
+    uint32_t crc;           /* CRC32 of its raw directory sectors */
+    int32_t  down;          /* (in RAM) its contents until it's checked */
+};
+
+/* checksum of a directory taken when it was scanned or checked, kept in
+   ascending index order so that saving needn't read it again */
+struct dircache_dirsum_ram
+{
+    int         idx;        /* cache index of directory (< 0 = volume root) */
+    dc_serial_t serialnum;  /* its serial number then (0 = since changed) */
+    uint32_t    crc;        /* CRC32 of its raw directory sectors */
+};
+
+/* first allocation for the checksums; grows by doubling */
+#define DIRCACHE_SUMS_SLOTS 256
+#endif /* DIRCACHE_SNAPSHOT */
 
 #ifdef DIRCACHE_DUMPSTER
 /**
@@ -938,6 +1004,292 @@ static int entry_reassign_name(struct dircache_entry *ce,
     return entry_assign_name(ce, newname, newlen);
 }
 
+#ifdef DIRCACHE_NAME_INDEX
+/** Name index **/
+
+#define INDEX_DELETED   (-1)
+
+/**
+ * relocate the index when its buffer has moved
+ */
+static int index_move_callback(int handle, void *current, void *new)
+{
+    (void)handle; (void)current;
+    dircache_runinfo.index = new;
+    return BUFLIB_CB_OK;
+}
+
+/**
+ * hash a name, case-insensitively, together with its parent index
+ */
+static uint32_t index_hash(int up, const unsigned char *name, size_t len)
+{
+    uint32_t h = 0x811c9dc5 ^ ((uint32_t)up * 0x9e3779b1);
+
+    while (len-- && *name)
+        h = (h ^ tolower(*name++)) * 0x01000193;
+
+    return h;
+}
+
+/**
+ * return the entry's name and its length without copying it
+ */
+static const unsigned char * index_entry_name(const struct dircache_entry *ce,
+                                              size_t *lenp)
+{
+    if (ce->tinyname)
+    {
+        size_t len = 0;
+        while (len < MAX_TINYNAME && ce->namebuf[len])
+            len++;
+
+        *lenp = len;
+        return ce->namebuf;
+    }
+
+    *lenp = CE_NAMESIZE(ce->namelen);
+    return get_name(ce->name);
+}
+
+/**
+ * can the entry be found by its name as stored? short names are returned
+ * codepage-decoded by directory reads, which only leaves ASCII as is
+ */
+static bool index_entry_indexable(const struct dircache_entry *ce,
+                                  const unsigned char *name, size_t len)
+{
+    if (ce->direntries != 1)
+        return true;
+
+    while (len--)
+    {
+        if (*name++ >= 0x80)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * find the slot that holds the entry or NULL if it isn't in the index
+ */
+static int * index_find_slot(int idx, const struct dircache_entry *ce,
+                             const unsigned char *name, size_t len)
+{
+    unsigned int mask = dircache_runinfo.index_slots - 1;
+
+    for (unsigned int i = index_hash(ce->up, name, len) & mask;;
+         i = (i + 1) & mask)
+    {
+        int *slotp = &dircache_runinfo.index[i];
+        if (*slotp == 0)
+            return NULL;
+        else if (*slotp == idx)
+            return slotp;
+    }
+}
+
+/**
+ * put the entry in the first free or deleted slot of its probe sequence
+ */
+static void index_add(int idx, const struct dircache_entry *ce,
+                      const unsigned char *name, size_t len)
+{
+    unsigned int mask = dircache_runinfo.index_slots - 1;
+
+    for (unsigned int i = index_hash(ce->up, name, len) & mask;;
+         i = (i + 1) & mask)
+    {
+        int *slotp = &dircache_runinfo.index[i];
+        if (*slotp > 0)
+            continue;
+
+        if (*slotp == INDEX_DELETED)
+            dircache_runinfo.index_deleted--;
+
+        *slotp = idx;
+        dircache_runinfo.index_used++;
+        return;
+    }
+}
+
+/**
+ * fill the index from scratch with all linked entries
+ */
+static void index_fill(void)
+{
+    memset(dircache_runinfo.index, 0,
+           dircache_runinfo.index_slots * sizeof (int));
+    dircache_runinfo.index_used      = 0;
+    dircache_runinfo.index_deleted   = 0;
+    dircache_runinfo.index_unindexed = 0;
+    dircache_runinfo.index_valid     = true;
+
+    FOR_EACH_CACHE_ENTRY(ce)
+    {
+        if (!ce->up)
+            continue; /* orphan */
+
+        size_t len;
+        const unsigned char *name = index_entry_name(ce, &len);
+
+        if (index_entry_indexable(ce, name, len))
+            index_add(get_index(ce), ce, name, len);
+        else
+            dircache_runinfo.index_unindexed++;
+    }
+}
+
+/**
+ * add a newly linked entry to the index
+ */
+static void index_insert(int idx, const struct dircache_entry *ce)
+{
+    if (!dircache_runinfo.index_valid)
+        return;
+
+    size_t len;
+    const unsigned char *name = index_entry_name(ce, &len);
+
+    if (!index_entry_indexable(ce, name, len))
+    {
+        dircache_runinfo.index_unindexed++;
+        return;
+    }
+
+    unsigned int slots = dircache_runinfo.index_slots;
+
+    if ((dircache_runinfo.index_used + 1) * 4 > slots * 3)
+    {
+        /* outgrown; it gets resized after the next build */
+        dircache_runinfo.index_valid = false;
+        return;
+    }
+
+    if ((dircache_runinfo.index_used + dircache_runinfo.index_deleted + 1) * 4
+            > slots * 3)
+    {
+        /* too many deleted slots; this picks up the new entry too */
+        index_fill();
+        return;
+    }
+
+    index_add(idx, ce, name, len);
+}
+
+/**
+ * remove an entry from the index before it is unlinked or renamed
+ */
+static void index_remove(int idx, const struct dircache_entry *ce)
+{
+    if (!dircache_runinfo.index_valid)
+        return;
+
+    size_t len;
+    const unsigned char *name = index_entry_name(ce, &len);
+
+    if (!index_entry_indexable(ce, name, len))
+    {
+        dircache_runinfo.index_unindexed--;
+        return;
+    }
+
+    int *slotp = index_find_slot(idx, ce, name, len);
+    if (slotp)
+    {
+        *slotp = INDEX_DELETED;
+        dircache_runinfo.index_used--;
+        dircache_runinfo.index_deleted++;
+    }
+}
+
+/**
+ * look up the entry with the given name in the directory 'up'
+ */
+static int index_lookup(int up, const char *name)
+{
+    size_t namelen = strlen(name);
+    unsigned int mask = dircache_runinfo.index_slots - 1;
+
+    for (unsigned int i = index_hash(up, (const unsigned char *)name,
+                                     namelen) & mask;;
+         i = (i + 1) & mask)
+    {
+        int idx = dircache_runinfo.index[i];
+        if (idx == 0)
+            return 0;
+        else if (idx == INDEX_DELETED)
+            continue;
+
+        struct dircache_entry *ce = get_entry(idx);
+        if (ce->up != up)
+            continue;
+
+        size_t len;
+        const unsigned char *cename = index_entry_name(ce, &len);
+        if (len == namelen && !strncasecmp(name, (const char *)cename, len))
+            return idx;
+    }
+}
+
+/**
+ * (re)create the index for the current cache contents; the lock is released
+ * while allocating
+ */
+static void index_build(void)
+{
+    /* called holding dircache lock */
+    unsigned int need = dircache.numentries + DIRCACHE_RESERVE / ENTRYSIZE;
+    unsigned int slots = 256;
+
+    while (slots * 3 < need * 4)
+        slots *= 2;
+
+    dircache_runinfo.index_valid = false;
+
+    if (slots * sizeof (int) > DIRCACHE_INDEX_LIMIT)
+    {
+        logf("dircache: too many entries for the name index");
+        slots = 0; /* lookups will scan */
+    }
+
+    if (slots != dircache_runinfo.index_slots)
+    {
+        int handle = dircache_runinfo.index_handle;
+        dircache_runinfo.index_handle = 0;
+        dircache_runinfo.index_slots  = 0;
+
+        dircache_unlock();
+        core_free(handle);
+        handle = slots ? core_alloc_ex(slots * sizeof (int),
+                                       &dircache_runinfo.index_ops) : 0;
+        dircache_lock();
+
+        if (handle <= 0)
+        {
+            logf("dircache: no name index");
+            return; /* lookups will scan */
+        }
+
+        if (dircache_runinfo.suspended || !dircache_runinfo.handle)
+        {
+            dircache_unlock();
+            core_free(handle);
+            dircache_lock();
+            return;
+        }
+
+        dircache_runinfo.index_handle = handle;
+        dircache_runinfo.index        = core_get_data(handle);
+        dircache_runinfo.index_slots  = slots;
+    }
+
+    if (slots)
+        index_fill();
+}
+#endif /* DIRCACHE_NAME_INDEX */
+
 /**
  * allocate a dircache_entry from memory using freed ones if available
  */
@@ -1048,6 +1400,10 @@ static int create_entry(const char *basename,
 static void remove_entry(struct dircache_runinfo_volume *dcrivolp,
                          struct dircache_entry *ce, int *prevp)
 {
+#ifdef DIRCACHE_NAME_INDEX
+    index_remove(*prevp, ce);
+#endif
+
     /* unlink it from its list */
     *prevp = ce->next;
 
@@ -1144,6 +1500,10 @@ static void insert_file_entry(struct file_base_info *dirinfop,
     ce->up   = diridx;
     ce->next = *nextp;
     *nextp   = get_index(ce);
+
+#ifdef DIRCACHE_NAME_INDEX
+    index_insert(*nextp, ce);
+#endif
 }
 
 /**
@@ -1180,6 +1540,183 @@ static void establish_frontier(int idx, uint32_t code)
     }
 }
 
+#ifdef DIRCACHE_SNAPSHOT
+/**
+ * find the slot of a directory's checksum, or where it would go
+ */
+static unsigned int dirsum_slot(int idx)
+{
+    struct dircache_dirsum_ram *sums =
+        core_get_data(dircache_runinfo.sums_handle);
+    unsigned int lo = 0, hi = dircache_runinfo.sums_count;
+
+    while (lo < hi)
+    {
+        unsigned int mid = (lo + hi) / 2;
+        if (sums[mid].idx < idx)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/**
+ * find the checksum of a directory if there is one that is still good
+ */
+static struct dircache_dirsum_ram * dirsum_find(int idx)
+{
+    if (!dircache_runinfo.sums_count)
+        return NULL;
+
+    struct dircache_dirsum_ram *sums =
+        core_get_data(dircache_runinfo.sums_handle);
+    unsigned int slot = dirsum_slot(idx);
+
+    if (slot >= dircache_runinfo.sums_count || sums[slot].idx != idx)
+        return NULL;
+
+    struct dircache_entry *ce = get_entry(idx);
+    dc_serial_t serialnum = idx < 0 ? get_idx_dcvolp(idx)->serialnum :
+                            ce ? ce->serialnum : 0;
+
+    if (!serialnum || sums[slot].serialnum != serialnum)
+        return NULL; /* changed or gone since */
+
+    return &sums[slot];
+}
+
+/**
+ * record the checksum of a directory as it is cached now; if there's no room
+ * it goes without and is simply scanned again after the next load
+ */
+static void dirsum_set(int idx, uint32_t crc)
+{
+    if (!dircache_runinfo.sums_handle)
+        return;
+
+    struct dircache_dirsum_ram *sums =
+        core_get_data(dircache_runinfo.sums_handle);
+    unsigned int slot = dirsum_slot(idx);
+
+    if (slot >= dircache_runinfo.sums_count || sums[slot].idx != idx)
+    {
+        if (dircache_runinfo.sums_count >= dircache_runinfo.sums_slots)
+            return;
+
+        memmove(&sums[slot + 1], &sums[slot],
+                (dircache_runinfo.sums_count - slot) * sizeof (*sums));
+        dircache_runinfo.sums_count++;
+    }
+
+    sums[slot].idx       = idx;
+    sums[slot].serialnum =
+        idx < 0 ? get_idx_dcvolp(idx)->serialnum : get_entry(idx)->serialnum;
+    sums[slot].crc       = crc;
+}
+
+/**
+ * forget the checksum of a directory whose contents were changed
+ */
+static void dirsum_invalidate(int idx)
+{
+    if (!dircache_runinfo.sums_count)
+        return;
+
+    struct dircache_dirsum_ram *sums =
+        core_get_data(dircache_runinfo.sums_handle);
+    unsigned int slot = dirsum_slot(idx);
+
+    if (slot < dircache_runinfo.sums_count && sums[slot].idx == idx)
+        sums[slot].serialnum = 0;
+}
+
+/**
+ * make room for at least one more checksum; call without holding the lock
+ */
+static void dirsum_reserve(void)
+{
+    if (dircache_runinfo.sums_count < dircache_runinfo.sums_slots)
+        return;
+
+    unsigned int slots = dircache_runinfo.sums_slots ?
+                            dircache_runinfo.sums_slots * 2 :
+                            DIRCACHE_SUMS_SLOTS;
+    int handle = core_alloc(slots * sizeof (struct dircache_dirsum_ram));
+    if (handle <= 0)
+        return;
+
+    dircache_lock();
+
+    int oldhandle = dircache_runinfo.sums_handle;
+
+    if (dircache_runinfo.suspended)
+    {
+        oldhandle = handle;
+    }
+    else
+    {
+        if (oldhandle)
+        {
+            memcpy(core_get_data(handle), core_get_data(oldhandle),
+                   dircache_runinfo.sums_count *
+                        sizeof (struct dircache_dirsum_ram));
+        }
+
+        dircache_runinfo.sums_handle = handle;
+        dircache_runinfo.sums_slots  = slots;
+    }
+
+    dircache_unlock();
+    core_free(oldhandle);
+}
+
+/**
+ * is this the directory that the dircache file is kept in? the file is only
+ * written once the checksum of its directory has been taken, so its entries
+ * are left out of that checksum
+ */
+static bool is_dircache_file_dir(int idx)
+{
+    static char name[DC_MAX_NAME + 1];
+    const char *path = DIRCACHE_FILE;
+    const char *end = strrchr(path, PATH_SEPCH);
+
+    /* match the path components from the last one up */
+    while (end > path)
+    {
+        const char *comp = end;
+        while (comp[-1] != PATH_SEPCH)
+            comp--;
+
+        if (idx <= 0)
+            return false;
+
+        struct dircache_entry *ce = get_entry(idx);
+        entry_name_copy(name, ce);
+
+        size_t len = end - comp;
+        if (strncasecmp(name, comp, len) || name[len])
+            return false;
+
+        idx = ce->up;
+        end = comp - 1;
+    }
+
+    return idx == -1; /* the root of the default volume */
+}
+
+/**
+ * set what a directory's checksum leaves out before it is taken
+ */
+static void snapshot_crc_skip(struct fat_dirbulk *bulk, int idx)
+{
+    fat_dirbulk_skip(bulk, is_dircache_file_dir(idx) ?
+                           strrchr(DIRCACHE_FILE, PATH_SEPCH) + 1 : NULL);
+}
+#endif /* DIRCACHE_SNAPSHOT */
+
 /**
  * remove all messages from the queue, responding to anyone waiting
  */
@@ -1210,6 +1747,11 @@ static void clear_dircache_queue(void)
  */
 static void process_events(void)
 {
+#ifdef DIRCACHE_SNAPSHOT
+    /* the scan records a checksum for each directory it completes */
+    dirsum_reserve();
+#endif
+
     yield();
 
     /* only count externally generated commands */
@@ -1253,6 +1795,14 @@ static void sab_process_sub(struct sab *sabp)
         fat_rewind(&streamp->fatstr);
         uncached_rewinddir_internal(infop);
 
+        if (sabp->bulkp)
+        {
+            sabp->bulkp->count = 0; /* different directory */
+        #ifdef DIRCACHE_SNAPSHOT
+            snapshot_crc_skip(sabp->bulkp, compp->idx);
+        #endif
+        }
+
         const long dircluster = streamp->infop->fatfile.firstcluster;
 
         /* first pass: read directory */
@@ -1270,7 +1820,11 @@ static void sab_process_sub(struct sab *sabp)
             }
             /* else an immediate-contents directory scan */
 
-            int rc = uncached_readdir_internal(streamp, infop, fatentp);
+            int rc = sabp->bulkp ?
+                fat_readdir_bulk(&streamp->fatstr, &infop->fatfile.e,
+                                 filestr_get_cache(streamp), sabp->bulkp,
+                                 fatentp) :
+                uncached_readdir_internal(streamp, infop, fatentp);
             if (rc <= 0)
             {
                 if (rc < 0)
@@ -1332,6 +1886,10 @@ static void sab_process_sub(struct sab *sabp)
             ce->wrtdate      = fatentp->wrtdate;
             ce->wrttime      = fatentp->wrttime;
 
+        #ifdef DIRCACHE_NAME_INDEX
+            index_insert(idx, ce);
+        #endif
+
             /* resolve queued user bindings */
             infop->fatfile.firstcluster = fatentp->firstcluster;
             infop->fatfile.dircluster   = dircluster;
@@ -1345,6 +1903,13 @@ static void sab_process_sub(struct sab *sabp)
         if (sabp->quit)
             return;
 
+    #ifdef DIRCACHE_SNAPSHOT
+        uint32_t crc;
+        if (compp->idx && sabp->bulkp &&
+            fat_dirbulk_checksum(sabp->bulkp, &crc))
+            dirsum_set(compp->idx, crc);
+    #endif
+
         establish_frontier(compp->idx, FRONTIER_SETTLED);
 
         /* second pass: "recurse!" */
@@ -1404,6 +1969,7 @@ static void sab_process_dir(struct file_base_info *infop, bool issab)
     struct sab *sabp = &dirsab.sab;
 
     sabp->quit     = false;
+    sabp->bulkp    = issab ? &sab_bulk : NULL;
     sabp->stackend = &sabp->stack[ARRAYLEN(dirsab.stack)];
     sabp->top      = sabp->stackend;
     sabp->info     = *infop;
@@ -1414,38 +1980,324 @@ static void sab_process_dir(struct file_base_info *infop, bool issab)
     establish_frontier(infop->dcfile.idx, FRONTIER_NEW | FRONTIER_RENEW);
     sab_process_sub(sabp);
 
-    if (issab)
-        DCRIVOL(infop)->sabp = NULL;
+    if (issab)
+        DCRIVOL(infop)->sabp = NULL;
+}
+
+/**
+ * scan and build the entire tree for a volume
+ */
+static void sab_process_volume(struct dircache_volume *dcvolp)
+{
+    int rc;
+
+    int volume = IF_MV_VOL(dcvolp - dircache.dcvol);
+    int idx = -volume - 1;
+
+    logf("dircache - building volume %d", volume);
+
+    /* gather everything sab_process_dir() needs in order to begin a scan */
+    struct file_base_info info;
+    rc = fat_open_rootdir(IF_MV(volume,) &info.fatfile);
+    if (rc < 0)
+    {
+        /* probably not mounted */
+        logf("SAB - no root %d: %d", volume, rc);
+        establish_frontier(idx, FRONTIER_NEW);
+        return;
+    }
+
+    info.dcfile.idx       = idx;
+    info.dcfile.serialnum = dcvolp->serialnum;
+    binding_resolve(&info);
+    sab_process_dir(&info, true);
+}
+
+#ifdef DIRCACHE_SNAPSHOT
+/**
+ * is the entry a subdirectory other than "." or ".."?
+ */
+static bool is_subdir_entry(const struct dircache_entry *ce)
+{
+    return (ce->attr & ATTR_DIRECTORY) &&
+           !(ce->tinyname && is_dotdir_name((const char *)ce->namebuf));
+}
+
+/**
+ * return the next subdirectory after 'idx' in a walk of its volume that visits
+ * parents before children; 0 when the walk is complete
+ */
+static int next_subdir(int idx)
+{
+    int parent = idx;
+    int cur = *get_downidxp(idx);
+
+    while (1)
+    {
+        for (; cur; cur = get_entry(cur)->next)
+        {
+            if (is_subdir_entry(get_entry(cur)))
+                return cur;
+        }
+
+        if (parent < 0)
+            return 0; /* volume root exhausted */
+
+        /* this level is done; continue after it in its own parent */
+        struct dircache_entry *ce = get_entry(parent);
+        cur    = ce->next;
+        parent = ce->up;
+    }
+}
+
+/**
+ * open the FS object of a cached directory or volume root
+ */
+static int snapshot_open_dir(int idx, struct fat_file *file)
+{
+    int rootidx = idx;
+    while (rootidx > 0)
+        rootidx = get_entry(rootidx)->up;
+
+    int rc = fat_open_rootdir(IF_MV(IF_MV_VOL(-rootidx - 1),) file);
+    if (rc < 0 || idx < 0)
+        return rc;
+
+    struct dircache_entry *ce = get_entry(idx);
+    struct fat_file parent = *file;
+    if (ce->up > 0)
+        parent.firstcluster = get_entry(ce->up)->firstcluster;
+
+    return fat_open(&parent, ce->firstcluster, file);
+}
+
+/**
+ * checksum the contents of a cached directory as they are on disk now
+ */
+static int snapshot_dir_crc(int idx, uint32_t *crcp)
+{
+    struct fat_file file;
+    int rc = snapshot_open_dir(idx, &file);
+    if (rc < 0)
+        return rc;
+
+    struct fat_filestr dirstr;
+    fat_filestr_init(&dirstr, &file);
+    snapshot_crc_skip(&sab_bulk, idx);
+    return fat_dir_checksum(&dirstr, &sab_bulk, crcp);
+}
+
+/**
+ * find the record that the loaded snapshot has for a directory
+ */
+static struct dircache_dirsum * snapshot_find_sum(int idx)
+{
+    if (!dircache_runinfo.snap_count)
+        return NULL;
+
+    struct dircache_dirsum *sums = core_get_data(dircache_runinfo.snap_handle);
+    unsigned int lo = 0, hi = dircache_runinfo.snap_count;
+
+    /* the records are written in ascending index order */
+    while (lo < hi)
+    {
+        unsigned int mid = (lo + hi) / 2;
+        if (sums[mid].idx < idx)
+            lo = mid + 1;
+        else if (sums[mid].idx > idx)
+            hi = mid;
+        else
+            return &sums[mid];
+    }
+
+    return NULL;
+}
+
+/**
+ * free the subtree in the referenced down index along with any contents still
+ * held aside for directories within it
+ */
+static void snapshot_free_subentries(struct dircache_runinfo_volume *dcrivolp,
+                                     int *downp)
+{
+    if (dircache_runinfo.snap_count)
+    {
+        for (int idx = *downp; idx; idx = get_entry(idx)->next)
+        {
+            struct dircache_entry *ce = get_entry(idx);
+            if (!is_subdir_entry(ce))
+                continue;
+
+            struct dircache_dirsum *sump = snapshot_find_sum(idx);
+            if (sump && sump->down)
+                snapshot_free_subentries(NULL, &sump->down);
+
+            snapshot_free_subentries(dcrivolp, &ce->down);
+        }
+    }
+
+    free_subentries(dcrivolp, downp);
+}
+
+/**
+ * check one directory of a loaded snapshot against the disk; if it's the same,
+ * the contents held aside for it are put back, otherwise they are thrown out
+ * and it is scanned again
+ *
+ * returns > 0 if it was unchanged, 0 if it was rescanned or < 0 on error
+ */
+static int sab_validate_dir(struct dircache_volume *dcvolp,
+                            struct dircache_runinfo_volume *dcrivolp, int idx)
+{
+    struct dircache_entry *ce = get_entry(idx);
+    int *downp = get_downidxp(idx);
+    uint32_t crc;
+
+    int rc = snapshot_dir_crc(idx, &crc);
+    struct dircache_dirsum *sump = snapshot_find_sum(idx);
+
+    dircache_runinfo.snap_dirs++;
+
+    if (rc >= 0 && sump && crc == sump->crc &&
+        (!ce || sump->firstcluster == (uint32_t)ce->firstcluster))
+    {
+        /* still as it was; put its contents back and make sure nothing below
+           it that can't be checked shows through */
+        free_subentries(dcrivolp, downp);
+        *downp = sump->down;
+        sump->down = 0;
+
+        for (int sub = *downp; sub; sub = get_entry(sub)->next)
+        {
+            struct dircache_entry *subce = get_entry(sub);
+            if (!is_subdir_entry(subce) || !subce->down)
+                continue;
+
+            snapshot_free_subentries(dcrivolp, &subce->down);
+            establish_frontier(sub, FRONTIER_NEW);
+        }
+
+        dirsum_set(idx, crc);
+        establish_frontier(idx, FRONTIER_SETTLED);
+        return 1;
+    }
+
+    dircache_runinfo.snap_stale++;
+    logf("dircache - stale dir %d", idx);
+
+    if (sump && sump->down)
+        snapshot_free_subentries(NULL, &sump->down);
+
+    snapshot_free_subentries(dcrivolp, downp);
+
+    struct file_base_info info;
+    rc = snapshot_open_dir(idx, &info.fatfile);
+    if (rc < 0)
+    {
+        establish_frontier(idx, FRONTIER_NEW);
+        return rc;
+    }
+
+    info.dcfile.idx = idx;
+
+    if (ce)
+    {
+        info.fatfile.e.entry   = ce->direntry;
+        info.fatfile.e.entries = ce->direntries;
+        info.dcfile.serialnum  = ce->serialnum;
+    }
+    else
+    {
+        info.dcfile.serialnum  = dcvolp->serialnum;
+        binding_resolve(&info);
+    }
+
+    sab_process_dir(&info, true);
+
+    /* an incomplete scan leaves it unsettled */
+    return (get_frontier(idx) & FRONTIER_NEW) ? -1 : 0;
 }
 
 /**
- * scan and build the entire tree for a volume
+ * bring a volume restored from a snapshot up to date; only directories whose
+ * contents on disk no longer match their checksum are scanned again
  */
-static void sab_process_volume(struct dircache_volume *dcvolp)
+static void sab_validate_volume(struct dircache_volume *dcvolp)
 {
-    int rc;
-
     int volume = IF_MV_VOL(dcvolp - dircache.dcvol);
-    int idx = -volume - 1;
+    struct dircache_runinfo_volume *dcrivolp = &dircache_runinfo.dcrivol[volume];
+    int rootidx = -volume - 1;
 
-    logf("dircache - building volume %d", volume);
+    logf("dircache - validating volume %d", volume);
 
-    /* gather everything sab_process_dir() needs in order to begin a scan */
-    struct file_base_info info;
-    rc = fat_open_rootdir(IF_MV(volume,) &info.fatfile);
-    if (rc < 0)
+    int idx = rootidx;
+    while (idx)
     {
-        /* probably not mounted */
-        logf("SAB - no root %d: %d", volume, rc);
-        establish_frontier(idx, FRONTIER_NEW);
-        return;
+        if (get_frontier(idx) & FRONTIER_NEW)
+        {
+            dc_serial_t serialnum =
+                idx < 0 ? dcvolp->serialnum : get_entry(idx)->serialnum;
+
+            if (sab_validate_dir(dcvolp, dcrivolp, idx) < 0)
+            {
+                /* give up on the rest; nothing unchecked may remain */
+                struct dircache_dirsum *sump = snapshot_find_sum(rootidx);
+                if (sump && sump->down)
+                    snapshot_free_subentries(NULL, &sump->down);
+
+                snapshot_free_subentries(dcrivolp, &dcvolp->root_down);
+                establish_frontier(rootidx, FRONTIER_NEW);
+                break;
+            }
+
+            /* release control and process queued events */
+            dircache_unlock();
+            process_events();
+            dircache_lock();
+
+            if (dircache_runinfo.suspended || !dcrivolp->validate)
+                return; /* volume was reset */
+
+            /* if it was removed in the meantime, the walk can't continue from
+               it; go again from the top, passing over what's now settled */
+            struct dircache_entry *ce = get_entry(idx);
+            if (idx > 0 && (!ce || ce->serialnum != serialnum))
+            {
+                idx = rootidx;
+                continue;
+            }
+        }
+
+        idx = next_subdir(idx);
     }
 
-    info.dcfile.idx       = idx;
-    info.dcfile.serialnum = dcvolp->serialnum;
-    binding_resolve(&info);
-    sab_process_dir(&info, true);
+    dcrivolp->validate = false;
+}
+
+/**
+ * free the snapshot records once no volume needs them any longer
+ */
+static void snapshot_release(void)
+{
+    for (int i = 0; i < NUM_VOLUMES; i++)
+    {
+        if (dircache_runinfo.dcrivol[i].validate)
+            return;
+    }
+
+    int handle = dircache_runinfo.snap_handle;
+    if (!handle)
+        return;
+
+    dircache_runinfo.snap_handle = 0;
+    dircache_runinfo.snap_count  = 0;
+
+    dircache_unlock();
+    core_unpin(handle);
+    core_free(handle);
+    dircache_lock();
 }
+#endif /* DIRCACHE_SNAPSHOT */
 
 /**
  * this function is the back end to the public API's like readdir()
@@ -1652,6 +2504,60 @@ void dircache_rewinddir_internal(struct file_base_info *infop)
     dircache_dcfile_init(&infop->dcfile);
 }
 
+#ifdef DIRCACHE_NAME_INDEX
+/**
+ * find the named entry in the directory of the stream using the name index;
+ * returns what dircache_readdir_internal() would for the entry, 0 if it
+ * certainly doesn't exist or < 0 if the directory must be scanned instead
+ */
+int dircache_lookup_internal(struct filestr_base *stream, const char *name,
+                             struct file_base_info *infop,
+                             struct fat_direntry *fatent)
+{
+    /* call with writer exclusion */
+    struct file_base_info *dirinfop = stream->infop;
+
+    if (!dircache_runinfo.index_valid || !dirinfop->dcfile.serialnum)
+        return -1;
+
+    int diridx = dirinfop->dcfile.idx;
+    int idx = index_lookup(diridx, name);
+
+    if (!idx)
+    {
+        unsigned int frontier = diridx < 0 ?
+            DCVOL(dirinfop)->frontier : get_entry(diridx)->frontier;
+
+        /* absent for sure only if everything there is cached and indexed */
+        if ((frontier != FRONTIER_SETTLED && !(stream->flags & FF_CACHEONLY)) ||
+            dircache_runinfo.index_unindexed)
+            return -1;
+
+        fat_empty_fat_direntry(fatent);
+        infop->fatfile.e.entries = 0;
+        infop->dcfile.serialnum  = 0;
+        return 0;
+    }
+
+    struct dircache_entry *ce = get_entry(idx);
+
+    /* as dircache_readdir_internal() */
+    entry_name_copy(fatent->name, ce);
+    fatent->shortname[0]     = '\0';
+    fatent->attr             = ce->attr;
+    fatent->filesize         = (ce->attr & ATTR_DIRECTORY) ? 0 : ce->filesize;
+    fatent->firstcluster     = ce->firstcluster;
+
+    infop->fatfile.e.entry   = ce->direntry;
+    infop->fatfile.e.entries = ce->direntries;
+
+    infop->dcfile.idx        = idx;
+    infop->dcfile.serialnum  = ce->serialnum;
+
+    return ce->direntries == 1 ? 2 : 1;
+}
+#endif /* DIRCACHE_NAME_INDEX */
+
 #else /* !DIRCACHE_NATIVE (for all others) */
 
 #####################
@@ -1786,11 +2692,25 @@ static void reset_volume(IF_MV_NONVOID(int volume))
            the cache memory usage and the freeing of individual entries may
            be skipped */
         if (volume >= 0)
+        {
+        #ifdef DIRCACHE_SNAPSHOT
+            struct dircache_dirsum *sump = snapshot_find_sum(-i - 1);
+            if (sump && sump->down)
+                snapshot_free_subentries(NULL, &sump->down);
+
+            snapshot_free_subentries(NULL, &dcvolp->root_down);
+        #else
             free_subentries(NULL, &dcvolp->root_down);
+        #endif
+        }
         else
     #endif
             binding_dissolve_volume(dcrivolp);
 
+    #ifdef DIRCACHE_SNAPSHOT
+        dcrivolp->validate = false;
+    #endif
+
         /* set it back to unscanned */
         dcvolp->status      = DIRCACHE_IDLE;
         dcvolp->frontier    = FRONTIER_NEW;
@@ -1816,6 +2736,16 @@ static void reset_cache(void)
                           dircache_runinfo.bufsize);
 #endif /* DIRCACHE_DUMPSTER */
 
+#ifdef DIRCACHE_NAME_INDEX
+    dircache_runinfo.index_valid = false;
+#endif
+
+#ifdef DIRCACHE_SNAPSHOT
+    /* whatever was held aside goes with the rest */
+    dircache_runinfo.snap_count = 0;
+    dircache_runinfo.sums_count = 0;
+#endif
+
     /* reset the memory */
     dircache.free_list    = 0;
     dircache.size         = 0;
@@ -1838,6 +2768,11 @@ static void build_volumes(void)
 {
     core_pin(dircache_runinfo.handle);
 
+#ifdef DIRCACHE_NATIVE
+    sab_bulk.reads   = 0;
+    sab_bulk.sectors = 0;
+#endif
+
     for (int i = 0; i < NUM_VOLUMES; i++)
     {
         /* this does reader locking but we already own that */
@@ -1858,7 +2793,12 @@ static void build_volumes(void)
         dcvolp->status = DIRCACHE_SCANNING;
         dcvolp->start_tick = current_tick;
 
-        sab_process_volume(dcvolp);
+    #ifdef DIRCACHE_SNAPSHOT
+        if (DCRIVOL(i)->validate)
+            sab_validate_volume(dcvolp);
+        else
+    #endif
+            sab_process_volume(dcvolp);
 
         if (dircache_runinfo.suspended)
             break;
@@ -1884,6 +2824,10 @@ static void build_volumes(void)
 
     if (dircache_runinfo.handle > 0) /* dircache may have been disabled */
         core_unpin(dircache_runinfo.handle);
+
+#ifdef DIRCACHE_SNAPSHOT
+    snapshot_release();
+#endif
 }
 
 /**
@@ -1897,17 +2841,8 @@ static int prepare_build(bool *realloced)
     /* called holding dircache lock */
     size_t size = dircache.last_size;
 
-#ifdef HAVE_EEPROM_SETTINGS
-    if (realloced)
-    {
-        dircache_unlock();
-        remove_dircache_file();
-        dircache_lock();
-
-        if (dircache_runinfo.suspended)
-            return -1;
-    }
-#endif /* HAVE_EEPROM_SETTINGS */
+    /* a snapshot file is kept across builds; whatever it holds gets checked
+       against the disk before use */
 
     bool stuffed = DIRCACHE_STUFFED(dircache.reserve_used);
     if (dircache_runinfo.bufsize > size && !stuffed)
@@ -2052,6 +2987,11 @@ static void dircache_thread(void)
         /* if it was reallocated, compact it */
         if (realloced)
             compact_cache();
+
+    #ifdef DIRCACHE_NAME_INDEX
+        if (!dircache_runinfo.suspended)
+            index_build();
+    #endif
      }
 
      dircache_unlock();
@@ -2132,14 +3072,44 @@ static void dircache_suspend_internal(bool freeit)
     reset_cache();
     clear_dircache_queue();
 
+#ifdef DIRCACHE_SNAPSHOT
+    snapshot_release();
+#endif
+
     /* grab the buffer away into our control; the cache won't need it now */
     int handle = 0;
     if (freeit)
         handle = reset_buffer();
 
+#ifdef DIRCACHE_NAME_INDEX
+    int index_handle = 0;
+    if (freeit)
+    {
+        index_handle = dircache_runinfo.index_handle;
+        dircache_runinfo.index_handle = 0;
+        dircache_runinfo.index_slots  = 0;
+    }
+#endif
+
+#ifdef DIRCACHE_SNAPSHOT
+    int sums_handle = 0;
+    if (freeit)
+    {
+        sums_handle = dircache_runinfo.sums_handle;
+        dircache_runinfo.sums_handle = 0;
+        dircache_runinfo.sums_slots  = 0;
+    }
+#endif
+
     dircache_unlock();
 
     core_free(handle);
+#ifdef DIRCACHE_NAME_INDEX
+    core_free(index_handle);
+#endif
+#ifdef DIRCACHE_SNAPSHOT
+    core_free(sums_handle);
+#endif
 
     thread_wait(thread_id);
 
@@ -2352,6 +3322,10 @@ void dircache_fileop_create(struct file_base_info *dirinfop,
 
     insert_file_entry(dirinfop, ce);
 
+#ifdef DIRCACHE_SNAPSHOT
+    dirsum_invalidate(dirinfop->dcfile.idx);
+#endif
+
     /* file binding will have been queued when it was opened; just resolve */
     infop->dcfile.idx       = idx;
     infop->dcfile.serialnum = ce->serialnum;
@@ -2377,6 +3351,11 @@ void dircache_fileop_remove(struct file_base_binding *bindp)
     if (!bindp->info.dcfile.serialnum)
         return; /* no binding yet */
 
+#ifdef DIRCACHE_SNAPSHOT
+    if (bindp->info.dcfile.idx > 0)
+        dirsum_invalidate(get_entry(bindp->info.dcfile.idx)->up);
+#endif
+
     free_file_entry(&bindp->info);
 
     /* if binding was resolved; it should now be queued via above call */
@@ -2417,6 +3396,13 @@ void dircache_fileop_rename(struct file_base_info *dirinfop,
        underlying FS probably changed the order */
     struct dircache_entry *ce = remove_file_entry(&bindp->info);
 
+#ifdef DIRCACHE_SNAPSHOT
+    /* a directory moved elsewhere has its ".." changed too */
+    dirsum_invalidate(ce->up);
+    dirsum_invalidate(dirinfop->dcfile.idx);
+    dirsum_invalidate(bindp->info.dcfile.idx);
+#endif
+
 #ifdef DIRCACHE_NATIVE
     /* update other name-related information before inserting */
     ce->direntry   = bindp->info.fatfile.e.entry;
@@ -2427,8 +3413,15 @@ void dircache_fileop_rename(struct file_base_info *dirinfop,
     insert_file_entry(dirinfop, ce);
 
     /* lastly, update the entry name itself */
+#ifdef DIRCACHE_NAME_INDEX
+    index_remove(bindp->info.dcfile.idx, ce);
+#endif
+
     if (entry_reassign_name(ce, basename) == 0)
     {
+    #ifdef DIRCACHE_NAME_INDEX
+        index_insert(bindp->info.dcfile.idx, ce);
+    #endif
         /* it's not really the same one now so re-stamp it */
         dc_serial_t serialnum = next_serialnum();
         ce->serialnum = serialnum;
@@ -2439,6 +3432,11 @@ void dircache_fileop_rename(struct file_base_info *dirinfop,
         /* it cannot be kept around without a valid name */
         free_file_entry(&bindp->info);
         establish_frontier(dirinfop->dcfile.idx, FRONTIER_ZONED);
+    #ifdef DIRCACHE_NAME_INDEX
+        /* it left the index under its old name already; recount */
+        if (dircache_runinfo.index_valid)
+            index_fill();
+    #endif
     }
 }
 
@@ -2472,6 +3470,10 @@ void dircache_fileop_sync(struct file_base_binding *bindp,
     ce->attr         = dinp->attr;
     if (!(dinp->attr & ATTR_DIRECTORY))
         ce->filesize = dinp->size;
+
+#ifdef DIRCACHE_SNAPSHOT
+    dirsum_invalidate(ce->up);
+#endif
 }
 
 
@@ -2848,6 +3850,14 @@ void dircache_get_info(struct dircache_info *info)
 
     info->status     = status;
     info->statusdesc = status_descriptions[status];
+#ifdef DIRCACHE_NATIVE
+    info->dir_reads   = sab_bulk.reads;
+    info->dir_sectors = sab_bulk.sectors;
+#endif
+#ifdef DIRCACHE_SNAPSHOT
+    info->snap_dirs   = dircache_runinfo.snap_dirs;
+    info->snap_stale  = dircache_runinfo.snap_stale;
+#endif
     info->last_size  = dircache.last_size;
     info->size_limit = DIRCACHE_LIMIT;
     info->reserve    = DIRCACHE_RESERVE;
@@ -2868,6 +3878,12 @@ void dircache_get_info(struct dircache_info *info)
         info->entry_count  = 0;
     }
 
+#ifdef DIRCACHE_NAME_INDEX
+    bool indexed = status != DIRCACHE_IDLE && dircache_runinfo.index_valid;
+    info->index_slots = indexed ? dircache_runinfo.index_slots : 0;
+    info->index_used  = indexed ? dircache_runinfo.index_used : 0;
+#endif
+
     dircache_unlock();
 }
 
@@ -2984,23 +4000,27 @@ void dircache_dcfile_init(struct dircache_file *dcfilep)
     dcfilep->serialnum = 0;
 }
 
-#ifdef HAVE_EEPROM_SETTINGS
+#ifdef DIRCACHE_SNAPSHOT
 
-#ifdef HAVE_HOTSWAP
-/* NOTE: This is hazardous to the filesystem of any sort of removable
-         storage unless it may be determined that the filesystem from save
-         to load is identical. If it's not possible to do so in a timely
-         manner, it's not worth persisting the cache. */
-  #warning "Don't do this; you'll find the consequences unpleasant."
-#endif
+/* NOTE: Nothing in a snapshot is taken on faith. Every directory is checked
+         against what is on the disk at the time it's loaded and anything
+         that differs is scanned again, so it's safe whether or not the last
+         shutdown was clean and whether or not the storage changed meanwhile,
+         removable storage included. */
 
 /* dircache persistence file header magic */
-#define DIRCACHE_MAGIC  0x00d0c0a1
+#define DIRCACHE_MAGIC    0x00d0c0a1
 
-/* dircache persistence file header */
+/* version of the snapshot layout */
+#define DIRCACHE_VERSION  3
+
+/* dircache persistence file header; the header is followed by the entries,
+   the names and then the directory records in ascending index order */
 struct dircache_maindata
 {
     uint32_t        magic;      /* DIRCACHE_MAGIC */
+    uint32_t        version;    /* DIRCACHE_VERSION */
+    uint32_t        numdirs;    /* number of directory records */
     struct dircache dircache;   /* metadata of the cache! */
     uint32_t        datacrc;    /* CRC32 of data */
     uint32_t        hdrcrc;     /* CRC32 of header through datacrc */
@@ -3012,7 +4032,17 @@ struct dircache_maindata
 static bool dircache_is_clean(bool saving)
 {
     if (saving)
+    {
+        /* no volume may be caught in the middle of a build */
+        for (int i = 0; i < NUM_VOLUMES; i++)
+        {
+            unsigned int status = dircache.dcvol[i].status;
+            if (status != DIRCACHE_READY && status != DIRCACHE_IDLE)
+                return false;
+        }
+
         return dircache.dcvol[0].status == DIRCACHE_READY;
+    }
     else
     {
         return dircache.dcvol[0].status == DIRCACHE_IDLE &&
@@ -3022,7 +4052,8 @@ static bool dircache_is_clean(bool saving)
 
 /**
  * function to load the internal cache structure from disk to initialize
- * the dircache really fast with little disk access.
+ * the dircache really fast with little disk access; the directories are
+ * checked against the disk in the background before they are used
  */
 int dircache_load(void)
 {
@@ -3037,6 +4068,7 @@ int dircache_load(void)
     struct dircache_maindata maindata;
     uint32_t crc;
     int handle = 0;
+    int snaphandle = 0;
     bool hasbuffer = false;
 
     size = sizeof (maindata);
@@ -3047,7 +4079,8 @@ int dircache_load(void)
     }
 
     /* sanity check the header */
-    if (maindata.magic != DIRCACHE_MAGIC)
+    if (maindata.magic != DIRCACHE_MAGIC ||
+        maindata.version != DIRCACHE_VERSION)
     {
         logf("dircache: invalid header magic");
         goto error_nolock;
@@ -3061,10 +4094,13 @@ int dircache_load(void)
         goto error_nolock;
     }
 
+    size_t sizedirs = maindata.numdirs * sizeof (struct dircache_dirsum);
+
     if (maindata.dircache.size !=
             maindata.dircache.sizeentries + maindata.dircache.sizenames ||
         ALIGN_DOWN(maindata.dircache.size, ENTRYSIZE) != maindata.dircache.size ||
-        filesize(fd) - sizeof (maindata) != maindata.dircache.size)
+        maindata.numdirs == 0 || maindata.numdirs > DIRCACHE_LIMIT / ENTRYSIZE ||
+        filesize(fd) - sizeof (maindata) != maindata.dircache.size + sizedirs)
     {
         logf("dircache: file header error");
         goto error_nolock;
@@ -3079,6 +4115,16 @@ int dircache_load(void)
         goto error_nolock;
     }
 
+    /* the records stay put until every loaded directory has been checked */
+    snaphandle = core_alloc(sizedirs);
+    if (snaphandle <= 0)
+    {
+        logf("dircache: failed snapshot allocation");
+        goto error_nolock;
+    }
+
+    core_pin(snaphandle);
+
     dircache_lock();
 
     if (!dircache_is_clean(false))
@@ -3116,6 +4162,16 @@ int dircache_load(void)
     }
 
     crc = crc_32(get_name(dircache.names), size, crc);
+
+    /* finish with the directory records */
+    struct dircache_dirsum *sums = core_get_data(snaphandle);
+    if (read(fd, sums, sizedirs) != (ssize_t)sizedirs)
+    {
+        logf("dircache read failed #3");
+        goto error;
+    }
+
+    crc = crc_32(sums, sizedirs, crc);
     if (crc != maindata.datacrc)
     {
         logf("dircache: data failed CRC32");
@@ -3137,29 +4193,110 @@ int dircache_load(void)
         }
     }
 
+    /* hold aside the contents of every directory with a record; they're put
+       back one directory at a time as each is found to be unchanged */
+    for (unsigned int i = 0; i < maindata.numdirs; i++)
+    {
+        struct dircache_dirsum *sump = &sums[i];
+        sump->down = 0;
+
+        if (i > 0 && sump->idx <= sums[i - 1].idx)
+        {
+            logf("dircache: records out of order");
+            goto error;
+        }
+
+        if (sump->idx < 0)
+        {
+            if (sump->idx < -NUM_VOLUMES ||
+                get_idx_dcvolp(sump->idx)->status != DIRCACHE_READY)
+                continue;
+        }
+        else
+        {
+            struct dircache_entry *ce = get_entry(sump->idx);
+            if (!ce || !ce->serialnum || !is_subdir_entry(ce) ||
+                (uint32_t)ce->firstcluster != sump->firstcluster)
+                continue;
+        }
+
+        int *downp = get_downidxp(sump->idx);
+        sump->down = *downp;
+        *downp = 0;
+    }
+
+    /* nothing may be trusted until checked; any directory that wasn't held
+       aside still shows its old contents so it must be below one that was */
+    FOR_EACH_CACHE_ENTRY(ce)
+    {
+        if (is_subdir_entry(ce))
+            ce->frontier = FRONTIER_NEW | (ce->frontier & FRONTIER_ZONED);
+    }
+
+    for (int i = 0; i < NUM_VOLUMES; i++)
+    {
+        struct dircache_volume *dcvolp = &dircache.dcvol[i];
+        if (dcvolp->status != DIRCACHE_READY)
+            continue;
+
+        if (dcvolp->root_down)
+        {
+            logf("dircache: no record for root %d", i);
+            goto error;
+        }
+
+        dcvolp->status   = DIRCACHE_SCANNING;
+        dcvolp->frontier = FRONTIER_NEW | (dcvolp->frontier & FRONTIER_ZONED);
+        dircache_runinfo.dcrivol[i].validate = true;
+    }
+
+    dircache_runinfo.snap_handle = snaphandle;
+    dircache_runinfo.snap_count  = maindata.numdirs;
+    dircache_runinfo.snap_dirs   = 0;
+    dircache_runinfo.snap_stale  = 0;
+
     dircache.reserve_used = 0;
 
-    /* enable the cache but do not try to build it */
-    dircache_enable_internal(false);
+    /* the buffer is already as large as it needs to be for this */
+    if (dircache.last_size > dircache.size)
+        dircache.last_size = dircache.size;
 
     /* cache successfully loaded */
     core_unpin(handle);
     logf("Done, %ld KiB used", dircache.size / 1024);
     rc = 0;
+
+    /* enable the cache and have the background checks begin */
+    dircache_enable_internal(true);
 error:
     if (rc < 0 && hasbuffer)
+    {
+        for (int i = 0; i < NUM_VOLUMES; i++)
+            dircache_runinfo.dcrivol[i].validate = false;
+
         reset_buffer();
+    }
 
     dircache_unlock();
 
 error_nolock:
     if (rc < 0)
+    {
         core_free(handle);
 
+        if (snaphandle > 0)
+        {
+            core_unpin(snaphandle);
+            core_free(snaphandle);
+        }
+
+        /* don't try it again */
+        remove_dircache_file();
+    }
+
     if (fd >= 0)
         close(fd);
 
-    remove_dircache_file();
     return rc;
 }
 
@@ -3171,17 +4308,23 @@ int dircache_save(void)
 {
     logf("Saving directory cache");
 
-    int fd = open_dircache_file(O_WRONLY|O_CREAT|O_TRUNC|O_APPEND);
-    if (fd < 0)
+    dircache_lock();
+
+    /* a volume still being built or checked can't be saved; any earlier
+       snapshot is left as it is since it is checked when loaded anyway */
+    if (!dircache_is_clean(true))
+    {
+        dircache_unlock();
         return -1;
+    }
 
-    /* it seems the handle *must* exist if this function is called */
-    dircache_lock();
     core_pin(dircache_runinfo.handle);
+    if (dircache_runinfo.sums_handle)
+        core_pin(dircache_runinfo.sums_handle);
 
     int rc = -1;
-
-    if (!dircache_is_clean(true))
+    int fd = open_dircache_file(O_WRONLY|O_CREAT|O_TRUNC|O_APPEND);
+    if (fd < 0)
         goto error;
 
     /* save the header structure along with the cache metadata */
@@ -3190,6 +4333,7 @@ int dircache_save(void)
     struct dircache_maindata maindata =
     {
         .magic    = DIRCACHE_MAGIC,
+        .version  = DIRCACHE_VERSION,
         .dircache = dircache,
     };
 
@@ -3223,6 +4367,83 @@ int dircache_save(void)
     }
 
     crc = crc_32(get_name(dircache.names), size, crc);
+
+    /* record the checksum of every directory that is completely cached and
+       unchanged since it was taken; roots first, then in index order; those
+       left out are scanned again once loaded */
+    struct dircache_dirsum sums[16];
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < NUM_VOLUMES + dircache_runinfo.sums_count;
+         i++)
+    {
+        struct dircache_dirsum *sump = &sums[count];
+        struct dircache_dirsum_ram *ramp;
+        struct dircache_entry *ce = NULL;
+        int idx;
+
+        if (i < NUM_VOLUMES)
+        {
+            idx = (int)i - NUM_VOLUMES;
+            if (get_idx_dcvolp(idx)->status != DIRCACHE_READY ||
+                (get_frontier(idx) & FRONTIER_NEW))
+                continue;
+
+            /* a snapshot can't do without the roots; one that changed is
+               read once more */
+            ramp = dirsum_find(idx);
+            if (ramp)
+                sump->crc = ramp->crc;
+            else if (snapshot_dir_crc(idx, &sump->crc) < 0)
+                continue;
+        }
+        else
+        {
+            idx = ((struct dircache_dirsum_ram *)core_get_data(
+                        dircache_runinfo.sums_handle))[i - NUM_VOLUMES].idx;
+            if (idx < 0)
+                continue; /* roots were done first */
+
+            ramp = dirsum_find(idx);
+            ce = get_entry(idx);
+            if (!ramp || !is_subdir_entry(ce) ||
+                (get_frontier(idx) & FRONTIER_NEW))
+                continue;
+
+            sump->crc = ramp->crc;
+        }
+
+        sump->idx          = idx;
+        sump->firstcluster = ce ? (uint32_t)ce->firstcluster : 0;
+        sump->down         = 0;
+        maindata.numdirs++;
+
+        if (++count < ARRAYLEN(sums))
+            continue;
+
+        size = count * sizeof (*sums);
+        if (write(fd, sums, size) != size)
+        {
+            logf("dircache: write failed #4");
+            goto error;
+        }
+
+        crc = crc_32(sums, size, crc);
+        count = 0;
+    }
+
+    if (count)
+    {
+        size = count * sizeof (*sums);
+        if (write(fd, sums, size) != size)
+        {
+            logf("dircache: write failed #4");
+            goto error;
+        }
+
+        crc = crc_32(sums, size, crc);
+    }
+
     maindata.datacrc = crc;
 
     /* rewrite the header with CRC info */
@@ -3238,24 +4459,29 @@ int dircache_save(void)
 
     if (write(fd, &maindata, sizeof (maindata)) != sizeof (maindata))
     {
-        logf("dircache: write failed #4");
+        logf("dircache: write failed #5");
         goto error;
     }
 
-    /* as of now, no changes to the volumes should be allowed at all since
-       that makes what was saved completely invalid */
     rc = 0;
 error:
+    if (dircache_runinfo.sums_handle)
+        core_unpin(dircache_runinfo.sums_handle);
+
     core_unpin(dircache_runinfo.handle);
     dircache_unlock();
 
-    if (rc < 0)
-        remove_dircache_file();
+    if (fd >= 0)
+    {
+        if (rc < 0)
+            remove_dircache_file();
+
+        close(fd);
+    }
 
-    close(fd);
     return rc;
 }
-#endif /* HAVE_EEPROM_SETTINGS */
+#endif /* DIRCACHE_SNAPSHOT */
 
 /**
  * main one-time initialization function that must be called before any other
@@ -3271,4 +4497,11 @@ void dircache_init(size_t last_size)
     dcrip->suspended         = 1;
     dcrip->thread_done       = true;
     dcrip->ops.move_callback = move_callback;
+#ifdef DIRCACHE_NAME_INDEX
+    dcrip->index_ops.move_callback = index_move_callback;
+#endif
+#ifdef DIRCACHE_NATIVE
+    sab_bulk.buf = sab_bulk_buf;
+    sab_bulk.max = DIRCACHE_BULK_SECTORS;
+#endif
 }
@@ -21,6 +21,7 @@
 #include "config.h"
 #include "debug.h"
 #include "system.h"
+#include <string.h>
 #include "linked_list.h"
 #include "disk_cache.h"
 #include "fs_defines.h"
@@ -87,6 +88,9 @@ static struct disk_cache_entry cache_entry[DC_NUM_ENTRIES];
 static cache_map_entry_t cache_map_entry[NUM_VOLUMES][DC_MAP_NUM_ENTRIES];
 static cache_map_entry_t cache_vol_map[NUM_VOLUMES] IBSS_ATTR;
 static uint8_t cache_buffer[DC_NUM_ENTRIES][DC_CACHE_BUFSIZE] CACHEALIGN_ATTR;
+/* gathers non-adjacent buffers of a sector run for one transfer */
+static uint8_t cache_run_buffer[DC_WRITE_RUN_MAX][DC_CACHE_BUFSIZE]
+    CACHEALIGN_ATTR;
 struct mutex disk_cache_mutex SHAREDBSS_ATTR;
 
 #define CACHE_MAP_ENTRY(volume, mapnum) \
@@ -204,7 +208,7 @@ void * dc_cache_probe(IF_MV(int volume,) unsigned long sector,
         unsigned int old_mapnum = map_sector(sector);
 
         if (old_flags & DCE_DIRTY)
-            dc_writeback_callback(IF_MV(old_volume,) sector, buf);
+            dc_writeback_callback(IF_MV(old_volume,) sector, 1, buf);
 
         if (mapnum == old_mapnum IF_MV( && volume == old_volume ))
             goto finish_setup;
@@ -252,22 +256,68 @@ void dc_discard_buf(void *buf)
         cache_discard_entry(dce, index);
 }
 
+/* write out a run of dirty entries with consecutive sectors */
+static void cache_commit_run(IF_MV(int volume,) const unsigned int idx[],
+                             unsigned int count)
+{
+    void *buf = cache_buffer[idx[0]];
+
+    /* entries that already lie in order in the buffer array needn't be
+       copied */
+    for (unsigned int i = 1; i < count; i++)
+    {
+        if (idx[i] != idx[0] + i)
+        {
+            buf = cache_run_buffer;
+            for (i = 0; i < count; i++)
+                memcpy(cache_run_buffer[i], cache_buffer[idx[i]],
+                       DC_CACHE_BUFSIZE);
+            break;
+        }
+    }
+
+    dc_writeback_callback(IF_MV(volume,) cache_entry[idx[0]].sector, count,
+                          buf);
+
+    for (unsigned int i = 0; i < count; i++)
+        cache_entry[idx[i]].flags &= ~DCE_DIRTY;
+}
+
 /* commit all dirty cache entries to storage for a specified volume */
 void dc_commit_all(IF_MV_NONVOID(int volume))
 {
     DEBUGF("dc_commit_all()\n");
 
+    /* gather the dirty entries, insertion-sorted by sector number */
+    unsigned int dirty[DC_NUM_ENTRIES];
+    unsigned int count = 0;
+
     FOR_EACH_BITARRAY_SET_BIT(&CACHE_VOL_MAP(volume), index)
     {
-        struct disk_cache_entry *dce = &cache_entry[index];
-        unsigned int flags = dce->flags;
+        if (!(cache_entry[index].flags & DCE_DIRTY))
+            continue;
 
-        if (flags & DCE_DIRTY)
-        {
-            dc_writeback_callback(IF_MV(volume,) dce->sector,
-                                  cache_buffer[index]);
-            dce->flags = flags & ~DCE_DIRTY;
-        }
+        unsigned long sector = cache_entry[index].sector;
+        unsigned int i = count++;
+
+        for (; i > 0 && cache_entry[dirty[i-1]].sector > sector; i--)
+            dirty[i] = dirty[i-1];
+
+        dirty[i] = index;
+    }
+
+    /* coalesce adjacent sectors into multi-sector writes */
+    for (unsigned int i = 0; i < count;)
+    {
+        unsigned long sector = cache_entry[dirty[i]].sector;
+        unsigned int n = 1;
+
+        while (i + n < count && n < DC_WRITE_RUN_MAX &&
+               cache_entry[dirty[i+n]].sector == sector + n)
+            n++;
+
+        cache_commit_run(IF_MV(volume,) &dirty[i], n);
+        i += n;
     }
 }
 
@@ -299,7 +349,8 @@ void * dc_get_buffer(void)
         {
             /* must first commit this sector if dirty */
             if (flags & DCE_DIRTY)
-                dc_writeback_callback(IF_MV(dce->volume,) dce->sector, buf);
+                dc_writeback_callback(IF_MV(dce->volume,) dce->sector, 1,
+                                      buf);
 
             cache_discard_entry(dce, index);
         }
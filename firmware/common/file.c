@@ -50,8 +50,28 @@ static struct filestr_desc
     struct filestr_base stream; /* basic stream info (first!) */
     file_size_t         offset; /* current offset for stream */
     file_size_t         *sizep; /* shortcut to file size in fileobj */
+#ifdef FILE_READAHEAD
+    file_size_t         ra_next;   /* offset at which the last read ended */
+    unsigned int        ra_window; /* read-ahead size in sectors (0 = off) */
+#endif
 } open_streams[MAX_OPEN_FILES];
 
+#ifdef FILE_READAHEAD
+/* read-ahead windows shared by all streams */
+static struct file_ra_buf
+{
+    struct filestr_desc *owner;  /* stream using the window; NULL if free */
+    unsigned long       sector;  /* first file sector in the window */
+    unsigned long       count;   /* number of sectors in the window */
+    unsigned long       lastuse; /* for replacing the least recently used */
+    uint8_t data[FILE_RA_MAX_SECTORS*SECTOR_SIZE] STORAGE_ALIGN_ATTR;
+} file_ra_bufs[FILE_RA_BUFS];
+
+static unsigned long file_ra_clock;
+static struct mutex file_ra_mutex;
+static struct file_io_stats file_stats;
+#endif /* FILE_READAHEAD */
+
 /* check and return a struct filestr_desc* from a file descriptor number */
 static struct filestr_desc * get_filestr(int fildes)
 {
@@ -85,6 +105,194 @@ static struct filestr_desc * get_filestr(int fildes)
         file_internal_unlock_##type();         \
     })
 
+#ifdef FILE_READAHEAD
+/* returns the window held by the stream, if any */
+static struct file_ra_buf * readahead_find(struct filestr_desc *file)
+{
+    for (int i = 0; i < FILE_RA_BUFS; i++)
+    {
+        if (file_ra_bufs[i].owner == file)
+            return &file_ra_bufs[i];
+    }
+
+    return NULL;
+}
+
+/* gives the stream a window, taking the least recently used one */
+static struct file_ra_buf * readahead_alloc(struct filestr_desc *file)
+{
+    struct file_ra_buf *rab = &file_ra_bufs[0];
+
+    for (int i = 0; i < FILE_RA_BUFS; i++)
+    {
+        struct file_ra_buf *r = &file_ra_bufs[i];
+        if (!r->owner)
+        {
+            rab = r;
+            break;
+        }
+
+        if (r->lastuse < rab->lastuse)
+            rab = r;
+    }
+
+    rab->owner = file;
+    rab->count = 0;
+    return rab;
+}
+
+/* drop the window of a stream */
+static void readahead_release(struct filestr_desc *file)
+{
+    mutex_lock(&file_ra_mutex);
+
+    struct file_ra_buf *rab = readahead_find(file);
+    if (rab)
+        rab->owner = NULL;
+
+    mutex_unlock(&file_ra_mutex);
+}
+
+/* drop the windows of all streams of the file; its data is changing */
+static void readahead_invalidate(struct filestr_desc *file)
+{
+    mutex_lock(&file_ra_mutex);
+
+    for (int i = 0; i < FILE_RA_BUFS; i++)
+    {
+        struct filestr_desc *owner = file_ra_bufs[i].owner;
+        if (owner && owner->sizep == file->sizep)
+            file_ra_bufs[i].owner = NULL;
+    }
+
+    mutex_unlock(&file_ra_mutex);
+}
+
+/* serve a read from the stream's window, refilling it while the access is
+   sequential; returns the number of bytes copied, which may be less than
+   requested (or none) for the regular path to complete */
+static ssize_t readahead_read(struct filestr_desc *file, void *buf,
+                              size_t nbyte, unsigned long filesectors)
+{
+    /* with writers present the shared sector cache may be dirty */
+    if (file->stream.cachep != &file->stream.cache)
+    {
+        readahead_release(file);
+        file->ra_window = 0;
+        return 0;
+    }
+
+    ssize_t rc = 0;
+    file_size_t offset = file->offset;
+    size_t done = 0;
+
+    mutex_lock(&file_ra_mutex);
+
+    struct file_ra_buf *rab = readahead_find(file);
+
+    while (done < nbyte)
+    {
+        unsigned long sector = offset / SECTOR_SIZE;
+
+        if (!rab || sector - rab->sector >= rab->count)
+        {
+            if (done == 0 && offset != file->ra_next)
+            {
+                /* not sequential: back to single sector caching */
+                if (rab)
+                    rab->owner = NULL;
+
+                file->ra_window = 0;
+                break;
+            }
+
+            /* large transfers go straight into the caller's buffer */
+            if (nbyte - done >= FILE_RA_MAX_SECTORS*SECTOR_SIZE / 2)
+                break;
+
+            /* grow the window each time it was used up sequentially */
+            if (!file->ra_window)
+                file->ra_window = FILE_RA_MIN_SECTORS;
+            else if (rab && file->ra_window < FILE_RA_MAX_SECTORS)
+                file->ra_window *= 2;
+
+            if (!rab)
+                rab = readahead_alloc(file);
+
+            unsigned long count = MIN(file->ra_window, filesectors - sector);
+
+            if (fat_query_sectornum(&file->stream.fatstr) != sector)
+            {
+                rc = fat_seek(&file->stream.fatstr, sector);
+                if (rc < 0)
+                {
+                    rc = rc * 10 - 1;
+                    rab->owner = NULL;
+                    break;
+                }
+            }
+
+            file_stats.transfers++;
+            rc = fat_readwrite(&file->stream.fatstr, count, rab->data, false);
+            if (rc <= 0)
+            {
+                if (rc < 0)
+                    rc = rc * 10 - 2;
+
+                rab->owner = NULL;
+                break;
+            }
+
+            rab->sector = sector;
+            rab->count = rc;
+            file_stats.ra_fills++;
+            file_stats.ra_sectors += rc;
+            rc = 0;
+        }
+        else if (done == 0)
+        {
+            file_stats.ra_hits++;
+        }
+
+        unsigned long bufoffs = offset - (file_size_t)rab->sector*SECTOR_SIZE;
+        size_t len = MIN(nbyte - done, rab->count*SECTOR_SIZE - bufoffs);
+
+        memcpy(buf + done, rab->data + bufoffs, len);
+        rab->lastuse = ++file_ra_clock;
+        done += len;
+        offset += len;
+    }
+
+    mutex_unlock(&file_ra_mutex);
+
+    if (rc < 0)
+    {
+        errno = EIO;
+        return rc;
+    }
+
+    return done;
+}
+
+/* one-time init at startup */
+void file_readahead_init(void)
+{
+    mutex_init(&file_ra_mutex);
+}
+
+void file_get_io_stats(struct file_io_stats *stats, bool reset)
+{
+    mutex_lock(&file_ra_mutex);
+
+    *stats = file_stats;
+
+    if (reset)
+        memset(&file_stats, 0, sizeof (file_stats));
+
+    mutex_unlock(&file_ra_mutex);
+}
+#endif /* FILE_READAHEAD */
+
 /* find a free file descriptor */
 static int alloc_filestr(struct filestr_desc **filep)
 {
@@ -93,6 +301,12 @@ static int alloc_filestr(struct filestr_desc **filep)
         struct filestr_desc *file = &open_streams[fildes];
         if (!file->stream.flags)
         {
+        #ifdef FILE_READAHEAD
+            /* a window left by a forced close must not be inherited */
+            readahead_release(file);
+            file->ra_next = 0;
+            file->ra_window = 0;
+        #endif
             *filep = file;
             return fildes;
         }
@@ -201,6 +415,10 @@ static void handle_truncate(struct filestr_desc * const file, file_size_t size)
 {
     unsigned long filesectors = filesize_sectors(size);
 
+#ifdef FILE_READAHEAD
+    readahead_invalidate(file);
+#endif
+
     struct filestr_base *s = NULL;
     while ((s = fileobj_get_next_stream(&file->stream, s)))
     {
@@ -349,6 +567,9 @@ static int close_internal(struct filestr_desc *file)
 
     rc = 0;
 file_error:;
+#ifdef FILE_READAHEAD
+    readahead_release(file);
+#endif
     int rc2 = close_stream_internal(&file->stream);
     if (rc2 < 0 && rc >= 0)
         rc = rc2 * 10 - 2;
@@ -545,6 +766,9 @@ static int readwrite_fill_cache(struct filestr_desc *file, unsigned long sector,
     {
         /* only reading or this sector would have been flushed if the cache
            was previously needed for a different sector */
+    #ifdef FILE_READAHEAD
+        file_stats.transfers++;
+    #endif
         rc = fat_readwrite(&file->stream.fatstr, 1, cachep->buffer, false);
         if (rc < 0)
             FILE_ERROR(rc == FAT_RC_ENOSPC ? ENOSPC : EIO, rc * 10 - 3);
@@ -651,11 +875,28 @@ static ssize_t readwrite(struct filestr_desc *file, void *buf, size_t nbyte,
     void * const bufstart = buf;
 
     const unsigned long filesectors = filesize_sectors(size);
-    unsigned long sector = file->offset / SECTOR_SIZE;
-    unsigned long sectoroffs = file->offset % SECTOR_SIZE;
+
+#ifdef FILE_READAHEAD
+    if (write)
+    {
+        readahead_invalidate(file);
+    }
+    else
+    {
+        rc = readahead_read(file, buf, nbyte, filesectors);
+        if (rc < 0)
+            FILE_ERROR(ERRNO, rc * 10 - 8);
+
+        buf += rc;
+        nbyte -= rc;
+    }
+#endif /* FILE_READAHEAD */
+
+    unsigned long sector = (file->offset + (buf - bufstart)) / SECTOR_SIZE;
+    unsigned long sectoroffs = (file->offset + (buf - bufstart)) % SECTOR_SIZE;
 
     /* any head bytes? */
-    if (sectoroffs)
+    if (sectoroffs && nbyte)
     {
         size_t headbytes = MIN(nbyte, SECTOR_SIZE - sectoroffs);
         rc = readwrite_partial(file, cachep, sector, sectoroffs, buf, headbytes,
@@ -718,6 +959,10 @@ static ssize_t readwrite(struct filestr_desc *file, void *buf, size_t nbyte,
                 }
             }
 
+        #ifdef FILE_READAHEAD
+            if (!write)
+                file_stats.transfers++;
+        #endif
             rc = fat_readwrite(&file->stream.fatstr, runlen, buf, write);
             if (rc < 0)
             {
@@ -783,6 +1028,10 @@ file_error:;
         /* adjust file size to length written */
         if (write && file->offset > size)
             *file->sizep = file->offset;
+    #ifdef FILE_READAHEAD
+        if (!write)
+            file->ra_next = file->offset;
+    #endif
 
         if (rc > 0)
             return done;
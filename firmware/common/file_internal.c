@@ -454,13 +454,19 @@ static NO_INLINE int open_path_component(struct pathwalk *walkp,
     fat_filestr_init(&stream->fatstr, &parentp->info.fatfile);
     rewinddir_internal(&compp->info);
 
-    while ((rc = readdir_internal(stream, &compp->info, &dir_fatent)) > 0)
+    /* an index may know the answer without reading the whole directory */
+    rc = lookup_internal(stream, compname, &compp->info, &dir_fatent);
+
+    if (rc < 0)
     {
-        if (rc > 1 && !(callflags & FF_NOISO))
-            iso_decode_d_name(dir_fatent.name);
+        while ((rc = readdir_internal(stream, &compp->info, &dir_fatent)) > 0)
+        {
+            if (rc > 1 && !(callflags & FF_NOISO))
+                iso_decode_d_name(dir_fatent.name);
 
-        if (!strcasecmp(compname, dir_fatent.name))
-            break;
+            if (!strcasecmp(compname, dir_fatent.name))
+                break;
+        }
     }
 
     if (rc == 0)
@@ -761,4 +767,7 @@ void filesystem_init(void)
     mrsw_init(&file_internal_mrsw);
     dc_init();
     fileobj_mgr_init();
+#ifdef FILE_READAHEAD
+    file_readahead_init();
+#endif
 }
@@ -35,6 +35,7 @@
 #include "rbunicode.h"
 #include "debug.h"
 #include "panic.h"
+#include "crc32.h"
 /*#define LOGF_ENABLE*/
 #include "logf.h"
 
@@ -184,6 +185,19 @@ struct fsinfo
 
 #define FSINFO_SIGNATURE_VAL 0x41615252
 
+#ifndef BOOTLOADER
+/* Free space summary: one bit per group of FAT sectors, cleared once the
+ * group is known to hold no free entries so that allocation skips full
+ * stretches of the FAT without reading them */
+#define FAT_FREEMAP_BITS    8192
+/* Clusters for new chains, and for chains whose next cluster is taken, are
+ * taken from the start of a free run of at least FAT_ALLOC_RUN clusters if
+ * one is found within FAT_ALLOC_SCAN FAT sectors, keeping files contiguous
+ * even when several are written at the same time */
+#define FAT_ALLOC_RUN       16
+#define FAT_ALLOC_SCAN      32
+#endif /* BOOTLOADER */
+
 #ifdef HAVE_FAT16SUPPORT
 #define BPB_FN_SET16(bpb, fn)      (bpb)->fn##__ = fn##16
 #define BPB_FN_SET32(bpb, fn)      (bpb)->fn##__ = fn##32
@@ -238,6 +252,11 @@ static struct bpb
     unsigned long fatrgnstart;
     unsigned long fatrgnend;
     struct fsinfo fsinfo;
+#ifdef FAT_FREEMAP_BITS
+    unsigned long freemap_spg;      /* FAT sectors per freemap bit */
+    uint32_t freemap[FAT_FREEMAP_BITS / 32]; /* set: group may have free
+                                                entries */
+#endif
 #ifdef HAVE_FAT16SUPPORT
     unsigned int bpb_rootentcnt;    /* Number of dir entries in the root */
     /* internals for FAT16 support */
@@ -293,6 +312,93 @@ static uint8_t fat_bounce_buffers[NUM_VOLUMES][SECTOR_SIZE*FAT_BOUNCE_SECTORS] S
         }                                            \
         _bpb; })
 
+#ifndef BOOTLOADER
+/* Extent maps of recently seeked files: runs of contiguous clusters, so
+ * that seeks find their cluster in O(log extents) instead of walking the
+ * FAT chain from the start of the file. Any FAT update on a volume drops
+ * its maps, they are rebuilt on the next long seek. The maps are shared by
+ * all streams and are only touched with the disk cache locked, which also
+ * covers the FAT reads of a build. */
+#define FAT_EXTMAP_COUNT    4   /* number of files with a map */
+#define FAT_EXTMAP_EXTENTS  128 /* runs per map; longer files are mapped in part */
+#define FAT_EXTMAP_MIN_WALK 8   /* shorter chain walks don't build a map */
+
+struct fat_extent
+{
+    long clusternum; /* index of the first cluster of the run in the file */
+    long cluster;    /* first cluster of the run on the volume */
+};
+
+static struct fat_extmap
+{
+    struct bpb   *fat_bpb;     /* volume of the file; NULL if unused */
+    long         firstcluster; /* first cluster of the file */
+    long         numclusters;  /* number of file clusters covered */
+    int          count;        /* number of runs in ext */
+    unsigned int lastuse;      /* for replacing the least recently used */
+    struct fat_extent ext[FAT_EXTMAP_EXTENTS];
+} fat_extmaps[FAT_EXTMAP_COUNT];
+
+static unsigned int fat_extmap_clock;
+
+static void extmap_invalidate(struct bpb *fat_bpb)
+{
+    for (int i = 0; i < FAT_EXTMAP_COUNT; i++)
+    {
+        if (fat_extmaps[i].fat_bpb == fat_bpb)
+            fat_extmaps[i].fat_bpb = NULL;
+    }
+}
+
+/* marks all of the FAT as possibly having free entries, or none of it */
+static void freemap_reset(struct bpb *fat_bpb, bool maybefree)
+{
+    fat_bpb->freemap_spg =
+        (fat_bpb->fatsize + FAT_FREEMAP_BITS - 1) / FAT_FREEMAP_BITS;
+    if (fat_bpb->freemap_spg == 0)
+        fat_bpb->freemap_spg = 1;
+
+    memset(fat_bpb->freemap, maybefree ? 0xff : 0x00,
+           sizeof (fat_bpb->freemap));
+}
+
+static inline bool freemap_test(const struct bpb *fat_bpb,
+                                unsigned long fatsec)
+{
+    unsigned long g = fatsec / fat_bpb->freemap_spg;
+    return fat_bpb->freemap[g / 32] & BIT_N(g % 32);
+}
+
+static inline void freemap_mark(struct bpb *fat_bpb, unsigned long fatsec,
+                                bool maybefree)
+{
+    unsigned long g = fatsec / fat_bpb->freemap_spg;
+
+    if (maybefree)
+        fat_bpb->freemap[g / 32] |= BIT_N(g % 32);
+    else
+        fat_bpb->freemap[g / 32] &= ~BIT_N(g % 32);
+}
+
+/* called by free cluster scans for every FAT sector found to be full;
+   *run counts those since the start of the group (-1 if the scan didn't
+   start at the beginning of it) and clears the bit once it covers it all */
+static void freemap_sector_full(struct bpb *fat_bpb, unsigned long fatsec,
+                                long *run)
+{
+    unsigned long first = fatsec - fatsec % fat_bpb->freemap_spg;
+    unsigned long end = MIN(first + fat_bpb->freemap_spg, fat_bpb->fatsize);
+
+    if (fatsec == first)
+        *run = 0;
+    else if (*run < 0)
+        return;
+
+    if ((unsigned long)++*run == end - first)
+        freemap_mark(fat_bpb, fatsec, false);
+}
+#endif /* BOOTLOADER */
+
 enum add_dir_entry_flags
 {
     DIRENT_RETURN      = 0x01, /* return the new short entry */
@@ -310,8 +416,13 @@ struct fatlong_parse_state
     uint8_t chksum;
 };
 
+/* bumped whenever changes are committed; stale bulk directory windows are
+   discarded when this no longer matches */
+static unsigned int fat_dir_gen;
+
 static void cache_commit(struct bpb *fat_bpb)
 {
+    fat_dir_gen++;
     dc_lock_cache();
 #ifdef HAVE_FAT16SUPPORT
     if (!fat_bpb->is_fat16)
@@ -361,28 +472,52 @@ static void * cache_sector_buffer(IF_MV(struct bpb *fat_bpb,)
 }
 
 /* flush a cache buffer to storage */
-void dc_writeback_callback(IF_MV(int volume,) unsigned long sector, void *buf)
+void dc_writeback_callback(IF_MV(int volume,) unsigned long sector,
+                           unsigned int count, void *buf)
 {
     struct bpb * const fat_bpb = &fat_bpbs[IF_MV_VOL(volume)];
-    unsigned int copies = !IS_FAT_SECTOR(fat_bpb, sector) ?
-                                1 : fat_bpb->bpb_numfats;
 
-    sector += fat_bpb->startsector;
-
-    while (1)
+    while (count)
     {
-        int rc = storage_write_sectors(IF_MD(fat_bpb->drive,) sector, 1, buf);
-        if (rc < 0)
+        /* a run mustn't straddle the FAT region since only sectors of the
+           first FAT get mirrored */
+        unsigned int n = count;
+        unsigned int copies = 1;
+
+        if (IS_FAT_SECTOR(fat_bpb, sector))
         {
-            panicf("%s() - Could not write sector %ld"
-                   " (error %d)\n", __func__, sector, rc);
+            copies = fat_bpb->bpb_numfats;
+            if (sector + n > fat_bpb->fatrgnend)
+                n = fat_bpb->fatrgnend - sector;
+        }
+        else if (sector < fat_bpb->fatrgnstart &&
+                 sector + n > fat_bpb->fatrgnstart)
+        {
+            n = fat_bpb->fatrgnstart - sector;
         }
 
-        if (--copies == 0)
-            break;
+        unsigned long dsector = sector + fat_bpb->startsector;
 
-        /* Update next FAT */
-        sector += fat_bpb->fatsize;
+        while (1)
+        {
+            int rc = storage_write_sectors(IF_MD(fat_bpb->drive,) dsector, n,
+                                           buf);
+            if (rc < 0)
+            {
+                panicf("%s() - Could not write sector %ld"
+                       " (error %d)\n", __func__, dsector, rc);
+            }
+
+            if (--copies == 0)
+                break;
+
+            /* Update next FAT */
+            dsector += fat_bpb->fatsize;
+        }
+
+        sector += n;
+        buf += n*SECTOR_SIZE;
+        count -= n;
     }
 }
 
@@ -849,10 +984,20 @@ static long find_free_cluster16(struct bpb *fat_bpb, long startcluster)
     unsigned long entry = startcluster;
     unsigned long sector = entry / CLUSTERS_PER_FAT16_SECTOR;
     unsigned long offset = entry % CLUSTERS_PER_FAT16_SECTOR;
+#ifdef FAT_FREEMAP_BITS
+    long fullrun = -1;
+#endif
 
     for (unsigned long i = 0; i < fat_bpb->fatsize; i++)
     {
         unsigned long nr = (i + sector) % fat_bpb->fatsize;
+    #ifdef FAT_FREEMAP_BITS
+        if (!freemap_test(fat_bpb, nr))
+        {
+            offset = 0;
+            continue;
+        }
+    #endif
         uint16_t *sec = cache_sector(fat_bpb, nr + fat_bpb->fatrgnstart);
         if (!sec)
             break;
@@ -876,6 +1021,9 @@ static long find_free_cluster16(struct bpb *fat_bpb, long startcluster)
             }
         }
 
+    #ifdef FAT_FREEMAP_BITS
+        freemap_sector_full(fat_bpb, nr, &fullrun);
+    #endif
         offset = 0;
     }
 
@@ -901,6 +1049,10 @@ static int update_fat_entry16(struct bpb *fat_bpb, unsigned long entry,
 
     dc_lock_cache();
 
+#ifdef FAT_EXTMAP_COUNT
+    extmap_invalidate(fat_bpb);
+#endif
+
     int16_t *sec = cache_sector(fat_bpb, sector + fat_bpb->fatrgnstart);
     if (!sec)
     {
@@ -922,6 +1074,9 @@ static int update_fat_entry16(struct bpb *fat_bpb, unsigned long entry,
         /* being freed */
         if (curval != 0x0000)
             fat_bpb->fsinfo.freecount++;
+    #ifdef FAT_FREEMAP_BITS
+        freemap_mark(fat_bpb, sector, true);
+    #endif
     }
 
     DEBUGF("%lu free clusters\n", (unsigned long)fat_bpb->fsinfo.freecount);
@@ -937,11 +1092,20 @@ static void fat_recalc_free_internal16(struct bpb *fat_bpb)
 {
     unsigned long free = 0;
 
+#ifdef FAT_FREEMAP_BITS
+    freemap_reset(fat_bpb, false);
+#endif
+
     for (unsigned long i = 0; i < fat_bpb->fatsize; i++)
     {
         uint16_t *sec = cache_sector(fat_bpb, i + fat_bpb->fatrgnstart);
         if (!sec)
+        {
+        #ifdef FAT_FREEMAP_BITS
+            freemap_reset(fat_bpb, true);
+        #endif
             break;
+        }
 
         for (unsigned long j = 0; j < CLUSTERS_PER_FAT16_SECTOR; j++)
         {
@@ -954,6 +1118,9 @@ static void fat_recalc_free_internal16(struct bpb *fat_bpb)
                 continue;
 
             free++;
+        #ifdef FAT_FREEMAP_BITS
+            freemap_mark(fat_bpb, i, true);
+        #endif
             if (fat_bpb->fsinfo.nextfree == 0xffffffff)
                 fat_bpb->fsinfo.nextfree = c;
         }
@@ -1008,10 +1175,20 @@ static long find_free_cluster32(struct bpb *fat_bpb, long startcluster)
     unsigned long entry = startcluster;
     unsigned long sector = entry / CLUSTERS_PER_FAT_SECTOR;
     unsigned long offset = entry % CLUSTERS_PER_FAT_SECTOR;
+#ifdef FAT_FREEMAP_BITS
+    long fullrun = -1;
+#endif
 
     for (unsigned long i = 0; i < fat_bpb->fatsize; i++)
     {
         unsigned long nr = (i + sector) % fat_bpb->fatsize;
+    #ifdef FAT_FREEMAP_BITS
+        if (!freemap_test(fat_bpb, nr))
+        {
+            offset = 0;
+            continue;
+        }
+    #endif
         uint32_t *sec = cache_sector(fat_bpb, nr + fat_bpb->fatrgnstart);
         if (!sec)
             break;
@@ -1035,6 +1212,9 @@ static long find_free_cluster32(struct bpb *fat_bpb, long startcluster)
             }
         }
 
+    #ifdef FAT_FREEMAP_BITS
+        freemap_sector_full(fat_bpb, nr, &fullrun);
+    #endif
         offset = 0;
     }
 
@@ -1058,6 +1238,10 @@ static int update_fat_entry32(struct bpb *fat_bpb, unsigned long entry,
 
     dc_lock_cache();
 
+#ifdef FAT_EXTMAP_COUNT
+    extmap_invalidate(fat_bpb);
+#endif
+
     uint32_t *sec = cache_sector(fat_bpb, sector + fat_bpb->fatrgnstart);
     if (!sec)
     {
@@ -1079,6 +1263,9 @@ static int update_fat_entry32(struct bpb *fat_bpb, unsigned long entry,
         /* being freed */
         if (curval & 0x0fffffff)
             fat_bpb->fsinfo.freecount++;
+    #ifdef FAT_FREEMAP_BITS
+        freemap_mark(fat_bpb, sector, true);
+    #endif
     }
 
     DEBUGF("%lu free clusters\n", (unsigned long)fat_bpb->fsinfo.freecount);
@@ -1095,11 +1282,20 @@ static void fat_recalc_free_internal32(struct bpb *fat_bpb)
 {
     unsigned long free = 0;
 
+#ifdef FAT_FREEMAP_BITS
+    freemap_reset(fat_bpb, false);
+#endif
+
     for (unsigned long i = 0; i < fat_bpb->fatsize; i++)
     {
         uint32_t *sec = cache_sector(fat_bpb, i + fat_bpb->fatrgnstart);
         if (!sec)
+        {
+        #ifdef FAT_FREEMAP_BITS
+            freemap_reset(fat_bpb, true);
+        #endif
             break;
+        }
 
         for (unsigned long j = 0; j < CLUSTERS_PER_FAT_SECTOR; j++)
         {
@@ -1112,6 +1308,9 @@ static void fat_recalc_free_internal32(struct bpb *fat_bpb)
                 continue;
 
             free++;
+        #ifdef FAT_FREEMAP_BITS
+            freemap_mark(fat_bpb, i, true);
+        #endif
             if (fat_bpb->fsinfo.nextfree == 0xffffffff)
                 fat_bpb->fsinfo.nextfree = c;
         }
@@ -1338,6 +1537,84 @@ static union raw_dirent * cache_direntry(struct bpb *fat_bpb,
     return ent;
 }
 
+#ifdef FAT_ALLOC_RUN
+/* returns a free cluster for a chain: startcluster itself if it is free
+   and the chain is appended to, otherwise the start of a run of
+   FAT_ALLOC_RUN free clusters or, failing that, the first free cluster */
+static long find_free_run(struct bpb *fat_bpb, long startcluster, bool append)
+{
+#ifdef HAVE_FAT16SUPPORT
+    unsigned long perfatsec = fat_bpb->is_fat16 ?
+        CLUSTERS_PER_FAT16_SECTOR : CLUSTERS_PER_FAT_SECTOR;
+#else
+    unsigned long perfatsec = CLUSTERS_PER_FAT_SECTOR;
+#endif
+    unsigned long entry = startcluster;
+    unsigned long sector = entry / perfatsec;
+    unsigned long offset = entry % perfatsec;
+    unsigned long runstart = 0, runlen = 0;
+
+    if (sector >= fat_bpb->fatsize)
+        sector = offset = 0; /* no hint */
+
+    /* runs don't wrap around the end of the FAT */
+    for (unsigned long nr = sector;
+         nr < fat_bpb->fatsize && nr - sector < FAT_ALLOC_SCAN; nr++)
+    {
+        if (!freemap_test(fat_bpb, nr))
+        {
+            append = false;
+            runlen = offset = 0;
+            continue;
+        }
+
+        void *sec = cache_sector(fat_bpb, nr + fat_bpb->fatrgnstart);
+        if (!sec)
+            break;
+
+        for (unsigned long k = offset; k < perfatsec; k++)
+        {
+            unsigned long c = nr * perfatsec + k;
+            bool free = c >= 2 && c <= fat_bpb->dataclusters + 1;
+
+            if (free)
+            {
+            #ifdef HAVE_FAT16SUPPORT
+                if (fat_bpb->is_fat16)
+                    free = letoh16(((uint16_t *)sec)[k]) == 0x0000;
+                else
+            #endif
+                    free = !(letoh32(((uint32_t *)sec)[k]) & 0x0fffffff);
+            }
+
+            if (free && append)
+                return c; /* chain stays contiguous */
+
+            append = false;
+
+            if (!free)
+            {
+                runlen = 0;
+                continue;
+            }
+
+            if (runlen++ == 0)
+                runstart = c;
+
+            if (runlen >= FAT_ALLOC_RUN)
+            {
+                DEBUGF("%s(%lx) == %lx\n", __func__, startcluster, runstart);
+                return runstart;
+            }
+        }
+
+        offset = 0;
+    }
+
+    return find_free_cluster(fat_bpb, startcluster);
+}
+#endif /* FAT_ALLOC_RUN */
+
 static long next_write_cluster(struct bpb *fat_bpb, long oldcluster)
 {
     DEBUGF("%s(old:%lx)\n", __func__, oldcluster);
@@ -1362,7 +1639,11 @@ static long next_write_cluster(struct bpb *fat_bpb, long oldcluster)
         long findstart = oldcluster > 0 ?
             oldcluster + 1 : (long)fat_bpb->fsinfo.nextfree;
 
+    #ifdef FAT_ALLOC_RUN
+        cluster = find_free_run(fat_bpb, findstart, oldcluster > 0);
+    #else
         cluster = find_free_cluster(fat_bpb, findstart);
+    #endif
 
         if (cluster)
         {
@@ -2318,6 +2599,97 @@ fat_error:
 
 /** File stream functions **/
 
+#ifdef FAT_EXTMAP_COUNT
+static struct fat_extmap * extmap_find(struct bpb *fat_bpb, long firstcluster)
+{
+    for (int i = 0; i < FAT_EXTMAP_COUNT; i++)
+    {
+        struct fat_extmap *map = &fat_extmaps[i];
+        if (map->fat_bpb == fat_bpb && map->firstcluster == firstcluster)
+        {
+            map->lastuse = ++fat_extmap_clock;
+            return map;
+        }
+    }
+
+    return NULL;
+}
+
+/* walk the cluster chain of a file once and record its runs */
+static struct fat_extmap * extmap_build(struct bpb *fat_bpb, long firstcluster)
+{
+    struct fat_extmap *map = &fat_extmaps[0];
+
+    for (int i = 1; i < FAT_EXTMAP_COUNT && map->fat_bpb; i++)
+    {
+        if (!fat_extmaps[i].fat_bpb ||
+            (int)(fat_extmaps[i].lastuse - map->lastuse) < 0)
+            map = &fat_extmaps[i];
+    }
+
+    map->fat_bpb           = NULL;
+    map->count             = 1;
+    map->ext[0].clusternum = 0;
+    map->ext[0].cluster    = firstcluster;
+
+    long cluster    = firstcluster;
+    long clusternum = 0;
+
+    while (1)
+    {
+        long next = get_next_cluster(fat_bpb, cluster);
+        if (next < 0)
+            return NULL;
+
+        clusternum++;
+
+        if (!next)
+            break; /* end of chain */
+
+        if (next != cluster + 1)
+        {
+            if (map->count >= FAT_EXTMAP_EXTENTS)
+                break; /* map the file in part */
+
+            map->ext[map->count].clusternum = clusternum;
+            map->ext[map->count].cluster    = next;
+            map->count++;
+        }
+
+        cluster = next;
+    }
+
+    DEBUGF("%s(%lx): %d runs, %ld clusters\n", __func__, firstcluster,
+           map->count, clusternum);
+
+    map->fat_bpb      = fat_bpb;
+    map->firstcluster = firstcluster;
+    map->numclusters  = clusternum;
+    map->lastuse      = ++fat_extmap_clock;
+    return map;
+}
+
+/* return the volume cluster of file cluster clusternum, or 0 if it isn't
+   covered by the map */
+static long extmap_lookup(const struct fat_extmap *map, long clusternum)
+{
+    if (clusternum < 0 || clusternum >= map->numclusters)
+        return 0;
+
+    int lo = 0, hi = map->count - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (map->ext[mid].clusternum <= clusternum)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return map->ext[lo].cluster + (clusternum - map->ext[lo].clusternum);
+}
+#endif /* FAT_EXTMAP_COUNT */
+
 int fat_closewrite(struct fat_filestr *filestr, uint32_t size,
                    struct fat_direntry *fatentp)
 {
@@ -2541,8 +2913,27 @@ long fat_readwrite(struct fat_filestr *filestr, unsigned long sectorcount,
         if (++sectornum >= fat_bpb->bpb_secperclus)
         {
             /* out of sectors in this cluster; get the next cluster */
-            long newcluster = write ? next_write_cluster(fat_bpb, cluster) :
-                                      get_next_cluster(fat_bpb, cluster);
+            long newcluster = 0;
+            if (write)
+            {
+                newcluster = next_write_cluster(fat_bpb, cluster);
+            }
+            else
+            {
+            #ifdef FAT_EXTMAP_COUNT
+                if (file->firstcluster > 0)
+                {
+                    dc_lock_cache();
+                    struct fat_extmap *map =
+                        extmap_find(fat_bpb, file->firstcluster);
+                    if (map)
+                        newcluster = extmap_lookup(map, clusternum + 1);
+                    dc_unlock_cache();
+                }
+                if (!newcluster)
+            #endif /* FAT_EXTMAP_COUNT */
+                    newcluster = get_next_cluster(fat_bpb, cluster);
+            }
             if (newcluster)
             {
                 cluster = newcluster;
@@ -2667,6 +3058,27 @@ int fat_seek(struct fat_filestr *filestr, unsigned long seeksector)
             numclusters -= filestr->clusternum;
         }
 
+    #ifdef FAT_EXTMAP_COUNT
+        if (numclusters >= FAT_EXTMAP_MIN_WALK && file->firstcluster > 0)
+        {
+            /* long walk; start from as close as the extent map gets */
+            dc_lock_cache();
+
+            struct fat_extmap *map = extmap_find(fat_bpb, file->firstcluster);
+            if (!map)
+                map = extmap_build(fat_bpb, file->firstcluster);
+
+            long mapped = map ? MIN(clusternum, map->numclusters - 1) : -1;
+            if (mapped > clusternum - numclusters)
+            {
+                cluster = extmap_lookup(map, mapped);
+                numclusters = clusternum - mapped;
+            }
+
+            dc_unlock_cache();
+        }
+    #endif /* FAT_EXTMAP_COUNT */
+
         for (long i = 0; i < numclusters; i++)
         {
             cluster = get_next_cluster(fat_bpb, cluster);
@@ -2731,8 +3143,67 @@ fat_error:
 
 /** Directory stream functions **/
 
-int fat_readdir(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
-                struct filestr_cache *cachep, struct fat_direntry *entry)
+/* get a directory sector by way of the bulk window, refilling the window
+   from that sector onward if it isn't held */
+static int dirbulk_read(struct fat_filestr *dirstr, struct fat_dirbulk *bulk,
+                        unsigned long sector, void *buf)
+{
+    if (bulk->gen != fat_dir_gen)
+        bulk->count = 0;
+
+    if (!bulk->count || sector < bulk->sector ||
+        sector >= bulk->sector + bulk->count)
+    {
+        /* the stream is left positioned after the window */
+        if (!bulk->count || sector != bulk->sector + bulk->count)
+        {
+            int rc = fat_seek(dirstr, sector);
+            if (rc < 0)
+                return rc * 10 - 1;
+        }
+
+        bulk->count = 0;
+
+        long rc = fat_readwrite(dirstr, bulk->max, bulk->buf, false);
+        if (rc <= 0)
+            return rc < 0 ? rc * 10 - 2 : 0;
+
+        bulk->sector = sector;
+        bulk->count  = rc;
+        bulk->gen    = fat_dir_gen;
+        bulk->reads++;
+        bulk->sectors += rc;
+    }
+
+    memcpy(buf, bulk->buf + (sector - bulk->sector)*SECTOR_SIZE, SECTOR_SIZE);
+    return 1;
+}
+
+/* directory checksums cover the entries in use up to the end marker, less
+   those of the file given to fat_dirbulk_skip(); a file kept in the directory
+   it describes would otherwise always leave the checksum behind */
+static uint32_t dirbulk_crc_entry(const struct fat_dirbulk *bulk,
+                                  const union raw_dirent *ent, uint32_t crc)
+{
+    if (ent->name[0] == 0xe5)
+        return crc; /* free entry */
+
+    if (bulk->crcskip[0])
+    {
+        if (IS_LDIR_ATTR(ent->ldir_attr) ?
+                ent->ldir_chksum == bulk->crcskipsum :
+                !memcmp(ent->name, bulk->crcskip, sizeof (ent->name)))
+            return crc;
+    }
+
+    return crc_32(ent, sizeof (*ent), crc);
+}
+
+static int readdir_common(struct fat_filestr *dirstr,
+                          struct fat_dirscan_info *scan,
+                          struct filestr_cache *cachep,
+                          struct fat_dirbulk *bulk,
+                          struct fat_direntry *entry)
 {
     int rc = 0;
 
@@ -2755,7 +3226,21 @@ int fat_readdir(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
         }
 
         unsigned long sector = direntry / DIR_ENTRIES_PER_SECTOR;
-        if (cachep->sector != sector)
+        if (bulk && cachep->sector != sector)
+        {
+            int rc2 = dirbulk_read(dirstr, bulk, sector, cachep->buffer);
+            if (rc2 <= 0)
+            {
+                if (rc2 == 0)
+                    break; /* eof */
+
+                DEBUGF("%s() - Couldn't read dir (err %d)\n", __func__, rc2);
+                FAT_ERROR(rc2 * 10 - 3);
+            }
+
+            cachep->sector = sector;
+        }
+        else if (cachep->sector != sector)
         {
             if (cachep->sector + 1 != sector)
             {
@@ -2781,6 +3266,25 @@ int fat_readdir(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
         unsigned int index = direntry % DIR_ENTRIES_PER_SECTOR;
         union raw_dirent *ent = &((union raw_dirent *)cachep->buffer)[index];
 
+        if (bulk)
+        {
+            /* checksum the entries in order as fat_dir_checksum() would */
+            if (direntry == 0)
+            {
+                bulk->crc     = 0xffffffff;
+                bulk->crcnext = 0;
+                bulk->crcgen  = fat_dir_gen;
+            }
+
+            if (direntry == bulk->crcnext)
+            {
+                if (ent->name[0] != 0)
+                    bulk->crc = dirbulk_crc_entry(bulk, ent, bulk->crc);
+
+                bulk->crcnext++;
+            }
+        }
+
         if (ent->name[0] == 0)
             break;    /* last entry */
 
@@ -2820,6 +3324,10 @@ int fat_readdir(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
 
                 dc_unlock_cache();
 
+                /* the stream moved; don't assume where it is */
+                if (bulk)
+                    bulk->count = 0;
+
                 /* retry it once from the new position */
                 scan->entries = 0;
                 continue;
@@ -2856,6 +3364,104 @@ fat_error:
     return rc;
 }
 
+int fat_readdir(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
+                struct filestr_cache *cachep, struct fat_direntry *entry)
+{
+    return readdir_common(dirstr, scan, cachep, NULL, entry);
+}
+
+int fat_readdir_bulk(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
+                     struct filestr_cache *cachep, struct fat_dirbulk *bulk,
+                     struct fat_direntry *entry)
+{
+    return readdir_common(dirstr, scan, cachep, bulk, entry);
+}
+
+int fat_dir_checksum(struct fat_filestr *dirstr, struct fat_dirbulk *bulk,
+                     uint32_t *crcp)
+{
+    /* CRC32 of the raw directory entries up to the end marker; cheaper than
+       parsing when asking "did it change?" */
+    int rc;
+    uint32_t crc = 0xffffffff;
+    unsigned long sectors = 0;
+
+    /* the window is reused as plain buffer space */
+    bulk->count = 0;
+
+    rc = fat_seek(dirstr, 0);
+    if (rc < 0)
+        FAT_ERROR(rc * 10 - 1);
+
+    while (1)
+    {
+        if (sectors >= MAX_DIRENTRIES / DIR_ENTRIES_PER_SECTOR)
+        {
+            DEBUGF("%s() - Dir is too large\n", __func__);
+            FAT_ERROR(-2);
+        }
+
+        long count = fat_readwrite(dirstr, bulk->max, bulk->buf, false);
+        if (count <= 0)
+        {
+            if (count == 0)
+                break; /* eof */
+
+            FAT_ERROR(count * 10 - 3);
+        }
+
+        bulk->reads++;
+        bulk->sectors += count;
+        sectors += count;
+
+        for (long i = 0; i < count; i++)
+        {
+            union raw_dirent *ent =
+                (union raw_dirent *)(bulk->buf + i*SECTOR_SIZE);
+
+            for (unsigned int e = 0; e < DIR_ENTRIES_PER_SECTOR; e++)
+            {
+                if (ent[e].name[0] == 0)
+                    goto done; /* last entry */
+
+                crc = dirbulk_crc_entry(bulk, &ent[e], crc);
+            }
+        }
+    }
+
+done:
+    *crcp = crc;
+    rc = 0;
+fat_error:
+    return rc;
+}
+
+bool fat_dirbulk_checksum(const struct fat_dirbulk *bulk, uint32_t *crcp)
+{
+    /* after fat_readdir_bulk() has read a directory from its start to its end,
+       this gives what fat_dir_checksum() would, unless a change was committed
+       meanwhile */
+    if (!bulk->crcnext || bulk->crcgen != fat_dir_gen)
+        return false;
+
+    *crcp = bulk->crc;
+    return true;
+}
+
+void fat_dirbulk_skip(struct fat_dirbulk *bulk, const char *name)
+{
+    /* leave the entries of the named file out of the checksums taken from now
+       on; NULL takes them all again */
+    bulk->crcskip[0] = 0;
+
+    if (name)
+    {
+        int n;
+        create_dos_name(bulk->crcskip, (const unsigned char *)name, &n);
+        bulk->crcskipsum = shortname_checksum(bulk->crcskip);
+    }
+}
+
 void fat_rewinddir(struct fat_dirscan_info *scan)
 {
     /* rewind the directory scan counter to the beginning */
@@ -2892,6 +3498,10 @@ int fat_mount(IF_MV(int volume,) IF_MD(int drive,) unsigned long startsector)
     if (rc < 0)
         FAT_ERROR(rc * 10 - 2);
 
+#ifdef FAT_FREEMAP_BITS
+    freemap_reset(fat_bpb, true);
+#endif
+
     /* it worked */
     fat_bpb->mounted = true;
 
@@ -2918,6 +3528,11 @@ int fat_unmount(IF_MV_NONVOID(int volume))
 
     /* free the entries for this volume */
     cache_discard(IF_MV(fat_bpb));
+#ifdef FAT_EXTMAP_COUNT
+    dc_lock_cache();
+    extmap_invalidate(fat_bpb);
+    dc_unlock_cache();
+#endif
     fat_bpb->mounted = false;
 
     return 0;
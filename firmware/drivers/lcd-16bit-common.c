@@ -46,6 +46,7 @@ void lcd_clear_viewport(void)
 
     dst = FBADDR(x, y);
     dst_end = FBADDR(x + width - 1 , y + height - 1);
+    lcd_damage_vp(vp, x, y, x + width - 1, y + height - 1);
 
     if (vp->drawmode & DRMODE_INVERSEVID)
     {
@@ -174,6 +175,11 @@ void lcd_fillrect(int x, int y, int width, int height)
         switch (fillopt)
         {
           case OPT_SET:
+#ifdef HAVE_LCD_SIMD
+            if (lcd_simd_enabled)
+                lcd_simd_fill(dst, bits, len);
+            else
+#endif
             memset16(dst, bits, len);
             break;
 
@@ -184,6 +190,13 @@ void lcd_fillrect(int x, int y, int width, int height)
 
           case OPT_NONE:  /* DRMODE_COMPLEMENT */
           {
+#ifdef HAVE_LCD_SIMD
+            if (lcd_simd_enabled)
+            {
+                lcd_simd_invert(dst, len);
+                break;
+            }
+#endif
             fb_data *start = dst;
             fb_data *end = start + len;
             do
@@ -430,7 +443,7 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(
     ALPHA_WORD_T alpha_data, *alpha_word;
     size_t alpha_offset = 0, alpha_pixels;
 #else
-    unsigned char alpha_data;
+    unsigned char alpha_data = 0;
     size_t alpha_pixels;
 #endif
 
@@ -559,6 +572,12 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(
     INIT_ALPHA();
     BLEND_INIT;
 
+#ifdef HAVE_LCD_SIMD
+    struct lcd_simd_blend simd;
+    bool use_simd = lcd_simd_enabled &&
+        lcd_simd_blend_init(&simd, drmode, vp->fg_pattern, vp->bg_pattern);
+#endif
+
     do
     {
         intptr_t bo, io;
@@ -568,6 +587,22 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(
 
         START_ALPHA();
 
+#ifdef HAVE_LCD_SIMD
+        if (use_simd)
+        {
+            unsigned char weights[LCD_SIMD_CHUNK * LCD_SIMD_ALPHA_STEP];
+            for (col = 0; col < width; col += LCD_SIMD_CHUNK)
+            {
+                int i, n = MIN(width - col, LCD_SIMD_CHUNK);
+                for (i = 0; i < n; i++)
+                    lcd_simd_put_alpha(&weights[i * LCD_SIMD_ALPHA_STEP],
+                                       READ_ALPHA());
+                lcd_simd_blend_span(&simd, dst + col, image + col,
+                                    lcd_backdrop_offset, weights, n);
+            }
+        }
+        else
+#endif
         switch (drmode)
         {
         case DRMODE_COMPLEMENT:
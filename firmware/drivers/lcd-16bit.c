@@ -54,6 +54,7 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(const fb_data* image,
                                       int width, int height,
                                       int stride_image, int stride_src);
 #endif /* !DISABLE_ALPHA_BITMAP */
+#include "lcd-simd.c"
 #include "lcd-color-common.c"
 #include "lcd-bitmap-common.c"
 #include "lcd-16bit-common.c"
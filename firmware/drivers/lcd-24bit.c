@@ -54,6 +54,7 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(const fb_data* image,
                                       int width, int height,
                                       int stride_image, int stride_src);
 #endif /* !DISABLE_ALPHA_BITMAP */
+#include "lcd-simd.c"
 #include "lcd-color-common.c"
 #include "lcd-bitmap-common.c"
 
@@ -76,6 +77,7 @@ void lcd_clear_viewport(void)
 
     dst = FBADDR(x, y);
     dst_end = FBADDR(x + width - 1 , y + height - 1);
+    lcd_damage_vp(vp, x, y, x + width - 1, y + height - 1);
 
     if (vp->drawmode & DRMODE_INVERSEVID)
     {
@@ -215,6 +217,13 @@ void lcd_fillrect(int x, int y, int width, int height)
         {
           case OPT_SET:
           {
+#ifdef HAVE_LCD_SIMD
+            if (lcd_simd_enabled)
+            {
+                lcd_simd_fill(dst, bits, len);
+                break;
+            }
+#endif
             fb_data *start = dst;
             fb_data *end = start + len;
             do {
@@ -230,6 +239,13 @@ void lcd_fillrect(int x, int y, int width, int height)
 
           case OPT_NONE:  /* DRMODE_COMPLEMENT */
           {
+#ifdef HAVE_LCD_SIMD
+            if (lcd_simd_enabled)
+            {
+                lcd_simd_invert(dst, len);
+                break;
+            }
+#endif
             fb_data *start = dst;
             fb_data *end = start + len;
             do {
@@ -510,6 +526,13 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(const fb_data* image,
      * Therefore NULL accesses are impossible and we can increment
      * unconditionally (applies for stride at the end of the loop as well) */
     image += skip_start_image;
+
+#ifdef HAVE_LCD_SIMD
+    struct lcd_simd_blend simd;
+    bool use_simd = lcd_simd_enabled &&
+        lcd_simd_blend_init(&simd, drmode, vp->fg_pattern, vp->bg_pattern);
+#endif
+
     /* go through the rows and update each pixel */
     do
     {
@@ -547,6 +570,25 @@ static void ICODE_ATTR lcd_alpha_bitmap_part_mix(const fb_data* image,
         } while (0)
 #endif
 
+#ifdef HAVE_LCD_SIMD
+        if (use_simd)
+        {
+            unsigned char weights[LCD_SIMD_CHUNK * LCD_SIMD_ALPHA_STEP];
+            for (col = 0; col < width; col += LCD_SIMD_CHUNK)
+            {
+                int i, n = MIN(width - col, LCD_SIMD_CHUNK);
+                for (i = 0; i < n; i++)
+                {
+                    lcd_simd_put_alpha(&weights[i * LCD_SIMD_ALPHA_STEP],
+                                       data & ALPHA_COLOR_LOOKUP_SIZE);
+                    UPDATE_SRC_ALPHA;
+                }
+                lcd_simd_blend_span(&simd, dst + col, image + col,
+                                    lcd_backdrop_offset, weights, n);
+            }
+        }
+        else
+#endif
         switch (drmode)
         {
             case DRMODE_COMPLEMENT:
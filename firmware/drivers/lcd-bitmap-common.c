@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include "string-extra.h"
 #include "diacritic.h"
+#include "core_alloc.h"
 
 #ifdef LOGF_ENABLE
 #include "panic.h"
@@ -54,6 +55,109 @@ extern void viewport_set_buffer(struct viewport *vp,
                                 struct frame_buffer_t *buffer,
                                 const enum screen_type screen); /* viewport.c */
 
+#if defined(MAIN_LCD) && defined(HAVE_LCD_DAMAGE)
+/*
+ * Damage tracking:
+ *
+ * The clipping functions below record the on-screen area of everything
+ * drawn to the main framebuffer so lcd_update_damage() can push only that.
+ * A new area touching an existing rectangle is merged into it; once all
+ * LCD_DAMAGE_RECTS are in use it is merged into the one that grows least.
+ * Only skins push the damage; code that updates the screen itself would
+ * otherwise have its drawing pile up here, so skins start each frame with
+ * lcd_damage_reset().
+ */
+static struct
+{
+    short x1, y1, x2, y2; /* inclusive */
+} lcd_damage[LCD_DAMAGE_RECTS];
+static int lcd_damage_count = 0;
+
+static void lcd_damage_add(int x1, int y1, int x2, int y2)
+{
+    int i, best = 0;
+    long best_grow = -1;
+
+    for (i = 0; i < lcd_damage_count; i++)
+    {
+        int ux1 = MIN(x1, lcd_damage[i].x1), uy1 = MIN(y1, lcd_damage[i].y1);
+        int ux2 = MAX(x2, lcd_damage[i].x2), uy2 = MAX(y2, lcd_damage[i].y2);
+
+        if (x1 <= lcd_damage[i].x2 + 1 && x2 + 1 >= lcd_damage[i].x1 &&
+            y1 <= lcd_damage[i].y2 + 1 && y2 + 1 >= lcd_damage[i].y1)
+        {
+            best = i;
+            best_grow = 0;
+            break;
+        }
+
+        long grow = (long)(ux2 - ux1 + 1) * (uy2 - uy1 + 1) -
+                    (long)(lcd_damage[i].x2 - lcd_damage[i].x1 + 1) *
+                          (lcd_damage[i].y2 - lcd_damage[i].y1 + 1);
+        if (best_grow < 0 || grow < best_grow)
+        {
+            best = i;
+            best_grow = grow;
+        }
+    }
+
+    if (best_grow != 0 && lcd_damage_count < LCD_DAMAGE_RECTS)
+    {
+        best = lcd_damage_count++;
+        lcd_damage[best].x1 = x1;
+        lcd_damage[best].y1 = y1;
+        lcd_damage[best].x2 = x2;
+        lcd_damage[best].y2 = y2;
+        return;
+    }
+
+    lcd_damage[best].x1 = MIN(x1, lcd_damage[best].x1);
+    lcd_damage[best].y1 = MIN(y1, lcd_damage[best].y1);
+    lcd_damage[best].x2 = MAX(x2, lcd_damage[best].x2);
+    lcd_damage[best].y2 = MAX(y2, lcd_damage[best].y2);
+}
+
+#define lcd_damage_vp(vp, x1, y1, x2, y2) \
+    do { if ((vp)->buffer == &lcd_framebuffer_default) \
+            lcd_damage_add((x1), (y1), (x2), (y2)); } while (0)
+
+void lcd_damage_reset(void)
+{
+    lcd_damage_count = 0;
+}
+
+void lcd_update_damage(void)
+{
+    int i;
+    long area = 0;
+
+    for (i = 0; i < lcd_damage_count; i++)
+        area += (long)(lcd_damage[i].x2 - lcd_damage[i].x1 + 1) *
+                      (lcd_damage[i].y2 - lcd_damage[i].y1 + 1);
+
+    /* Once most of the screen is dirty one transfer beats several */
+    if (area >= (long)LCD_WIDTH * LCD_HEIGHT * 3 / 4)
+        lcd_update();
+    else
+    {
+        for (i = 0; i < lcd_damage_count; i++)
+        {
+            int x1 = MAX(lcd_damage[i].x1, 0);
+            int y1 = MAX(lcd_damage[i].y1, 0);
+            int x2 = MIN(lcd_damage[i].x2, LCD_WIDTH - 1);
+            int y2 = MIN(lcd_damage[i].y2, LCD_HEIGHT - 1);
+
+            if (x1 <= x2 && y1 <= y2)
+                lcd_update_rect(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+        }
+    }
+
+    lcd_damage_count = 0;
+}
+#else
+#define lcd_damage_vp(vp, x1, y1, x2, y2) do { } while (0)
+#endif /* MAIN_LCD && HAVE_LCD_DAMAGE */
+
 /*
  * In-viewport clipping functions:
  *
@@ -71,6 +175,7 @@ static inline bool clip_viewport_pixel(struct viewport *vp, int *x, int *y)
 
     *x += vp->x;
     *y += vp->y;
+    lcd_damage_vp(vp, *x, *y, *x, *y);
     return true;
 }
 
@@ -99,6 +204,7 @@ static inline bool clip_viewport_hline(struct viewport *vp,
     *x1 += vp->x;
     *x2 += vp->x;
     *y += vp->y;
+    lcd_damage_vp(vp, *x1, *y, *x2, *y);
     return true;
 }
 
@@ -127,6 +233,7 @@ static inline bool clip_viewport_vline(struct viewport *vp,
     *x += vp->x;
     *y1 += vp->y;
     *y2 += vp->y;
+    lcd_damage_vp(vp, *x, *y1, *x, *y2);
     return true;
 }
 
@@ -154,9 +261,13 @@ static inline bool clip_viewport_rect(struct viewport *vp,
     if (*y + *height > vp->height)
         *height = vp->height - *y;
 
+    if (*width <= 0 || *height <= 0)
+        return false;
+
     *x += vp->x;
     *y += vp->y;
-    return *width > 0 && *height > 0;
+    lcd_damage_vp(vp, *x, *y, *x + *width - 1, *y + *height - 1);
+    return true;
 }
 
 /*** parameter handling ***/
@@ -381,6 +492,277 @@ static void LCDFN(mono_bmp_part_helper)(const unsigned char *src, int src_x,
     LCDFN(mono_bitmap_part)(src, src_x, src_y, stride, x, y, width, height);
 }
 
+#if defined(MAIN_LCD) && defined(HAVE_LCD_TEXT_CACHE)
+/*
+ * Text run cache:
+ *
+ * Whole strings are rendered once into a coverage mask in the font's own
+ * format (mono columns or 4bpp alpha) and kept in a ring buffer, so drawing
+ * the same string again is a single clipped bitmap blit. The mask doesn't
+ * depend on colours, draw mode or backdrop, so neither does the cache key:
+ * font id, font generation and the string itself.
+ */
+struct text_run
+{
+    size_t offset;          /* string, then bitmap, within the ring */
+    size_t size;            /* 0 for an unused slot */
+    size_t len;             /* string length */
+    unsigned int generation;
+    int font;
+    int width;
+};
+static struct text_run text_runs[LCD_TEXT_CACHE_RUNS];
+static int text_cache_handle = 0;
+static size_t text_cache_pos = 0;
+static int text_run_next = 0;
+static bool text_cache_busy = false; /* a miss is being rendered */
+static unsigned long text_cache_hits = 0, text_cache_misses = 0;
+
+/* the cache is only a speedup; give its memory back whenever it's wanted */
+static int text_cache_shrink_callback(int handle, unsigned hints,
+                                      void *start, size_t old_size)
+{
+    (void)hints; (void)start; (void)old_size;
+
+    if (text_cache_busy)
+        return BUFLIB_CB_CANNOT_SHRINK; /* a run is being rendered into it */
+
+    memset(text_runs, 0, sizeof(text_runs));
+    text_cache_pos = 0;
+    text_run_next = 0;
+    text_cache_handle = 0;
+
+    core_free(handle);
+    return BUFLIB_CB_OK;
+}
+
+static struct buflib_callbacks text_cache_ops = {
+    .move_callback = NULL,
+    .shrink_callback = text_cache_shrink_callback,
+};
+
+void lcd_text_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+    *hits = text_cache_hits;
+    *misses = text_cache_misses;
+}
+
+/* OR (mono) or min (alpha) one glyph into the run bitmap at column dx */
+static void text_run_merge(const struct font *pf, unsigned char *dst,
+                           int run_width, int dx,
+                           const unsigned char *src, int width)
+{
+    int row, col;
+    int c0 = MAX(0, -dx), c1 = MIN(width, run_width - dx);
+
+    if (pf->depth)
+    {
+        for (row = 0; row < (int)pf->height; row++)
+        {
+            for (col = c0; col < c1; col++)
+            {
+                unsigned int s = row * width + col;
+                unsigned int d = row * run_width + dx + col;
+                unsigned int a = (src[s / 2] >> ((s & 1) * 4)) & 0xf;
+                unsigned int shift = (d & 1) * 4;
+
+                if (a < ((dst[d / 2] >> shift) & 0xf))
+                    dst[d / 2] = (dst[d / 2] & ~(0xf << shift)) | (a << shift);
+            }
+        }
+    }
+    else
+    {
+        for (row = 0; row < ((int)pf->height + 7) / 8; row++)
+        {
+            for (col = c0; col < c1; col++)
+                dst[row * run_width + dx + col] |= src[row * width + col];
+        }
+    }
+}
+
+/* Lay out a string from x = 0 the way putsxyofs() places its glyphs and
+ * return the width it covers. Renders into dst if it isn't NULL. */
+static int text_run_layout(struct font *pf, const unsigned short *ucs,
+                           unsigned char *dst, int run_width)
+{
+    int x = 0, extent = 0;
+    int rtl_next_non_diac_width = 0, last_non_diacritic_width = 0;
+
+    for (; *ucs; ucs++)
+    {
+        bool is_rtl, is_diac;
+        int width, base_width, base_ofs = 0;
+        const unsigned short next_ch = ucs[1];
+
+        is_diac = is_diacritic(*ucs, &is_rtl);
+        width = font_get_width(pf, *ucs);
+
+        if (is_rtl)
+        {
+            if (is_diac)
+            {
+                if (!rtl_next_non_diac_width)
+                {
+                    const unsigned short *u;
+                    for (u = &ucs[1]; *u && is_diacritic(*u, NULL); u++);
+                    rtl_next_non_diac_width = *u ? font_get_width(pf, *u) : 0;
+                }
+                base_width = rtl_next_non_diac_width;
+            }
+            else
+            {
+                rtl_next_non_diac_width = 0;
+                base_width = width;
+            }
+        }
+        else
+        {
+            if (!is_diac)
+                last_non_diacritic_width = width;
+            base_width = last_non_diacritic_width;
+        }
+
+        if (is_diac)
+            base_ofs = (base_width - width) / 2;
+
+        if (dst)
+            text_run_merge(pf, dst, run_width, x + base_ofs,
+                           font_get_bits(pf, *ucs), width);
+        extent = MAX(extent, x + base_ofs + width);
+
+        if (next_ch)
+        {
+            bool next_is_rtl;
+            bool next_is_diacritic = is_diacritic(next_ch, &next_is_rtl);
+
+            if ((is_rtl && !is_diac) ||
+                    (!is_rtl && (!next_is_diacritic || next_is_rtl)))
+                x += base_width;
+        }
+    }
+    return extent;
+}
+
+static void text_run_draw(const struct font *pf, const unsigned char *bm,
+                          int run_width, int x, int y, int ofs)
+{
+    if (ofs >= run_width)
+        return;
+    if (pf->depth)
+        lcd_alpha_bitmap_part(bm, ofs, 0, run_width,
+                              x, y, run_width - ofs, pf->height);
+    else
+        lcd_mono_bitmap_part(bm, ofs, 0, run_width,
+                             x, y, run_width - ofs, pf->height);
+}
+
+/* Draw str from the cache, rendering it there first if needed. Returns
+ * false if the caller has to draw it glyph by glyph instead. */
+static bool text_cache_draw(struct font *pf, int font,
+                            int x, int y, int ofs, const unsigned char *str)
+{
+    size_t len = strlen((const char *)str);
+    unsigned int generation = font_get_generation();
+    struct text_run *run;
+    unsigned char *data, *bm;
+    const unsigned short *ucs;
+    size_t bm_size, need;
+    int i, width;
+
+    if (len == 0)
+        return false;
+
+    if (text_cache_handle > 0)
+    {
+        data = core_get_data(text_cache_handle);
+        for (i = 0; i < LCD_TEXT_CACHE_RUNS; i++)
+        {
+            run = &text_runs[i];
+            if (run->size && run->font == font &&
+                run->generation == generation && run->len == len &&
+                !memcmp(data + run->offset, str, len))
+            {
+                text_cache_hits++;
+                text_run_draw(pf, data + run->offset + ALIGN_UP(len, 4),
+                              run->width, x, y, ofs);
+                return true;
+            }
+        }
+    }
+
+    text_cache_misses++;
+
+    /* font_get_bits() may yield on a cached font; let the other thread
+     * draw directly rather than share the ring */
+    if (text_cache_busy)
+        return false;
+
+    if (text_cache_handle <= 0)
+    {
+        /* only take memory that is free, never shrink the audio buffer */
+        if (core_allocatable() < LCD_TEXT_CACHE_SIZE)
+            return false;
+        text_cache_handle = core_alloc_ex(LCD_TEXT_CACHE_SIZE,
+                                          &text_cache_ops);
+        if (text_cache_handle <= 0)
+        {
+            text_cache_handle = 0;
+            return false;
+        }
+    }
+
+    text_cache_busy = true;
+    ucs = bidi_l2v(str, 1);
+    width = text_run_layout(pf, ucs, NULL, 0);
+
+    if (pf->depth)
+        bm_size = ((size_t)pf->height * width + 1) / 2;
+    else
+        bm_size = ((pf->height + 7) / 8) * (size_t)width;
+    need = ALIGN_UP(len, 4) + ALIGN_UP(bm_size, 4);
+    if (width <= 0 || need > LCD_TEXT_CACHE_SIZE / 2)
+    {
+        text_cache_busy = false;
+        return false;
+    }
+
+    if (text_cache_pos + need > LCD_TEXT_CACHE_SIZE)
+        text_cache_pos = 0;
+    for (i = 0; i < LCD_TEXT_CACHE_RUNS; i++)
+    {
+        run = &text_runs[i];
+        if (run->offset < text_cache_pos + need &&
+            run->offset + run->size > text_cache_pos)
+            run->size = 0;
+    }
+    run = &text_runs[text_run_next];
+    text_run_next = (text_run_next + 1) % LCD_TEXT_CACHE_RUNS;
+    run->size = 0;
+
+    core_pin(text_cache_handle);
+    data = core_get_data(text_cache_handle);
+    bm = data + text_cache_pos + ALIGN_UP(len, 4);
+
+    memcpy(data + text_cache_pos, str, len);
+    memset(bm, pf->depth ? 0xff : 0, ALIGN_UP(bm_size, 4));
+    text_run_layout(pf, ucs, bm, width);
+    text_run_draw(pf, bm, width, x, y, ofs);
+
+    run->offset = text_cache_pos;
+    run->len = len;
+    run->generation = generation;
+    run->font = font;
+    run->width = width;
+    run->size = need;
+    text_cache_pos += need;
+
+    core_unpin(text_cache_handle);
+    text_cache_busy = false;
+    return true;
+}
+#endif /* MAIN_LCD && HAVE_LCD_TEXT_CACHE */
+
 #ifndef BOOTLOADER
 /* put a string at a given pixel position, skipping first ofs pixel columns */
 static void LCDFN(putsxyofs)(int x, int y, int ofs, const unsigned char *str)
@@ -420,6 +802,14 @@ static void LCDFN(putsxyofs)(int x, int y, int ofs, const unsigned char *str)
 #endif
         bmp_part_fn = LCDFN(mono_bmp_part_helper);
 
+#if defined(MAIN_LCD) && defined(HAVE_LCD_TEXT_CACHE)
+    if (text_cache_draw(pf, LCDFN(current_viewport)->font, x, y, ofs, str))
+    {
+        font_lock(LCDFN(current_viewport)->font, false);
+        return;
+    }
+#endif
+
     rtl_next_non_diac_width = 0;
     last_non_diacritic_width = 0;
     /* Mark diacritic and rtl flags for each character */
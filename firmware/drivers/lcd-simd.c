@@ -0,0 +1,364 @@
+/***************************************************************************
+ *             __________               __   ___.
+ *   Open      \______   \ ____   ____ |  | _\_ |__   _______  ___
+ *   Source     |       _//  _ \_/ ___\|  |/ /| __ \ /  _ \  \/  /
+ *   Jukebox    |    |   (  <_> )  \___|    < | \_\ (  <_> > <  <
+ *   Firmware   |____|_  /\____/ \___  >__|_ \|___  /\____/__/\_ \
+ *                     \/            \/     \/    \/            \/
+ * $Id$
+ *
+ * Vectorised span kernels for the 16/24/32 bit LCD drivers on hosted builds
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ****************************************************************************/
+
+/* Included by lcd-16bit.c and lcd-24bit.c, HAVE_LCD_SIMD comes from lcd.h.
+ *
+ * Blending works on spans of up to LCD_SIMD_CHUNK pixels. The driver
+ * decodes the 4 bit alpha of a span into weights first, then one call
+ * blends the whole span. Both colour formats reduce to the same per channel
+ * formula as blend_two_colors():
+ *
+ *   out = (c1 * a + c2 * (16 - a)) >> 4, with a = alpha + (alpha >> 3)
+ *
+ * RGB565 is blended per pixel with the channels split into 16 bit lanes,
+ * 24 and 32 bit pixels are blended byte by byte with the weight repeated
+ * for each byte of a pixel. The results are bit-exact with the scalar code,
+ * including the cleared X byte of XRGB8888.
+ */
+
+#ifdef HAVE_LCD_SIMD
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define LCD_SIMD_CHUNK 64
+
+#if FB_DATA_SZ == 2
+#define LCD_SIMD_ALPHA_STEP 1           /* one weight per pixel */
+#else
+#define LCD_SIMD_ALPHA_STEP FB_DATA_SZ  /* one weight per byte */
+#endif
+
+/* where the two colours of a blend come from */
+enum
+{
+    LCD_SIMD_SRC_DST,   /* the framebuffer itself */
+    LCD_SIMD_SRC_BD,    /* the backdrop */
+    LCD_SIMD_SRC_IMG,   /* the native image of an alpha bitmap */
+    LCD_SIMD_SRC_FILL,  /* a constant colour, see fill1/fill2 */
+};
+
+struct lcd_simd_blend
+{
+    int src1, src2;
+    bool invert; /* DRMODE_COMPLEMENT: c2 is the inverted framebuffer */
+    fb_data fill1[LCD_SIMD_CHUNK];
+    fb_data fill2[LCD_SIMD_CHUNK];
+};
+
+static bool lcd_simd_enabled = true;
+
+bool lcd_set_simd(bool enable)
+{
+    bool was_enabled = lcd_simd_enabled;
+    lcd_simd_enabled = enable;
+    return was_enabled;
+}
+
+static inline void lcd_simd_put_alpha(unsigned char *p, unsigned a)
+{
+    a += a >> 3;
+#if LCD_SIMD_ALPHA_STEP == 1
+    p[0] = a;
+#else
+    for (int i = 0; i < LCD_SIMD_ALPHA_STEP; i++)
+        p[i] = a;
+#endif
+}
+
+/* Fill n pixels with px */
+static void lcd_simd_fill(fb_data *dst, fb_data px, int n)
+{
+    /* 48 bytes hold a whole number of pixels in every format */
+    fb_data pat[48 / FB_DATA_SZ];
+    const int pat_px = ARRAYLEN(pat);
+    unsigned char *d = (unsigned char *)dst;
+
+    for (int i = 0; i < pat_px; i++)
+        pat[i] = px;
+
+#if defined(__SSE2__)
+    __m128i v0 = _mm_loadu_si128((const __m128i *)pat);
+    __m128i v1 = _mm_loadu_si128((const __m128i *)pat + 1);
+    __m128i v2 = _mm_loadu_si128((const __m128i *)pat + 2);
+    for (; n >= pat_px; n -= pat_px, d += 48)
+    {
+        _mm_storeu_si128((__m128i *)d, v0);
+        _mm_storeu_si128((__m128i *)d + 1, v1);
+        _mm_storeu_si128((__m128i *)d + 2, v2);
+    }
+#else
+    uint8x16_t v0 = vld1q_u8((const uint8_t *)pat);
+    uint8x16_t v1 = vld1q_u8((const uint8_t *)pat + 16);
+    uint8x16_t v2 = vld1q_u8((const uint8_t *)pat + 32);
+    for (; n >= pat_px; n -= pat_px, d += 48)
+    {
+        vst1q_u8(d, v0);
+        vst1q_u8(d + 16, v1);
+        vst1q_u8(d + 32, v2);
+    }
+#endif
+
+    for (dst = (fb_data *)d; n > 0; n--)
+        *dst++ = px;
+}
+
+/* Invert n pixels (DRMODE_COMPLEMENT) */
+static void lcd_simd_invert(fb_data *dst, int n)
+{
+    unsigned char *d = (unsigned char *)dst;
+    int bytes = n * FB_DATA_SZ;
+
+#if defined(__SSE2__)
+    const __m128i ones = _mm_set1_epi8(-1);
+    for (; bytes >= 16; bytes -= 16, d += 16)
+        _mm_storeu_si128((__m128i *)d,
+            _mm_xor_si128(_mm_loadu_si128((const __m128i *)d), ones));
+#else
+    for (; bytes >= 16; bytes -= 16, d += 16)
+        vst1q_u8(d, vmvnq_u8(vld1q_u8(d)));
+#endif
+
+    for (; bytes > 0; bytes--, d++)
+        *d = ~*d;
+}
+
+/* Map a drawmode of lcd_alpha_bitmap_part_mix() to the colours it blends.
+ * Returns false for combinations the scalar code doesn't draw either. */
+static bool lcd_simd_blend_init(struct lcd_simd_blend *b, int drmode,
+                                unsigned fg, unsigned bg)
+{
+    b->invert = false;
+    switch (drmode)
+    {
+    case DRMODE_COMPLEMENT:
+        b->src1 = LCD_SIMD_SRC_DST;
+        b->src2 = LCD_SIMD_SRC_DST;
+        b->invert = true;
+        break;
+    case DRMODE_BG|DRMODE_INT_BD:
+        b->src1 = LCD_SIMD_SRC_BD;
+        b->src2 = LCD_SIMD_SRC_DST;
+        break;
+    case DRMODE_BG:
+        b->src1 = LCD_SIMD_SRC_FILL;
+        b->src2 = LCD_SIMD_SRC_DST;
+        break;
+    case DRMODE_FG|DRMODE_INT_IMG:
+        b->src1 = LCD_SIMD_SRC_DST;
+        b->src2 = LCD_SIMD_SRC_IMG;
+        break;
+    case DRMODE_FG:
+        b->src1 = LCD_SIMD_SRC_DST;
+        b->src2 = LCD_SIMD_SRC_FILL;
+        break;
+    case DRMODE_SOLID|DRMODE_INT_BD:
+        b->src1 = LCD_SIMD_SRC_BD;
+        b->src2 = LCD_SIMD_SRC_FILL;
+        break;
+    case DRMODE_SOLID|DRMODE_INT_IMG:
+        b->src1 = LCD_SIMD_SRC_FILL;
+        b->src2 = LCD_SIMD_SRC_IMG;
+        break;
+    case DRMODE_SOLID|DRMODE_INT_BD|DRMODE_INT_IMG:
+        b->src1 = LCD_SIMD_SRC_BD;
+        b->src2 = LCD_SIMD_SRC_IMG;
+        break;
+    case DRMODE_SOLID:
+        b->src1 = LCD_SIMD_SRC_FILL;
+        b->src2 = LCD_SIMD_SRC_FILL;
+        break;
+    default:
+        return false;
+    }
+
+    if (b->src1 == LCD_SIMD_SRC_FILL)
+        lcd_simd_fill(b->fill1, FB_SCALARPACK_LCD(bg), LCD_SIMD_CHUNK);
+    if (b->src2 == LCD_SIMD_SRC_FILL)
+        lcd_simd_fill(b->fill2, FB_SCALARPACK_LCD(fg), LCD_SIMD_CHUNK);
+    return true;
+}
+
+static inline const fb_data *lcd_simd_src(int src, fb_data *dst,
+                                          const fb_data *image, long bo,
+                                          const fb_data *fill)
+{
+    switch (src)
+    {
+    case LCD_SIMD_SRC_BD:
+        return (const fb_data *)((intptr_t)dst + bo);
+    case LCD_SIMD_SRC_IMG:
+        return image;
+    case LCD_SIMD_SRC_FILL:
+        return fill;
+    default:
+        return dst;
+    }
+}
+
+/* Blend n <= LCD_SIMD_CHUNK pixels at dst. alpha holds the weights made by
+ * lcd_simd_put_alpha(), image and bo (backdrop offset in bytes) are only
+ * used by the drawmodes that need them. */
+static void lcd_simd_blend_span(const struct lcd_simd_blend *b,
+                                fb_data *dst, const fb_data *image, long bo,
+                                const unsigned char *alpha, int n)
+{
+    const fb_data *c1 = lcd_simd_src(b->src1, dst, image, bo, b->fill1);
+    const fb_data *c2 = lcd_simd_src(b->src2, dst, image, bo, b->fill2);
+
+#if FB_DATA_SZ == 2
+    /* blend_two_colors() gets ~(*dst) promoted to int, whose high half
+     * ends up in the green field: complement blends green towards 63 */
+    const unsigned inv = b->invert ? 0xffff : 0;
+    const unsigned inv_g = b->invert ? 0x07e0 : 0;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+    const __m128i a16 = _mm_set1_epi16(16), vinv = _mm_set1_epi16(inv);
+    const __m128i vinv_g = _mm_set1_epi16(inv_g);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_unpacklo_epi8(
+                        _mm_loadl_epi64((const __m128i *)(alpha + i)), zero);
+        __m128i ia = _mm_sub_epi16(a16, a);
+        __m128i x = _mm_loadu_si128((const __m128i *)(c1 + i));
+        __m128i y = _mm_or_si128(_mm_xor_si128(
+                        _mm_loadu_si128((const __m128i *)(c2 + i)), vinv), vinv_g);
+        __m128i r = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(x, 11), a),
+                                  _mm_mullo_epi16(_mm_srli_epi16(y, 11), ia));
+        __m128i g = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(x, 5), m6), a),
+            _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(y, 5), m6), ia));
+        __m128i bl = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(x, m5), a),
+                                   _mm_mullo_epi16(_mm_and_si128(y, m5), ia));
+        r = _mm_slli_epi16(_mm_srli_epi16(r, 4), 11);
+        g = _mm_slli_epi16(_mm_srli_epi16(g, 4), 5);
+        bl = _mm_srli_epi16(bl, 4);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_or_si128(_mm_or_si128(r, g), bl));
+    }
+#else
+    const uint16x8_t m5 = vdupq_n_u16(0x1f), m6 = vdupq_n_u16(0x3f);
+    const uint16x8_t a16 = vdupq_n_u16(16), vinv = vdupq_n_u16(inv);
+    const uint16x8_t vinv_g = vdupq_n_u16(inv_g);
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t a = vmovl_u8(vld1_u8(alpha + i));
+        uint16x8_t ia = vsubq_u16(a16, a);
+        uint16x8_t x = vld1q_u16(c1 + i);
+        uint16x8_t y = vorrq_u16(veorq_u16(vld1q_u16(c2 + i), vinv), vinv_g);
+        uint16x8_t r = vmlaq_u16(vmulq_u16(vshrq_n_u16(x, 11), a),
+                                 vshrq_n_u16(y, 11), ia);
+        uint16x8_t g = vmlaq_u16(vmulq_u16(vandq_u16(vshrq_n_u16(x, 5), m6), a),
+                                 vandq_u16(vshrq_n_u16(y, 5), m6), ia);
+        uint16x8_t bl = vmlaq_u16(vmulq_u16(vandq_u16(x, m5), a),
+                                  vandq_u16(y, m5), ia);
+        r = vshlq_n_u16(vshrq_n_u16(r, 4), 11);
+        g = vshlq_n_u16(vshrq_n_u16(g, 4), 5);
+        bl = vshrq_n_u16(bl, 4);
+        vst1q_u16(dst + i, vorrq_u16(vorrq_u16(r, g), bl));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        unsigned x = c1[i], y = (c2[i] ^ inv) | inv_g, a = alpha[i], ia = 16 - a;
+        unsigned r = ((x >> 11) * a + (y >> 11) * ia) >> 4;
+        unsigned g = (((x >> 5) & 0x3f) * a + ((y >> 5) & 0x3f) * ia) >> 4;
+        unsigned bl = ((x & 0x1f) * a + (y & 0x1f) * ia) >> 4;
+        dst[i] = (r << 11) | (g << 5) | bl;
+    }
+#else /* FB_DATA_SZ >= 3 */
+    const unsigned char *x = (const unsigned char *)c1;
+    const unsigned char *y = (const unsigned char *)c2;
+    unsigned char *d = (unsigned char *)dst;
+    const unsigned char inv = b->invert ? 0xff : 0;
+    int bytes = n * FB_DATA_SZ, i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a16 = _mm_set1_epi16(16), vinv = _mm_set1_epi8(inv);
+#if FB_DATA_SZ == 4
+    const __m128i xmask = _mm_set1_epi32(0x00ffffff);
+#endif
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(alpha + i));
+        __m128i vx = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i vy = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(y + i)),
+                                   vinv);
+        __m128i alo = _mm_unpacklo_epi8(a, zero);
+        __m128i ahi = _mm_unpackhi_epi8(a, zero);
+        __m128i lo = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(vx, zero), alo),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(vy, zero),
+                            _mm_sub_epi16(a16, alo)));
+        __m128i hi = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(vx, zero), ahi),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(vy, zero),
+                            _mm_sub_epi16(a16, ahi)));
+        __m128i out = _mm_packus_epi16(_mm_srli_epi16(lo, 4),
+                                       _mm_srli_epi16(hi, 4));
+#if FB_DATA_SZ == 4
+        out = _mm_and_si128(out, xmask);
+#endif
+        _mm_storeu_si128((__m128i *)(d + i), out);
+    }
+#else
+    const uint8x16_t a16 = vdupq_n_u8(16), vinv = vdupq_n_u8(inv);
+#if FB_DATA_SZ == 4
+    const uint8x16_t xmask = vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffff));
+#endif
+    for (; i + 16 <= bytes; i += 16)
+    {
+        uint8x16_t a = vld1q_u8(alpha + i);
+        uint8x16_t ia = vsubq_u8(a16, a);
+        uint8x16_t vx = vld1q_u8(x + i);
+        uint8x16_t vy = veorq_u8(vld1q_u8(y + i), vinv);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(vx), vget_low_u8(a)),
+                                 vget_low_u8(vy), vget_low_u8(ia));
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(vx), vget_high_u8(a)),
+                                 vget_high_u8(vy), vget_high_u8(ia));
+        uint8x16_t out = vcombine_u8(vshrn_n_u16(lo, 4), vshrn_n_u16(hi, 4));
+#if FB_DATA_SZ == 4
+        out = vandq_u8(out, xmask);
+#endif
+        vst1q_u8(d + i, out);
+    }
+#endif
+    for (; i < bytes; i++)
+    {
+#if FB_DATA_SZ == 4
+        if ((i & 3) == 3)
+        {
+            d[i] = 0;
+            continue;
+        }
+#endif
+        unsigned a = alpha[i];
+        d[i] = (x[i] * a + (unsigned char)(y[i] ^ inv) * (16 - a)) >> 4;
+    }
+#endif /* FB_DATA_SZ */
+}
+
+#endif /* HAVE_LCD_SIMD */
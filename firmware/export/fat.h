@@ -160,6 +160,32 @@ int fat_truncate(const struct fat_filestr *filestr);
 struct filestr_cache;
 int fat_readdir(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
                 struct filestr_cache *cachep, struct fat_direntry *entry);
+
+/* window of directory sectors for fat_readdir_bulk(); reads whole runs of
+   the directory per transfer instead of a sector at a time */
+struct fat_dirbulk
+{
+    uint8_t       *buf;     /* buffer of 'max' sectors */
+    unsigned int  max;      /* capacity in sectors */
+    unsigned long sector;   /* first directory sector held */
+    unsigned int  count;    /* number of sectors held (0 = empty) */
+    unsigned int  gen;      /* directory change count when filled */
+    unsigned long reads;    /* transfers made */
+    unsigned long sectors;  /* sectors transferred */
+    uint32_t      crc;      /* CRC32 of the entries scanned from the start */
+    unsigned long crcnext;  /* next entry to go into crc */
+    unsigned int  crcgen;   /* directory change count when it began */
+    unsigned char crcskip[11]; /* short name left out of crc (0: none) */
+    uint8_t       crcskipsum;  /* its checksum, to match the long entries */
+};
+
+int fat_readdir_bulk(struct fat_filestr *dirstr, struct fat_dirscan_info *scan,
+                     struct filestr_cache *cachep, struct fat_dirbulk *bulk,
+                     struct fat_direntry *entry);
+int fat_dir_checksum(struct fat_filestr *dirstr, struct fat_dirbulk *bulk,
+                     uint32_t *crcp);
+bool fat_dirbulk_checksum(const struct fat_dirbulk *bulk, uint32_t *crcp);
+void fat_dirbulk_skip(struct fat_dirbulk *bulk, const char *name);
 void fat_rewinddir(struct fat_dirscan_info *scan);
 
 /** Mounting and unmounting functions **/
@@ -130,6 +130,9 @@ void font_disable_all(void);
 /* Re-opens the file descriptor of the font file. Should be called as
  * counter-part of font_disable_all(); */
 void font_enable_all(void);
+/* Changes whenever a font is loaded, unloaded or re-enabled, so callers
+ * caching rendered glyphs know when to drop them. */
+unsigned int font_get_generation(void);
 
 struct font* font_get(int font);
 int font_getstringnsize(const unsigned char *str, size_t maxbytes, int *w, int *h, int fontnumber);
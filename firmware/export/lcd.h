@@ -256,6 +256,42 @@ extern bool lcd_putsxy_scroll_func(int x, int y, const unsigned char *string,
 /* update a fraction of the screen */
 extern void lcd_update_rect(int x, int y, int width, int height);
 
+/* update only what the drawing functions touched since the last call;
+ * anything that writes the framebuffer directly must use lcd_update() */
+#ifdef HAVE_LCD_COLOR
+#define HAVE_LCD_DAMAGE
+#define LCD_DAMAGE_RECTS 8
+extern void lcd_update_damage(void);
+extern void lcd_damage_reset(void);
+#else
+#define lcd_update_damage lcd_update
+#define lcd_damage_reset() do { } while (0)
+#endif
+
+/* hosted builds blend, fill and invert spans with SSE2/NEON; the result is
+ * the same as the scalar code, lcd_set_simd() only exists for benchmarks */
+#if (CONFIG_PLATFORM & PLATFORM_HOSTED) && !defined(__PCTOOL__) && \
+    (defined(__SSE2__) || defined(__ARM_NEON)) && \
+    (LCD_STRIDEFORMAT == HORIZONTAL_STRIDE) && \
+    ((LCD_DEPTH == 16 && LCD_PIXELFORMAT == RGB565) || \
+     LCD_DEPTH == 24 || LCD_PIXELFORMAT == XRGB8888)
+#define HAVE_LCD_SIMD
+extern bool lcd_set_simd(bool enable); /* returns the previous state */
+#endif
+
+/* rendered text runs are kept in a small buflib cache so that lines drawn
+ * again (scrolling, menus, skins) become a single bitmap blit */
+#if defined(HAVE_LCD_COLOR) && (MEMORYSIZE >= 8) && !defined(BOOTLOADER)
+#define HAVE_LCD_TEXT_CACHE
+#if MEMORYSIZE >= 32
+#define LCD_TEXT_CACHE_SIZE (32*1024)
+#else
+#define LCD_TEXT_CACHE_SIZE (16*1024)
+#endif
+#define LCD_TEXT_CACHE_RUNS 32
+extern void lcd_text_cache_stats(unsigned long *hits, unsigned long *misses);
+#endif
+
 #ifdef HAVE_REMOTE_LCD
     extern void lcd_remote_update(void);
     /* update a fraction of the screen */
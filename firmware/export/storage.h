@@ -116,6 +116,29 @@ struct storage_info
 int storage_init(void) STORAGE_INIT_ATTR;
 void storage_close(void);
 
+#if (CONFIG_PLATFORM & PLATFORM_NATIVE) && !defined(BOOTLOADER) && \
+    defined(HAVE_SEMAPHORE_OBJECTS)
+/* Concurrent transfers from several threads are queued and ordered by
+ * sector instead of being served in arrival order */
+#define HAVE_STORAGE_SCHED
+
+struct storage_sched_stats
+{
+    unsigned long requests;  /* transfers requested */
+    unsigned long waits;     /* requests that found the device busy */
+    unsigned long reordered; /* waiters served ahead of an older one */
+    unsigned long expired;   /* waiters served because of their deadline */
+    unsigned long urgent;    /* waiters served for the urgent thread */
+    unsigned int  max_queue; /* most waiters seen at once */
+};
+
+void storage_sched_get_stats(struct storage_sched_stats *stats, bool reset);
+/* requests from this thread may jump the queue while audio is critical */
+void storage_sched_set_urgent_thread(unsigned int thread_id);
+/* signal that the PCM buffer is about to run dry */
+void storage_sched_audio_critical(void);
+#endif /* HAVE_STORAGE_SCHED */
+
 #ifdef HAVE_HOSTFS
 #include "hostfs.h"
 /* stubs for the plugin api */
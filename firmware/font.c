@@ -103,6 +103,8 @@ struct buflib_alloc_data {
     unsigned char buffer[];
 };
 static int buflib_allocations[MAXFONTS];
+/* bumped whenever the glyphs behind a font id may have changed */
+static unsigned int font_generation;
 
 static int cache_fd;
 static struct font* cache_pf;
@@ -591,6 +593,7 @@ int font_load_ex( const char *path, size_t buf_size, int glyphs )
     //printf("%s -> [%d] -> %d\n", path, font_id, *handle);
     core_put_data_pinned(pdata);
     logf("%s id: [%d], %s", __func__, font_id, path);
+    font_generation++;
     return font_id; /* success!*/
 }
 
@@ -619,6 +622,7 @@ void font_unload(int font_id)
         }
         core_free(handle);
         buflib_allocations[font_id] = -1;
+        font_generation++;
 
     }
 }
@@ -686,6 +690,13 @@ void font_enable_all(void)
 {
     for(int i = 0; i < MAXFONTS; i++)
         font_enable(i);
+    /* glyphs drawn while disabled may have been blanks */
+    font_generation++;
+}
+
+unsigned int font_get_generation(void)
+{
+    return font_generation;
 }
 
 
@@ -46,6 +46,15 @@
 #define DIRCACHE_MAX_DEPTH  15
 #define DIRCACHE_STACK_SIZE (DEFAULT_STACK_SIZE + 0x100)
 
+/* keep a hash index of entry names in a separate allocation so that path
+   lookups don't scan whole directories; it is sized from the entry count and
+   left out when that would take more than DIRCACHE_INDEX_LIMIT (1/64 of the
+   RAM), and on the 8 MB targets which need all of it for the cache itself */
+#if MEMORYSIZE > 8
+#define DIRCACHE_NAME_INDEX
+#define DIRCACHE_INDEX_LIMIT (MEMORYSIZE*1024*16)
+#endif
+
 /* memory buffer constants that control allocation */
 #define DIRCACHE_RESERVE (1024*64)     /* 64 KB - new entry slack */
 #define DIRCACHE_MIN     (1024*1024*1) /* 1 MB - provision min size */
@@ -75,6 +84,9 @@ typedef uint32_t dc_serial_t;
 #if CONFIG_PLATFORM & PLATFORM_NATIVE
 /* native dircache is lower-level than on a hosted target */
 #define DIRCACHE_NATIVE
+/* the cache may be saved and reloaded; each directory of a reloaded cache is
+   checked against the disk before it is trusted */
+#define DIRCACHE_SNAPSHOT
 #endif
 
 struct dircache_file
@@ -124,6 +136,11 @@ int dircache_readdir_internal(struct filestr_base *stream,
                               struct file_base_info *infop,
                               struct fat_direntry *fatent);
 void dircache_rewinddir_internal(struct file_base_info *info);
+#ifdef DIRCACHE_NAME_INDEX
+int dircache_lookup_internal(struct filestr_base *stream, const char *name,
+                             struct file_base_info *infop,
+                             struct fat_direntry *fatent);
+#endif
 #endif /* DIRCACHE_NATIVE */
 
 
@@ -190,6 +207,18 @@ struct dircache_info
     size_t       reserve_used;   /* amount of reserve used */
     unsigned int entry_count;    /* number of cache entries */
     long         build_ticks;    /* total time used to build cache */
+#ifdef DIRCACHE_NATIVE
+    unsigned long dir_reads;     /* directory transfers by the last build */
+    unsigned long dir_sectors;   /* directory sectors read by last build */
+#endif
+#ifdef DIRCACHE_SNAPSHOT
+    unsigned int snap_dirs;      /* directories revalidated from a snapshot */
+    unsigned int snap_stale;     /* of those, found changed and rescanned */
+#endif
+#ifdef DIRCACHE_NAME_INDEX
+    unsigned int index_slots;    /* size of the name index (0 = none) */
+    unsigned int index_used;     /* entries in the name index */
+#endif
 };
 
 void dircache_get_info(struct dircache_info *info);
@@ -201,10 +230,10 @@ void dircache_dump(void);
 /** Misc. stuff **/
 void dircache_dcfile_init(struct dircache_file *dcfilep);
 
-#ifdef HAVE_EEPROM_SETTINGS
+#ifdef DIRCACHE_SNAPSHOT
 int dircache_load(void);
 int dircache_save(void);
-#endif /* HAVE_EEPROM_SETTINGS */
+#endif /* DIRCACHE_SNAPSHOT */
 
 void dircache_init(size_t last_size) INIT_ATTR;
 
@@ -279,6 +279,19 @@ static inline int readdir_internal(struct filestr_base *stream,
 #endif
 }
 
+static inline int lookup_internal(struct filestr_base *stream,
+                                  const char *name,
+                                  struct file_base_info *infop,
+                                  struct fat_direntry *fatent)
+{
+#if defined(HAVE_DIRCACHE) && defined(DIRCACHE_NAME_INDEX)
+    return dircache_lookup_internal(stream, name, infop, fatent);
+#else
+    (void)stream; (void)name; (void)infop; (void)fatent;
+    return -1; /* scan */
+#endif
+}
+
 static inline void rewinddir_internal(struct file_base_info *infop)
 {
 #ifdef HAVE_DIRCACHE
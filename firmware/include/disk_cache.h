@@ -45,9 +45,10 @@ void dc_discard_all(IF_MV_NONVOID(int volume));
 
 void dc_init(void) INIT_ATTR;
 
-/* in addition to filling, writeback is implemented by the client */
+/* in addition to filling, writeback is implemented by the client; 'count'
+   consecutive sectors starting at 'sector' are contiguous in 'buf' */
 extern void dc_writeback_callback(IF_MV(int volume, ) unsigned long sector,
-                                  void *buf);
+                                  unsigned int count, void *buf);
 
 
 /** These synchronize and can be called by anyone **/
@@ -59,6 +59,21 @@ struct filestr_cache
     unsigned int  flags;    /* FSC_* bits */
 };
 
+#ifndef BOOTLOADER
+/* Sequential read-ahead: small sequential reads are served from a window
+   of several sectors read in one transfer. The windows are taken from a
+   small pool shared by all streams and grow while the access stays
+   sequential. */
+#define FILE_READAHEAD
+#define FILE_RA_BUFS        2   /* windows in the pool */
+#define FILE_RA_MIN_SECTORS 4   /* initial window size */
+#if MEMORYSIZE >= 16
+#define FILE_RA_MAX_SECTORS 32  /* largest window size */
+#else
+#define FILE_RA_MAX_SECTORS 8
+#endif
+#endif /* BOOTLOADER */
+
 void file_cache_init(struct filestr_cache *cachep);
 void file_cache_reset(struct filestr_cache *cachep);
 void file_cache_alloc(struct filestr_cache *cachep);
@@ -234,6 +249,9 @@ int test_stream_exists_internal(const char *path, unsigned int callflags);
 
 int open_noiso_internal(const char *path, int oflag); /* file.c */
 void force_close_writer_internal(struct filestr_base *stream); /* file.c */
+#ifdef FILE_READAHEAD
+void file_readahead_init(void) INIT_ATTR; /* file.c */
+#endif
 
 struct DIRENT;
 int uncached_readdir_dirent(struct filestr_base *stream,
@@ -60,6 +60,18 @@ off_t   filesize(int fildes);
 int     fsamefile(int fildes1, int fildes2);
 int     relate(const char *path1, const char *path2);
 bool    file_exists(const char *path);
+
+#ifndef BOOTLOADER
+struct file_io_stats
+{
+    unsigned long transfers;  /* reads issued to the FAT layer by read() */
+    unsigned long ra_fills;   /* read-ahead windows filled */
+    unsigned long ra_sectors; /* sectors read into windows */
+    unsigned long ra_hits;    /* read() calls served from a window */
+};
+
+void file_get_io_stats(struct file_io_stats *stats, bool reset);
+#endif /* BOOTLOADER */
 #endif /* !FILEFUNCTIONS_DECLARED */
 
 #if !defined(RB_FILESYSTEM_OS) && !defined (FILEFUNCTIONS_DEFINED)
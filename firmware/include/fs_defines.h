@@ -100,13 +100,29 @@
  * volumes that would slow cache probing. IOC_MAP_NUM_ENTRIES is the number
  * for each map per volume. The buffers themselves are shared.
  */
+#ifndef DC_NUM_ENTRIES /* target config may choose its own size */
 #if MEMORYSIZE < 8
 #define DC_NUM_ENTRIES      32
-#define DC_MAP_NUM_ENTRIES  128
-#else
+#elif MEMORYSIZE < 32
 #define DC_NUM_ENTRIES      64
-#define DC_MAP_NUM_ENTRIES  256
+#else
+#define DC_NUM_ENTRIES      128
 #endif /* MEMORYSIZE */
+#endif /* DC_NUM_ENTRIES */
+
+#ifndef DC_MAP_NUM_ENTRIES
+#define DC_MAP_NUM_ENTRIES  (DC_NUM_ENTRIES*4)
+#endif
+
+/* Dirty sectors are sorted when committed and adjacent ones are written
+ * together, up to this many per transfer. Runs whose buffers aren't
+ * already consecutive in memory are gathered into a bounce buffer of
+ * this size. */
+#if MEMORYSIZE < 8
+#define DC_WRITE_RUN_MAX    4
+#else
+#define DC_WRITE_RUN_MAX    16
+#endif
 
 /* this _could_ be larger than a sector if that would ever be useful */
 #define DC_CACHE_BUFSIZE    SECTOR_SIZE
@@ -23,6 +23,7 @@
 #include "ata_idle_notify.h"
 #include "usb.h"
 #include "disk.h"
+#include <string.h>
 
 #ifdef CONFIG_STORAGE_MULTI
 
@@ -254,6 +255,10 @@ void storage_close(void)
 }
 #endif /* STORAGE_CLOSE */
 
+#ifdef HAVE_STORAGE_SCHED
+static void storage_sched_init(void);
+#endif
+
 static inline void storage_thread_init(void)
 {
     if (storage_thread_id) {
@@ -334,12 +339,15 @@ int storage_init(void)
     rc = STORAGE_FUNCTION(init)();
 #endif /* CONFIG_STORAGE_MULTI */
 
+#ifdef HAVE_STORAGE_SCHED
+    storage_sched_init();
+#endif
     storage_thread_init();
     return rc;
 }
 
-int storage_read_sectors(IF_MD(int drive,) unsigned long start, int count,
-                         void* buf)
+static int driver_read_sectors(IF_MD(int drive,) unsigned long start,
+                               int count, void* buf)
 {
 #ifdef CONFIG_STORAGE_MULTI
     int driver=(storage_drivers[drive] & DRIVER_MASK)>>DRIVER_OFFSET;
@@ -380,8 +388,8 @@ int storage_read_sectors(IF_MD(int drive,) unsigned long start, int count,
 
 }
 
-int storage_write_sectors(IF_MD(int drive,) unsigned long start, int count,
-                          const void* buf)
+static int driver_write_sectors(IF_MD(int drive,) unsigned long start,
+                                int count, const void* buf)
 {
 #ifdef CONFIG_STORAGE_MULTI
     int driver=(storage_drivers[drive] & DRIVER_MASK)>>DRIVER_OFFSET;
@@ -421,6 +429,235 @@ int storage_write_sectors(IF_MD(int drive,) unsigned long start, int count,
 #endif /* CONFIG_STORAGE_MULTI */
 }
 
+#ifdef HAVE_STORAGE_SCHED
+/* Request scheduling
+ *
+ * Transfers are carried out by the calling thread since it owns the buffer.
+ * Whichever thread is transferring owns the device; others that arrive in
+ * the meantime wait in the queue and, when the owner finishes, it hands the
+ * device to the waiter picked by this order:
+ *  1) the urgent thread's requests while audio is critical
+ *  2) the oldest waiter past its deadline
+ *  3) the nearest sector at or above the last one transferred, wrapping to
+ *     the lowest one (C-LOOK)
+ */
+#define STORAGE_SCHED_DEADLINE  (HZ/2)  /* longest a waiter is passed over */
+#define STORAGE_URGENT_TIME     (HZ/4)  /* urgency lasts this long */
+
+struct storage_req
+{
+    struct storage_req *next;  /* next waiter in arrival order */
+#ifdef HAVE_MULTIDRIVE
+    int drive;
+#endif
+    unsigned long start;
+    unsigned int thread;
+    long deadline;
+    struct semaphore sem;
+};
+
+static struct mutex sched_mutex;
+static struct storage_req *sched_waiters;   /* queue in arrival order */
+static unsigned int sched_queued;
+static bool sched_busy;                     /* device is owned */
+#ifdef HAVE_MULTIDRIVE
+static int sched_drive;                     /* drive last transferred */
+#endif
+static unsigned long sched_head;            /* sector after last transfer */
+static unsigned int sched_urgent_thread;
+static long sched_urgent_until;
+static struct storage_sched_stats sched_stats;
+
+/* is the request's position behind the last transfer? */
+static inline bool sched_req_behind(const struct storage_req *req)
+{
+#ifdef HAVE_MULTIDRIVE
+    if (req->drive != sched_drive)
+        return req->drive < sched_drive;
+#endif
+    return req->start < sched_head;
+}
+
+/* does request 'a' lie before request 'b' on disk? */
+static inline bool sched_req_before(const struct storage_req *a,
+                                    const struct storage_req *b)
+{
+#ifdef HAVE_MULTIDRIVE
+    if (a->drive != b->drive)
+        return a->drive < b->drive;
+#endif
+    return a->start < b->start;
+}
+
+/* choose the waiter to receive the device next; call with mutex held */
+static struct storage_req ** sched_pick_next(void)
+{
+    struct storage_req **pick = NULL, **pnext;
+
+    if (sched_urgent_thread &&
+        TIME_BEFORE(current_tick, sched_urgent_until))
+    {
+        for (pnext = &sched_waiters; *pnext; pnext = &(*pnext)->next)
+        {
+            if ((*pnext)->thread == sched_urgent_thread)
+            {
+                sched_stats.urgent++;
+                return pnext;
+            }
+        }
+    }
+
+    if (sched_waiters && TIME_AFTER(current_tick, sched_waiters->deadline))
+    {
+        /* the oldest is at the front */
+        sched_stats.expired++;
+        return &sched_waiters;
+    }
+
+    /* C-LOOK: lowest sector ahead of the head, else lowest overall */
+    struct storage_req **wrap = NULL;
+
+    for (pnext = &sched_waiters; *pnext; pnext = &(*pnext)->next)
+    {
+        struct storage_req *req = *pnext;
+        struct storage_req ***best = sched_req_behind(req) ? &wrap : &pick;
+
+        if (!*best || sched_req_before(req, **best))
+            *best = pnext;
+    }
+
+    if (!pick)
+        pick = wrap;
+
+    if (pick && pick != &sched_waiters)
+        sched_stats.reordered++;
+
+    return pick;
+}
+
+static int storage_transfer(IF_MD(int drive,) unsigned long start, int count,
+                            void *buf, bool write)
+{
+    struct storage_req req;
+
+    mutex_lock(&sched_mutex);
+
+    sched_stats.requests++;
+
+    if (sched_busy)
+    {
+        /* wait for the owner to hand over the device */
+#ifdef HAVE_MULTIDRIVE
+        req.drive    = drive;
+#endif
+        req.start    = start;
+        req.thread   = thread_self();
+        req.deadline = current_tick + STORAGE_SCHED_DEADLINE;
+        req.next     = NULL;
+        semaphore_init(&req.sem, 1, 0);
+
+        struct storage_req **pnext = &sched_waiters;
+        while (*pnext)
+            pnext = &(*pnext)->next;
+        *pnext = &req;
+
+        if (++sched_queued > sched_stats.max_queue)
+            sched_stats.max_queue = sched_queued;
+
+        sched_stats.waits++;
+
+        mutex_unlock(&sched_mutex);
+        /* the device is still marked busy when it is handed over */
+        semaphore_wait(&req.sem, TIMEOUT_BLOCK);
+    }
+    else
+    {
+        sched_busy = true;
+        mutex_unlock(&sched_mutex);
+    }
+
+    int rc = write ? driver_write_sectors(IF_MD(drive,) start, count, buf) :
+                     driver_read_sectors(IF_MD(drive,) start, count, buf);
+
+    mutex_lock(&sched_mutex);
+
+#ifdef HAVE_MULTIDRIVE
+    sched_drive = drive;
+#endif
+    sched_head = start + count;
+
+    struct storage_req **pnext = sched_pick_next();
+
+    if (pnext)
+    {
+        /* device stays busy; ownership passes to the waiter */
+        struct storage_req *w = *pnext;
+        *pnext = w->next;
+        sched_queued--;
+        semaphore_release(&w->sem);
+    }
+    else
+    {
+        sched_busy = false;
+    }
+
+    mutex_unlock(&sched_mutex);
+    return rc;
+}
+
+static void storage_sched_init(void)
+{
+    mutex_init(&sched_mutex);
+}
+
+void storage_sched_get_stats(struct storage_sched_stats *stats, bool reset)
+{
+    mutex_lock(&sched_mutex);
+
+    *stats = sched_stats;
+
+    if (reset)
+        memset(&sched_stats, 0, sizeof (sched_stats));
+
+    mutex_unlock(&sched_mutex);
+}
+
+void storage_sched_set_urgent_thread(unsigned int thread_id)
+{
+    sched_urgent_thread = thread_id;
+}
+
+void storage_sched_audio_critical(void)
+{
+    sched_urgent_until = current_tick + STORAGE_URGENT_TIME;
+}
+
+int storage_read_sectors(IF_MD(int drive,) unsigned long start, int count,
+                         void* buf)
+{
+    return storage_transfer(IF_MD(drive,) start, count, buf, false);
+}
+
+int storage_write_sectors(IF_MD(int drive,) unsigned long start, int count,
+                          const void* buf)
+{
+    return storage_transfer(IF_MD(drive,) start, count, (void *)buf, true);
+}
+#else /* !HAVE_STORAGE_SCHED */
+
+int storage_read_sectors(IF_MD(int drive,) unsigned long start, int count,
+                         void* buf)
+{
+    return driver_read_sectors(IF_MD(drive,) start, count, buf);
+}
+
+int storage_write_sectors(IF_MD(int drive,) unsigned long start, int count,
+                          const void* buf)
+{
+    return driver_write_sectors(IF_MD(drive,) start, count, buf);
+}
+#endif /* HAVE_STORAGE_SCHED */
+
 #ifdef CONFIG_STORAGE_MULTI
 
 #define DRIVER_MASK     0xff000000